@@ -0,0 +1,585 @@
+/*
+ * Modern Menu Plugin for LXPanel
+ * Host de benchmarks de punta a punta (fuera de lxpanel)
+ *
+ * Carga build/modernmenu.so con dlopen, reemplaza los símbolos de lxpanel
+ * que el plugin usa y maneja el menú como lo haría un usuario: clicks en el
+ * botón del panel y consultas tecleadas letra por letra, sobre un menú
+ * sintético armado en un directorio temporal (HOME y XDG_* apuntan ahí, así
+ * no se tocan los favoritos ni la caché reales).
+ *
+ * Mide desde el evento hasta la pintura de la ventana del menú, mirando los
+ * expose que llegan a cualquier GdkWindow de la ventana:
+ *   e2e_open_first  primer click, hasta la primera pintura
+ *   e2e_open        clicks siguientes, hasta la primera pintura
+ *   e2e_open_settled  clicks siguientes, hasta la última pintura (iconos incluidos)
+ *   e2e_search      cada tecla, hasta la última pintura de resultados
+ * "Última pintura" es la última antes de --settle ms sin pintar nada.
+ *
+ * Imprime una línea JSON por serie con percentiles en ms y termina con
+ * código 1 si alguna serie con --budget supera su p95.
+ *
+ * Necesita un servidor X; sin DISPLAY usar "make run-e2e" (Xvfb).
+ */
+#define _GNU_SOURCE
+
+#include <lxpanel/plugin.h>
+#include <gtk/gtk.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <menu-cache/menu-cache.h>
+#include <libfm/fm-gtk.h>
+#include <dlfcn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* ==== SÍMBOLOS DE LXPANEL ====
+ * El ejecutable se enlaza con -rdynamic, así el plugin resuelve estos en
+ * lugar de los del panel. */
+struct _config_setting_t {
+    GHashTable *values;             // nombre -> cadena
+};
+
+static GQuark host_plugin_data_quark;
+
+gboolean config_setting_lookup_string(const config_setting_t *setting, const char *name,
+                                      const char **value)
+{
+    const char *v = setting ? g_hash_table_lookup(setting->values, name) : NULL;
+    if (!v) return FALSE;
+    *value = v;
+    return TRUE;
+}
+
+gboolean config_setting_lookup_int(const config_setting_t *setting, const char *name, int *value)
+{
+    const char *v = setting ? g_hash_table_lookup(setting->values, name) : NULL;
+    if (!v) return FALSE;
+    *value = atoi(v);
+    return TRUE;
+}
+
+config_setting_t *config_group_set_string(config_setting_t *setting, const char *name,
+                                          const char *value)
+{
+    g_hash_table_replace(setting->values, g_strdup(name), g_strdup(value));
+    return setting;
+}
+
+config_setting_t *config_group_set_int(config_setting_t *setting, const char *name, int value)
+{
+    g_hash_table_replace(setting->values, g_strdup(name), g_strdup_printf("%d", value));
+    return setting;
+}
+
+GtkWidget *lxpanel_button_new_for_icon(LXPanel *panel, const gchar *name, GdkColor *color,
+                                       const gchar *label)
+{
+    (void)panel; (void)color; (void)label;
+    GtkWidget *box = gtk_event_box_new();
+    gtk_container_add(GTK_CONTAINER(box), gtk_image_new_from_icon_name(name, GTK_ICON_SIZE_LARGE_TOOLBAR));
+    return box;
+}
+
+gboolean lxpanel_button_set_icon(GtkWidget *btn, const gchar *name, gint size)
+{
+    (void)size;
+    GtkWidget *img = gtk_bin_get_child(GTK_BIN(btn));
+    if (!GTK_IS_IMAGE(img)) return FALSE;
+    gtk_image_set_from_icon_name(GTK_IMAGE(img), name, GTK_ICON_SIZE_LARGE_TOOLBAR);
+    return TRUE;
+}
+
+void lxpanel_plugin_set_data(GtkWidget *plugin, gpointer data, GDestroyNotify destructor)
+{
+    g_object_set_qdata_full(G_OBJECT(plugin), host_plugin_data_quark, data, destructor);
+}
+
+gpointer lxpanel_plugin_get_data(GtkWidget *plugin)
+{
+    return g_object_get_qdata(G_OBJECT(plugin), host_plugin_data_quark);
+}
+
+GtkWidget *lxpanel_generic_config_dlg(const char *title, LXPanel *panel, GSourceFunc apply_func,
+                                      GtkWidget *plugin, const char *name, gpointer ret_value,
+                                      GType type, ...)
+{
+    (void)panel; (void)apply_func; (void)plugin; (void)name; (void)ret_value; (void)type;
+    return gtk_dialog_new_with_buttons(title, NULL, 0, GTK_STOCK_CLOSE, GTK_RESPONSE_CLOSE, NULL);
+}
+
+void logout(void)
+{
+}
+
+/* ==== MENÚ SINTÉTICO ==== */
+static const char *host_categories[] = {
+    "Utility", "Development", "Graphics", "AudioVideo", "Network",
+    "Office", "System", "Game", "Education", "Settings",
+};
+
+static const char *host_icons[] = {
+    "accessories-text-editor", "utilities-terminal", "applications-graphics",
+    "multimedia-player", "web-browser", "system-file-manager",
+    "preferences-system", "applications-games", "application-x-executable",
+};
+
+static const char *host_words[] = {
+    "Text", "Editor", "Media", "Player", "Image", "Viewer", "Terminal", "File",
+    "Manager", "System", "Monitor", "Music", "Video", "Office", "Writer", "Calc",
+    "Cálculo", "Música", "Gráficos", "Navegador", "Web", "Browser", "Mail", "Chat",
+};
+
+#define HOST_FAVORITES 12
+
+static void host_write(const char *path, const char *contents)
+{
+    GError *error = NULL;
+    gchar *dir = g_path_get_dirname(path);
+    g_mkdir_with_parents(dir, 0700);
+    g_free(dir);
+    if (!g_file_set_contents(path, contents, -1, &error)) {
+        g_printerr("modernmenu-e2e: %s\n", error->message);
+        exit(2);
+    }
+}
+
+/* Arma menus/applications.menu, los .desktop y los .directory bajo root */
+static void host_synthetic_menu(const char *root, guint n_apps, guint32 seed)
+{
+    GRand *rand = g_rand_new_with_seed(seed);
+    gchar *apps_dir = g_build_filename(root, "data", "applications", NULL);
+    gchar *dirs_dir = g_build_filename(root, "data", "desktop-directories", NULL);
+    GString *menu = g_string_new(NULL);
+    GString *favorites = g_string_new(NULL);
+
+    g_string_append_printf(menu,
+        "<!DOCTYPE Menu PUBLIC \"-//freedesktop//DTD Menu 1.0//EN\"\n"
+        " \"http://www.freedesktop.org/standards/menu-spec/menu-1.0.dtd\">\n"
+        "<Menu>\n  <Name>Applications</Name>\n"
+        "  <AppDir>%s</AppDir>\n  <DirectoryDir>%s</DirectoryDir>\n", apps_dir, dirs_dir);
+
+    for (guint c = 0; c < G_N_ELEMENTS(host_categories); c++) {
+        gchar *file = g_strdup_printf("%s/bench-%s.directory", dirs_dir, host_categories[c]);
+        gchar *contents = g_strdup_printf("[Desktop Entry]\nType=Directory\nName=%s\nIcon=folder\n",
+                                          host_categories[c]);
+        host_write(file, contents);
+        g_free(contents);
+        g_free(file);
+
+        g_string_append_printf(menu,
+            "  <Menu>\n    <Name>%s</Name>\n    <Directory>bench-%s.directory</Directory>\n"
+            "    <Include><Category>%s</Category></Include>\n  </Menu>\n",
+            host_categories[c], host_categories[c], host_categories[c]);
+    }
+    g_string_append(menu, "</Menu>\n");
+
+    for (guint i = 0; i < n_apps; i++) {
+        const char *w1 = host_words[g_rand_int_range(rand, 0, G_N_ELEMENTS(host_words))];
+        const char *w2 = host_words[g_rand_int_range(rand, 0, G_N_ELEMENTS(host_words))];
+        const char *cat = host_categories[g_rand_int_range(rand, 0, G_N_ELEMENTS(host_categories))];
+        const char *icon = host_icons[g_rand_int_range(rand, 0, G_N_ELEMENTS(host_icons))];
+
+        gchar *file = g_strdup_printf("%s/app-%05u.desktop", apps_dir, i);
+        gchar *contents = g_strdup_printf("[Desktop Entry]\nType=Application\nName=%s %s %u\n"
+                                          "Exec=true\nIcon=%s\nCategories=%s;\n",
+                                          w1, w2, i, icon, cat);
+        host_write(file, contents);
+        g_free(contents);
+        g_free(file);
+
+        if (i < HOST_FAVORITES)
+            g_string_append_printf(favorites, "app-%05u.desktop\n", i);
+    }
+
+    gchar *menu_path = g_build_filename(root, "config", "menus", "applications.menu", NULL);
+    host_write(menu_path, menu->str);
+    gchar *fav_path = g_build_filename(root, "home", ".config", "modernmenu", "favorites.list", NULL);
+    host_write(fav_path, favorites->str);
+
+    g_free(fav_path);
+    g_free(menu_path);
+    g_string_free(favorites, TRUE);
+    g_string_free(menu, TRUE);
+    g_free(dirs_dir);
+    g_free(apps_dir);
+    g_rand_free(rand);
+}
+
+/* Apunta HOME y XDG_* al directorio temporal; los iconos siguen saliendo de /usr/share */
+static void host_environment(const char *root)
+{
+    gchar *home = g_build_filename(root, "home", NULL);
+    gchar *config_home = g_build_filename(home, ".config", NULL);
+    gchar *cache_home = g_build_filename(home, ".cache", NULL);
+    gchar *config_dirs = g_build_filename(root, "config", NULL);
+    gchar *data_dirs = g_strdup_printf("%s/data:/usr/local/share:/usr/share", root);
+
+    g_mkdir_with_parents(cache_home, 0700);
+    g_setenv("HOME", home, TRUE);
+    g_setenv("XDG_CONFIG_HOME", config_home, TRUE);
+    g_setenv("XDG_CACHE_HOME", cache_home, TRUE);
+    g_setenv("XDG_CONFIG_DIRS", config_dirs, TRUE);
+    g_setenv("XDG_DATA_DIRS", data_dirs, TRUE);
+    g_unsetenv("XDG_MENU_PREFIX");
+
+    g_free(data_dirs);
+    g_free(config_dirs);
+    g_free(cache_home);
+    g_free(config_home);
+    g_free(home);
+}
+
+static void host_rm_rf(const char *path)
+{
+    if (g_file_test(path, G_FILE_TEST_IS_DIR) && !g_file_test(path, G_FILE_TEST_IS_SYMLINK)) {
+        GDir *dir = g_dir_open(path, 0, NULL);
+        const char *name;
+        while (dir && (name = g_dir_read_name(dir))) {
+            gchar *child = g_build_filename(path, name, NULL);
+            host_rm_rf(child);
+            g_free(child);
+        }
+        if (dir) g_dir_close(dir);
+    }
+    g_remove(path);
+}
+
+/* ==== OBSERVACIÓN DE PINTURAS ==== */
+static struct {
+    GdkWindow *target;              // toplevel del menú que se está midiendo
+    gint64 first_paint, last_paint; // µs monotónicos; 0 si no hubo
+} watch;
+
+/* Todos los eventos pasan por acá antes de GTK; los expose del menú marcan tiempo al terminar */
+static void host_event_handler(GdkEvent *event, gpointer data)
+{
+    (void)data;
+    gboolean watched = event->type == GDK_EXPOSE && watch.target && event->any.window &&
+                       gdk_window_get_toplevel(event->any.window) == watch.target;
+
+    gtk_main_do_event(event);
+
+    if (watched) {
+        watch.last_paint = g_get_monotonic_time();
+        if (!watch.first_paint)
+            watch.first_paint = watch.last_paint;
+    }
+}
+
+static void host_watch_reset(void)
+{
+    watch.first_paint = watch.last_paint = 0;
+}
+
+/* Corre el loop hasta que pasen settle µs sin pintar (o max µs en total) */
+static void host_settle(gint64 settle, gint64 max)
+{
+    gint64 start = g_get_monotonic_time();
+    for (;;) {
+        gdk_flush();
+        if (!g_main_context_iteration(NULL, FALSE))
+            g_usleep(200);
+
+        gint64 now = g_get_monotonic_time();
+        gint64 quiet_since = watch.last_paint ? watch.last_paint : start;
+        if (now - quiet_since >= settle || now - start >= max)
+            return;
+    }
+}
+
+static void host_run_for(gint64 duration)
+{
+    gint64 end = g_get_monotonic_time() + duration;
+    while (g_get_monotonic_time() < end) {
+        if (!g_main_context_iteration(NULL, FALSE))
+            g_usleep(1000);
+    }
+}
+
+/* ==== ACCIONES ==== */
+static void host_click(GtkWidget *widget)
+{
+    GdkEvent *event = gdk_event_new(GDK_BUTTON_PRESS);
+    event->button.window = g_object_ref(gtk_widget_get_window(widget));
+    event->button.send_event = TRUE;
+    event->button.time = GDK_CURRENT_TIME;
+    event->button.button = 1;
+    event->button.device = gdk_display_get_core_pointer(gdk_display_get_default());
+    gtk_widget_event(widget, event);
+    gdk_event_free(event);
+}
+
+/* La ventana visible que no es el panel */
+static GtkWidget *host_find_popup(GtkWidget *panel_window)
+{
+    GtkWidget *found = NULL;
+    GList *toplevels = gtk_window_list_toplevels();
+    for (GList *l = toplevels; l && !found; l = l->next) {
+        GtkWidget *w = l->data;
+        if (w != panel_window && gtk_widget_get_visible(w) && gtk_widget_get_window(w))
+            found = w;
+    }
+    g_list_free(toplevels);
+    return found;
+}
+
+static GtkWidget *host_find_entry(GtkWidget *widget)
+{
+    if (GTK_IS_ENTRY(widget))
+        return widget;
+    if (!GTK_IS_CONTAINER(widget))
+        return NULL;
+
+    GtkWidget *found = NULL;
+    GList *children = gtk_container_get_children(GTK_CONTAINER(widget));
+    for (GList *l = children; l && !found; l = l->next)
+        found = host_find_entry(l->data);
+    g_list_free(children);
+    return found;
+}
+
+static void host_type_char(GtkWidget *entry, gunichar c)
+{
+    gchar buf[8];
+    gint len = g_unichar_to_utf8(c, buf);
+    gint pos = gtk_editable_get_position(GTK_EDITABLE(entry));
+    gtk_editable_insert_text(GTK_EDITABLE(entry), buf, len, &pos);
+    gtk_editable_set_position(GTK_EDITABLE(entry), pos);
+}
+
+/* ==== SERIES Y PRESUPUESTOS ==== */
+typedef struct {
+    const char *name;
+    GArray *samples;                // gdouble, ms
+    guint missed;                   // eventos sin ninguna pintura
+    gdouble budget_p95;             // 0 = sin presupuesto
+} HostSeries;
+
+static void host_sample(HostSeries *s, gint64 start, gint64 paint)
+{
+    if (!paint) {
+        s->missed++;
+        return;
+    }
+    gdouble ms = (paint - start) / 1000.0;
+    g_array_append_val(s->samples, ms);
+}
+
+static int host_cmp_double(gconstpointer a, gconstpointer b)
+{
+    gdouble x = *(const gdouble *)a, y = *(const gdouble *)b;
+    return (x > y) - (x < y);
+}
+
+static gdouble host_percentile(GArray *sorted, gdouble p)
+{
+    if (sorted->len == 0) return 0;
+    guint rank = (guint)(p / 100.0 * sorted->len + 0.999999);
+    if (rank < 1) rank = 1;
+    if (rank > sorted->len) rank = sorted->len;
+    return g_array_index(sorted, gdouble, rank - 1);
+}
+
+/* Imprime la serie; devuelve FALSE si no cumple su presupuesto */
+static gboolean host_report(HostSeries *s, guint n_apps)
+{
+    g_array_sort(s->samples, host_cmp_double);
+    gdouble p95 = host_percentile(s->samples, 95);
+    gboolean ok = s->missed == 0 && (s->budget_p95 <= 0 || p95 <= s->budget_p95);
+
+    printf("{\"benchmark\":\"%s\",\"apps\":%u,\"samples\":%u,\"missed\":%u,"
+           "\"p50_ms\":%.2f,\"p90_ms\":%.2f,\"p95_ms\":%.2f,\"p99_ms\":%.2f,\"max_ms\":%.2f,"
+           "\"budget_p95_ms\":%.2f,\"ok\":%s}\n",
+           s->name, n_apps, s->samples->len, s->missed,
+           host_percentile(s->samples, 50), host_percentile(s->samples, 90), p95,
+           host_percentile(s->samples, 99), host_percentile(s->samples, 100),
+           s->budget_p95, ok ? "true" : "false");
+    if (!ok)
+        g_printerr("modernmenu-e2e: %s over budget (p95 %.2f ms, budget %.2f ms, %u missed)\n",
+                   s->name, p95, s->budget_p95, s->missed);
+    return ok;
+}
+
+enum { SERIES_OPEN_FIRST, SERIES_OPEN, SERIES_OPEN_SETTLED, SERIES_SEARCH, N_SERIES };
+
+static HostSeries host_series[N_SERIES] = {
+    { "e2e_open_first", NULL, 0, 0 },
+    { "e2e_open", NULL, 0, 0 },
+    { "e2e_open_settled", NULL, 0, 0 },
+    { "e2e_search", NULL, 0, 0 },
+};
+
+/* --budget nombre=ms, con o sin el prefijo "e2e_" */
+static gboolean host_parse_budget(const char *arg)
+{
+    const char *eq = strchr(arg, '=');
+    if (!eq) return FALSE;
+    gchar *name = g_strndup(arg, eq - arg);
+    gboolean found = FALSE;
+    for (guint i = 0; i < N_SERIES; i++) {
+        if (g_strcmp0(host_series[i].name, name) == 0 || g_strcmp0(host_series[i].name + 4, name) == 0) {
+            host_series[i].budget_p95 = g_ascii_strtod(eq + 1, NULL);
+            found = TRUE;
+        }
+    }
+    g_free(name);
+    return found;
+}
+
+static void host_usage(const char *argv0)
+{
+    fprintf(stderr,
+            "usage: %s [--plugin PATH] [--apps N] [--iterations N] [--queries q1,q2,...]\n"
+            "          [--settle MS] [--warmup MS] [--seed N] [--keep]\n"
+            "          [--budget open_first|open|open_settled|search=MS ...]\n", argv0);
+}
+
+int main(int argc, char **argv)
+{
+    const char *plugin_path = "build/modernmenu.so";
+    guint n_apps = 1500, iterations = 30;
+    guint32 seed = 42;
+    gint64 settle = 150 * 1000, warmup = 3000 * 1000, max_wait = 5000 * 1000;
+    gboolean keep = FALSE;
+    gchar **queries = g_strsplit("text,edit,musica,med pla,zzqx", ",", -1);
+
+    for (int i = 1; i < argc; i++) {
+        gboolean has_value = i + 1 < argc;
+        if (strcmp(argv[i], "--plugin") == 0 && has_value) {
+            plugin_path = argv[++i];
+        } else if (strcmp(argv[i], "--apps") == 0 && has_value) {
+            n_apps = (guint)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--iterations") == 0 && has_value) {
+            iterations = (guint)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--queries") == 0 && has_value) {
+            g_strfreev(queries);
+            queries = g_strsplit(argv[++i], ",", -1);
+        } else if (strcmp(argv[i], "--settle") == 0 && has_value) {
+            settle = g_ascii_strtoll(argv[++i], NULL, 10) * 1000;
+        } else if (strcmp(argv[i], "--warmup") == 0 && has_value) {
+            warmup = g_ascii_strtoll(argv[++i], NULL, 10) * 1000;
+        } else if (strcmp(argv[i], "--seed") == 0 && has_value) {
+            seed = (guint32)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--keep") == 0) {
+            keep = TRUE;
+        } else if (strcmp(argv[i], "--budget") == 0 && has_value && host_parse_budget(argv[i + 1])) {
+            i++;
+        } else {
+            host_usage(argv[0]);
+            return 2;
+        }
+    }
+    if (iterations == 0) iterations = 1;
+
+    /* ==== ENTORNO Y MENÚ SINTÉTICO ==== */
+    gchar *root = g_dir_make_tmp("modernmenu-e2e-XXXXXX", NULL);
+    if (!root) {
+        g_printerr("modernmenu-e2e: cannot create temporary directory\n");
+        return 2;
+    }
+    host_synthetic_menu(root, n_apps, seed);
+    host_environment(root);
+
+    gtk_init(&argc, &argv);
+    fm_gtk_init(NULL);
+    // El cursor titilando pintaría la ventana aunque no pase nada
+    g_object_set(gtk_settings_get_default(), "gtk-cursor-blink", FALSE, NULL);
+    host_plugin_data_quark = g_quark_from_static_string("modernmenu-e2e-plugin-data");
+    gdk_event_handler_set(host_event_handler, NULL, NULL);
+
+    // Que menu-cached genere la caché antes de empezar a medir
+    MenuCache *warm = menu_cache_lookup_sync("applications.menu");
+    if (warm) menu_cache_unref(warm);
+
+    /* ==== CARGA DEL PLUGIN ==== */
+    void *handle = dlopen(plugin_path, RTLD_NOW | RTLD_LOCAL);
+    if (!handle) {
+        g_printerr("modernmenu-e2e: %s\n", dlerror());
+        return 2;
+    }
+    LXPanelPluginInit *init = dlsym(handle, "fm_module_init_lxpanel_gtk");
+    if (!init || !init->new_instance) {
+        g_printerr("modernmenu-e2e: %s is not an lxpanel plugin\n", plugin_path);
+        return 2;
+    }
+
+    config_setting_t settings = { g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free) };
+    config_group_set_string(&settings, "icon", "start-here");
+
+    // Un panel de 32 px abajo de la pantalla, como el de LXDE
+    GtkWidget *panel_window = gtk_window_new(GTK_WINDOW_TOPLEVEL);
+    gtk_window_set_default_size(GTK_WINDOW(panel_window), gdk_screen_width(), 32);
+    gtk_window_move(GTK_WINDOW(panel_window), 0, gdk_screen_height() - 32);
+
+    GtkWidget *plugin = init->new_instance(NULL, &settings);
+    gtk_container_add(GTK_CONTAINER(panel_window), plugin);
+    gtk_widget_show_all(panel_window);
+
+    host_run_for(warmup);
+
+    /* ==== MEDICIÓN ==== */
+    for (guint i = 0; i < N_SERIES; i++)
+        host_series[i].samples = g_array_new(FALSE, FALSE, sizeof(gdouble));
+
+    for (guint it = 0; it < iterations; it++) {
+        host_watch_reset();
+        watch.target = NULL;
+        gint64 start = g_get_monotonic_time();
+        host_click(plugin);
+        GtkWidget *popup = host_find_popup(panel_window);
+        if (!popup) {
+            g_printerr("modernmenu-e2e: the menu did not open\n");
+            return 1;
+        }
+        watch.target = gtk_widget_get_window(popup);
+        host_settle(settle, max_wait);
+
+        host_sample(&host_series[it == 0 ? SERIES_OPEN_FIRST : SERIES_OPEN], start, watch.first_paint);
+        if (it > 0)
+            host_sample(&host_series[SERIES_OPEN_SETTLED], start, watch.last_paint);
+
+        GtkWidget *entry = host_find_entry(popup);
+        for (guint q = 0; entry && queries[q]; q++) {
+            gtk_entry_set_text(GTK_ENTRY(entry), "");
+            host_watch_reset();
+            host_settle(settle, max_wait);
+
+            for (const char *p = queries[q]; *p; p = g_utf8_next_char(p)) {
+                host_watch_reset();
+                start = g_get_monotonic_time();
+                host_type_char(entry, g_utf8_get_char(p));
+                host_settle(settle, max_wait);
+                host_sample(&host_series[SERIES_SEARCH], start, watch.last_paint);
+            }
+        }
+
+        // Segundo click: cerrar
+        host_click(plugin);
+        watch.target = NULL;
+        host_watch_reset();
+        host_run_for(settle);
+    }
+
+    gboolean ok = TRUE;
+    for (guint i = 0; i < N_SERIES; i++) {
+        if (host_series[i].samples->len || host_series[i].missed)
+            ok &= host_report(&host_series[i], n_apps);
+        g_array_free(host_series[i].samples, TRUE);
+    }
+    fflush(stdout);
+
+    /* ==== LIMPIEZA ==== */
+    gtk_widget_destroy(panel_window);   // llama al destructor del plugin
+    g_hash_table_destroy(settings.values);
+    g_strfreev(queries);
+    if (keep)
+        g_printerr("modernmenu-e2e: synthetic menu kept in %s\n", root);
+    else
+        host_rm_rf(root);
+    g_free(root);
+    // Sin dlclose: el plugin puede dejar hilos e idle de fondo vivos
+
+    return ok ? 0 : 1;
+}
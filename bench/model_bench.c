@@ -0,0 +1,390 @@
+/*
+ * Modern Menu Plugin for LXPanel
+ * Microbenchmarks del modelo (sin GTK ni panel)
+ *
+ * Genera catálogos sintéticos de 100 a 20000 apps y mide armado del
+ * catálogo, eliminación de duplicados, filtrado y búsqueda. Imprime una
+ * línea JSON por medición para poder comparar corridas:
+ *
+ *   {"benchmark":"search_rank","apps":5000,"items":8,"iterations":40,
+ *    "ns_per_op":...,"allocs_per_op":...,"bytes_per_op":...}
+ *
+ * Una "op" es una pasada completa de la fase; "items" dice cuántas
+ * unidades de trabajo tiene (registros, apps o consultas).
+ *
+ * Uso: modernmenu-bench [--sizes 100,1000,5000,20000] [--seed N] [--quick]
+ */
+#define _GNU_SOURCE
+
+#include "modern_menu_model.h"
+
+#include <glib/gstdio.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* ==== CONTEO DE RESERVAS ==== */
+/* Se reemplaza malloc en el ejecutable (glibc lo permite) y se delega en el
+ * asignador de glibc, así cuentan también las reservas hechas dentro de
+ * GLib. Con G_SLICE=always-malloc GSlice pasa por acá; tiene que estar en
+ * el entorno antes de arrancar (GLib lo lee al iniciarse), por eso lo pone
+ * "make run-bench". Sin eso, en GLib < 2.76 las reservas de GSlice no se
+ * cuentan. */
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t n, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void __libc_free(void *ptr);
+
+static int counting;
+static guint64 alloc_count, alloc_bytes;
+
+void *malloc(size_t size)
+{
+    if (counting) {
+        alloc_count++;
+        alloc_bytes += size;
+    }
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t n, size_t size)
+{
+    if (counting) {
+        alloc_count++;
+        alloc_bytes += n * size;
+    }
+    return __libc_calloc(n, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    if (counting) {
+        alloc_count++;
+        alloc_bytes += size;
+    }
+    return __libc_realloc(ptr, size);
+}
+
+void free(void *ptr)
+{
+    __libc_free(ptr);
+}
+
+/* ==== CATÁLOGO SINTÉTICO ==== */
+#define BENCH_CATEGORIES 12
+#define BENCH_HIDDEN_PERCENT 5
+#define BENCH_FAVORITE_PERCENT 2
+#define BENCH_SHARED_PERCENT 20     // apps que aparecen también en otra carpeta
+
+typedef struct {
+    gchar *id, *name, *icon, *exec, *file;
+} SyntheticApp;
+
+typedef struct {
+    guint app;                      // índice en apps
+    guint category;
+} SyntheticRecord;
+
+typedef struct {
+    guint n_apps;
+    SyntheticApp *apps;
+    GArray *records;                // SyntheticRecord, en orden de recorrido del menú
+    GArray *dup_records;            // cada app tres veces, para medir duplicados
+    gchar *category_ids[BENCH_CATEGORIES];
+    GHashTable *hidden, *favorites;
+} SyntheticCatalog;
+
+static const char *bench_words[] = {
+    "Text", "Editor", "Media", "Player", "Image", "Viewer", "Terminal", "File",
+    "Manager", "System", "Monitor", "Music", "Video", "Office", "Writer", "Calc",
+    "Cálculo", "Música", "Gráficos", "Navegador", "Web", "Browser", "Mail", "Chat",
+    "Network", "Settings", "Config", "Disk", "Backup", "Archive", "Sound", "Paint",
+};
+#define BENCH_N_WORDS G_N_ELEMENTS(bench_words)
+
+static SyntheticCatalog *synthetic_new(guint n_apps, guint32 seed)
+{
+    SyntheticCatalog *sc = g_new0(SyntheticCatalog, 1);
+    GRand *rand = g_rand_new_with_seed(seed);
+
+    sc->n_apps = n_apps;
+    sc->apps = g_new0(SyntheticApp, n_apps);
+    sc->records = g_array_new(FALSE, FALSE, sizeof(SyntheticRecord));
+    sc->dup_records = g_array_new(FALSE, FALSE, sizeof(SyntheticRecord));
+    sc->hidden = id_set_new();
+    sc->favorites = id_set_new();
+
+    for (guint c = 0; c < BENCH_CATEGORIES; c++)
+        sc->category_ids[c] = g_strdup_printf("category-%02u.directory", c);
+
+    for (guint i = 0; i < n_apps; i++) {
+        SyntheticApp *a = &sc->apps[i];
+        const char *w1 = bench_words[g_rand_int_range(rand, 0, BENCH_N_WORDS)];
+        const char *w2 = bench_words[g_rand_int_range(rand, 0, BENCH_N_WORDS)];
+
+        a->id = g_strdup_printf("app-%05u.desktop", i);
+        a->name = g_strdup_printf("%s %s %u", w1, w2, i);
+        a->icon = g_ascii_strdown(w1, -1);
+        a->exec = g_strdup_printf("/usr/bin/app-%05u %%U", i);
+        a->file = g_strdup_printf("/usr/share/applications/%s", a->id);
+
+        SyntheticRecord r = { i, (guint)g_rand_int_range(rand, 0, BENCH_CATEGORIES) };
+        g_array_append_val(sc->records, r);
+        if ((guint)g_rand_int_range(rand, 0, 100) < BENCH_SHARED_PERCENT) {
+            SyntheticRecord shared = { i, (r.category + 1) % BENCH_CATEGORIES };
+            g_array_append_val(sc->records, shared);
+        }
+
+        if ((guint)g_rand_int_range(rand, 0, 100) < BENCH_HIDDEN_PERCENT)
+            g_hash_table_add(sc->hidden, g_strdup(a->id));
+        if ((guint)g_rand_int_range(rand, 0, 100) < BENCH_FAVORITE_PERCENT)
+            g_hash_table_add(sc->favorites, g_strdup(a->id));
+    }
+
+    for (guint k = 0; k < 3; k++)
+        for (guint i = 0; i < n_apps; i++) {
+            SyntheticRecord r = { i, k % BENCH_CATEGORIES };
+            g_array_append_val(sc->dup_records, r);
+        }
+
+    g_rand_free(rand);
+    return sc;
+}
+
+static void synthetic_free(SyntheticCatalog *sc)
+{
+    for (guint i = 0; i < sc->n_apps; i++) {
+        SyntheticApp *a = &sc->apps[i];
+        g_free(a->id);
+        g_free(a->name);
+        g_free(a->icon);
+        g_free(a->exec);
+        g_free(a->file);
+    }
+    for (guint c = 0; c < BENCH_CATEGORIES; c++)
+        g_free(sc->category_ids[c]);
+    g_free(sc->apps);
+    g_array_free(sc->records, TRUE);
+    g_array_free(sc->dup_records, TRUE);
+    g_hash_table_destroy(sc->hidden);
+    g_hash_table_destroy(sc->favorites);
+    g_free(sc);
+}
+
+/* Arma un catálogo como lo hace el plugin con el árbol de menu-cache */
+static Catalog *synthetic_build(SyntheticCatalog *sc, GArray *records)
+{
+    Catalog *catalog = catalog_new();
+    CategoryEntry *cats[BENCH_CATEGORIES];
+
+    for (guint c = 0; c < BENCH_CATEGORIES; c++)
+        cats[c] = catalog_add_category(catalog, sc->category_ids[c], sc->category_ids[c]);
+
+    for (guint r = 0; r < records->len; r++) {
+        SyntheticRecord *rec = &g_array_index(records, SyntheticRecord, r);
+        SyntheticApp *a = &sc->apps[rec->app];
+
+        AppEntry *e = catalog_lookup(catalog, a->id);
+        if (!e)
+            e = catalog_add_app(catalog, app_entry_new(a->id, a->name, a->icon, a->exec, a->file));
+        g_ptr_array_add(cats[rec->category]->apps, app_entry_ref(e));
+    }
+    return catalog;
+}
+
+/* ==== MEDICIÓN ==== */
+typedef void (*BenchFunc)(gpointer data);
+
+static gint64 bench_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (gint64)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* Corre func hasta juntar al menos min_ns (y min_iterations) e imprime la línea */
+static void bench_run(const char *name, guint n_apps, guint items, BenchFunc func, gpointer data,
+                      gint64 min_ns, guint min_iterations)
+{
+    func(data);  // calentamiento
+
+    guint iterations = 0;
+    alloc_count = alloc_bytes = 0;
+    gint64 start = bench_now_ns(), elapsed;
+    do {
+        counting = 1;
+        func(data);
+        counting = 0;
+        iterations++;
+        elapsed = bench_now_ns() - start;
+    } while (elapsed < min_ns || iterations < min_iterations);
+
+    printf("{\"benchmark\":\"%s\",\"apps\":%u,\"items\":%u,\"iterations\":%u,"
+           "\"ns_per_op\":%.1f,\"allocs_per_op\":%.1f,\"bytes_per_op\":%.1f}\n",
+           name, n_apps, items, iterations, (double)elapsed / iterations,
+           (double)alloc_count / iterations, (double)alloc_bytes / iterations);
+    fflush(stdout);
+}
+
+typedef struct {
+    SyntheticCatalog *sc;
+    Catalog *catalog;
+    SearchIndex *index;
+    const char *const *queries;
+    guint n_queries;
+    FrecencyStore *frecency;
+    gint64 now;
+} BenchState;
+
+static void bench_catalog_build(gpointer data)
+{
+    BenchState *st = data;
+    catalog_free(synthetic_build(st->sc, st->sc->records));
+}
+
+static void bench_catalog_dedup(gpointer data)
+{
+    BenchState *st = data;
+    catalog_free(synthetic_build(st->sc, st->sc->dup_records));
+}
+
+static void bench_filter_visible(gpointer data)
+{
+    BenchState *st = data;
+    g_ptr_array_free(catalog_filter_visible(st->catalog->apps, st->sc->hidden), TRUE);
+    for (guint c = 0; c < st->catalog->categories->len; c++) {
+        CategoryEntry *cat = g_ptr_array_index(st->catalog->categories, c);
+        g_ptr_array_free(catalog_filter_visible(cat->apps, st->sc->hidden), TRUE);
+    }
+}
+
+static void bench_collect_favorites(gpointer data)
+{
+    BenchState *st = data;
+    g_ptr_array_free(catalog_collect_ids(st->catalog, st->sc->favorites, st->sc->hidden), TRUE);
+}
+
+static void bench_search_index_build(gpointer data)
+{
+    BenchState *st = data;
+    search_index_unref(catalog_search_index_update(NULL, st->catalog, NULL));
+}
+
+static void bench_search_query(gpointer data)
+{
+    BenchState *st = data;
+    for (guint q = 0; q < st->n_queries; q++)
+        g_array_free(search_index_query(st->index, st->queries[q]), TRUE);
+}
+
+static void bench_search_rank(gpointer data)
+{
+    BenchState *st = data;
+    for (guint q = 0; q < st->n_queries; q++)
+        g_array_free(search_index_rank(st->index, st->queries[q], SEARCH_MAX_RESULTS), TRUE);
+}
+
+/* Un lanzamiento por app; la tabla es fija, así que con más apps que slots
+ * también se mide el reemplazo */
+static void bench_frecency_record(gpointer data)
+{
+    BenchState *st = data;
+    for (guint i = 0; i < st->sc->n_apps; i++)
+        frecency_record(st->frecency, st->sc->apps[i].id, st->now + i);
+}
+
+static gint bench_frecency_boost(const char *key, gpointer user_data)
+{
+    BenchState *st = user_data;
+    return frecency_boost(st->frecency, key, st->now);
+}
+
+static void bench_search_rank_frecency(gpointer data)
+{
+    BenchState *st = data;
+    for (guint q = 0; q < st->n_queries; q++)
+        g_array_free(search_index_rank_boosted(st->index, st->queries[q], SEARCH_MAX_RESULTS,
+                                               bench_frecency_boost, st), TRUE);
+}
+
+/* Consultas típicas: cortas, de una palabra, de dos, con acentos y sin resultados */
+static const char *const bench_queries[] = {
+    "t", "te", "text", "edit", "musica", "med pla", "clc", "zzqx",
+};
+
+int main(int argc, char **argv)
+{
+    guint sizes_default[] = { 100, 1000, 5000, 20000 };
+    GArray *sizes = g_array_new(FALSE, FALSE, sizeof(guint));
+    guint32 seed = 42;
+    gint64 min_ns = 200 * 1000 * 1000;
+    guint min_iterations = 5;
+
+    const char *slice = g_getenv("G_SLICE");
+    if (glib_check_version(2, 76, 0) && (!slice || !strstr(slice, "always-malloc")))
+        fprintf(stderr, "model_bench: G_SLICE=always-malloc is not set, GSlice allocations are not counted\n");
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--sizes") == 0 && i + 1 < argc) {
+            gchar **parts = g_strsplit(argv[++i], ",", -1);
+            for (int k = 0; parts[k]; k++) {
+                guint n = (guint)strtoul(parts[k], NULL, 10);
+                if (n) g_array_append_val(sizes, n);
+            }
+            g_strfreev(parts);
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = (guint32)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--quick") == 0) {
+            min_ns = 20 * 1000 * 1000;
+            min_iterations = 1;
+        } else {
+            fprintf(stderr, "usage: %s [--sizes N,N,...] [--seed N] [--quick]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (sizes->len == 0)
+        g_array_append_vals(sizes, sizes_default, G_N_ELEMENTS(sizes_default));
+
+    gchar *tmp_dir = g_dir_make_tmp("modernmenu-bench-XXXXXX", NULL);
+    gchar *frecency_path = g_build_filename(tmp_dir ? tmp_dir : g_get_tmp_dir(), "frecency.bin", NULL);
+
+    for (guint s = 0; s < sizes->len; s++) {
+        guint n = g_array_index(sizes, guint, s);
+        BenchState st = { 0 };
+        st.sc = synthetic_new(n, seed);
+        st.catalog = synthetic_build(st.sc, st.sc->records);
+        st.index = catalog_search_index_update(NULL, st.catalog, NULL);
+        st.queries = bench_queries;
+        st.n_queries = G_N_ELEMENTS(bench_queries);
+        g_remove(frecency_path);
+        st.frecency = frecency_open(frecency_path, NULL);
+        st.now = g_get_real_time() / G_USEC_PER_SEC;
+
+        bench_run("catalog_build", n, st.sc->records->len, bench_catalog_build, &st, min_ns, min_iterations);
+        bench_run("catalog_dedup", n, st.sc->dup_records->len, bench_catalog_dedup, &st, min_ns, min_iterations);
+        bench_run("filter_visible", n, n, bench_filter_visible, &st, min_ns, min_iterations);
+        bench_run("collect_favorites", n, g_hash_table_size(st.sc->favorites),
+                  bench_collect_favorites, &st, min_ns, min_iterations);
+        bench_run("search_index_build", n, n, bench_search_index_build, &st, min_ns, min_iterations);
+        bench_run("search_query", n, st.n_queries, bench_search_query, &st, min_ns, min_iterations);
+        bench_run("search_rank", n, st.n_queries, bench_search_rank, &st, min_ns, min_iterations);
+        if (st.frecency) {
+            bench_run("frecency_record", n, n, bench_frecency_record, &st, min_ns, min_iterations);
+            bench_run("search_rank_frecency", n, st.n_queries, bench_search_rank_frecency, &st,
+                      min_ns, min_iterations);
+            frecency_close(st.frecency);
+        }
+
+        search_index_unref(st.index);
+        catalog_free(st.catalog);
+        synthetic_free(st.sc);
+    }
+
+    g_remove(frecency_path);
+    if (tmp_dir) g_rmdir(tmp_dir);
+    g_free(frecency_path);
+    g_free(tmp_dir);
+    g_array_free(sizes, TRUE);
+    return 0;
+}
@@ -17,7 +17,15 @@
 #include <libfm/fm-gtk.h>
 #include <libfm/fm-utils.h>
 #include <libfm/fm.h>
+#include <glib/gstdio.h>
 #include <string.h>
+#include <locale.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/syscall.h>
+#include <stdlib.h>
+
+#include "modern_menu_model.h"
 
 
 /* ========== SECCIÓN 2: DEFINES Y MACROS ========== */
@@ -37,32 +45,77 @@
 #endif
 
 /* ========== SECCIÓN 3: ESTRUCTURAS ========== */
+typedef struct _SearchPipeline SearchPipeline;
+
+/* Página ya armada de una categoría (ver CACHÉ DE PÁGINAS POR CATEGORÍA) */
+typedef struct {
+    gchar *id;
+    GPtrArray *items;           // AppEntry* visibles (con referencia)
+    GPtrArray *buttons;         // primera pantalla (con referencia, fijados)
+    gdouble scroll;
+    guint stamp;
+    gsize cost;
+} CategoryPage;
+
 typedef struct {
     // UI widgets
     GtkWidget *icon, *window, *search, *categories, *apps_box, *apps_scroll, *plugin_button, *btn_fav;
+    GtkWidget *apps_grid, *apps_message;
+
+    // Grilla: modelo (AppEntry*), botones colocados en pantalla y pool por ID
+    GPtrArray *grid_items, *grid_buttons;
+    GHashTable *button_pool;
+    guint pool_clock;
+    int grid_page_height;
+
+    // Páginas de categorías ya armadas (id -> CategoryPage*), con LRU
+    GHashTable *pages;
+    CategoryPage *grid_page;  // la que está en la grilla, o NULL
+    guint page_clock;
+    gsize page_cache_used, page_cache_limit;
+    gchar *page_hover_id;
+    guint page_prefetch_id;
 
     // Datos
     MenuCache *menu_cache;
-    MenuCacheDir *current_dir;
+    CategoryEntry *current_dir;  // del catálogo actual; NULL en favoritos
+    gchar *current_dir_id;
     GtkListStore *cat_store;
     LXPanel *panel;
     config_setting_t *settings;
 
     // Listas
-    GSList *all_apps, *favorites, *hidden_apps;
+    Catalog *catalog;            // apps sin duplicados y categorías de primer nivel
+    GHashTable *favorites, *hidden_apps;  // conjuntos de ids
+    SearchIndex *search_index;   // nombres de catalog->apps, en el mismo orden
+    SearchPipeline *search_pipeline;
 
     // Paths
     gchar *favorites_path, *icon_path;
 
     // Estado
     gboolean window_shown, suppress_hide, switching_category;
+    gboolean view_dirty;         // la vista cambió con la ventana oculta
+    gboolean position_valid, position_tracked;
+    int window_x, window_y;      // posición calculada para la geometría actual
     gpointer reload_notify;
+    guint reload_id;
+    guint init_idle_id, window_idle_id;
+    gboolean user_data_loaded, catalog_ready, catalog_live;
+    guint catalog_save_id;
+    gboolean preload;            // precarga en reposo (opcional)
+    int preload_apps, preload_budget_mb;
+    guint preload_id;
     FmDndSrc *ds;
+    GtkWidget *drag_button;     // botón al que apunta ds (puntero débil)
+
+    // Métricas de trazas abiertas (0 = ninguna)
+    gint64 trace_click, trace_keystroke;
 } ModernMenu;
 
 enum {
     COL_NAME = 0,
-    COL_DIR_PTR,
+    COL_DIR_ID,
     N_COLS
 };
 
@@ -71,26 +124,29 @@ extern void logout(void); // Llama a la función de logout de la configuración
 /* ========== SECCIÓN 4: DECLARACIONES ========== */
 
 // Iconos y gráficos
-static GdkPixbuf *get_app_icon(MenuCacheItem *item, int size);
+static GdkPixbuf *get_app_icon(AppEntry *e, int size);
 
 // UI y widgets
-static GtkWidget* create_app_button(MenuCacheItem *item, ModernMenu *m);
-static void populate_apps_for_dir(ModernMenu *m, MenuCacheDir *dir);
+static GtkWidget* create_app_button(AppEntry *e, ModernMenu *m, int rank);
+static void populate_apps_for_dir(ModernMenu *m, CategoryEntry *dir);
+static void category_pages_clear(ModernMenu *m);
 static void show_favorites_category(GtkWidget *widget, gpointer user_data);
 
 // Datos y persistencia
 static void load_favorites(ModernMenu *m);
 static void save_favorites(ModernMenu *m);
 static void load_hidden_apps(ModernMenu *m);
-static void build_all_apps_list(ModernMenu *m);
+static void build_all_apps_list(ModernMenu *m, GHashTable *touched);
+static void catalog_snapshot_save_later(ModernMenu *m);
 
 // Eventos y callbacks
 static void show_error_dialog(const gchar *message);
 static void show_properties(GtkMenuItem *menuitem, gpointer user_data);
 static void launch_app_from_item(GtkWidget *button, gpointer user_data);
+static void launch_app_entry(ModernMenu *m, AppEntry *e, GdkScreen *screen);
 static gboolean on_app_button_press(GtkWidget *widget, GdkEventButton *event, gpointer user_data);
 static void on_app_drag_begin(GtkWidget *widget, GdkDragContext *context, gpointer user_data);
-static void on_app_drag_data_get(FmDndSrc *ds, GtkWidget *btn);
+static void on_app_drag_data_get(FmDndSrc *ds, gpointer user_data);
 static void on_remove_package(GtkWidget *widget, gpointer user_data);
 static void toggle_favorite(GtkWidget *menuitem, gpointer user_data);
 
@@ -103,414 +159,2381 @@ static void add_to_desktop(GtkMenuItem *menuitem, gpointer user_data);
 static void modern_menu_destructor(gpointer user_data);
 static gboolean modernmenu_apply_config(gpointer user_data);
 static void on_menu_cache_reload_real(MenuCache *cache, gpointer user_data);
+static gboolean modernmenu_idle_init(gpointer user_data);
+static gboolean reload_apply(gpointer user_data);
+static void ensure_window(ModernMenu *m);
+static void view_invalidate(ModernMenu *m);
+static void modernmenu_load_user_data(ModernMenu *m);
 
 /* ========== SECCIÓN 5: IMPLEMENTACIONES ========== */
 
-/* ----- 5.1 Iconos y gráficos ----- */
+/* ==== REGISTRO DE VUELO Y WATCHDOG ==== */
+/* El plugin corre dentro de lxpanel: si bloquea el bucle principal se congela
+ * todo el panel. Un temporizador del bucle principal marca un latido cada
+ * WATCHDOG_TICK_MS y un hilo aparte controla que siga llegando; si se atrasa
+ * más que el umbral (MODERNMENU_WATCHDOG_MS o la clave "watchdog_ms", en ms;
+ * 1000 es un buen valor) vuelca el registro de vuelo. Viene apagado: encendido
+ * suma un hilo, un temporizador, el manejador de SIGUSR1 y dos escrituras al
+ * anillo por cada tramo TRACE_SPAN.
+ *
+ * El registro es un anillo sin locks con los últimos FLIGHT_SLOTS eventos:
+ * entrada y salida de los tramos TRACE_SPAN (de cualquier hilo) y marcas
+ * sueltas. Además se guarda el tramo más interno abierto en el hilo
+ * principal, que es lo que estaba haciendo el plugin al trabarse. SIGUSR1
+ * también pide un volcado (el manejador anterior se sigue llamando). El
+ * volcado va a ~/.cache/modernmenu/flight.log y siempre lo escribe el hilo
+ * del watchdog, nunca el manejador de la señal.
+ *
+ * Los diálogos modales (gtk_dialog_run) corren un bucle anidado que sigue
+ * latiendo, así que no cuentan como bloqueo; sí quedan en el registro. */
+#define FLIGHT_SLOTS 512            // potencia de 2
+#define WATCHDOG_TICK_MS 250
+#define WATCHDOG_DEFAULT_MS 0      // apagado salvo que se pida
 
+typedef struct {
+    gint seq;               // número de evento + 1; 0 mientras se escribe
+    char phase;             // 'B' entrada, 'E' salida, 'I' marca
+    const char *name;       // literal
+    gint64 ts;
+    gpointer thread;
+} FlightSlot;
+
+static struct {
+    gint ref_count;
+    gboolean enabled;
+    FlightSlot slots[FLIGHT_SLOTS];
+    gint next;
+    gint64 origin;
+    GThread *main_thread;
+    gpointer current;       // const char*: tramo abierto en el hilo principal
+    gint heartbeat;         // ms desde origin (módulo 2^32)
+    guint threshold_ms;
+    guint heartbeat_id;
+    GThread *thread;
+    GMutex lock;
+    GCond cond;
+    gboolean stop;
+    struct sigaction old_usr1;
+    volatile sig_atomic_t dump_requested;
+    gchar *path;
+} flight;
+
+static guint flight_now_ms(void)
+{
+    return (guint)((g_get_monotonic_time() - flight.origin) / 1000);
+}
 
-/* Obtener el icono de la app */
-static GdkPixbuf *get_app_icon(MenuCacheItem *item, int size)
+static void flight_record(char phase, const char *name)
 {
-    const char *icon_name = menu_cache_item_get_icon(item);
-    if (!icon_name || !*icon_name) {
-        icon_name = "application-x-executable"; // fallback seguro
-    }
+    if (!flight.enabled) return;
 
-    GtkIconTheme *theme = gtk_icon_theme_get_default();
-    GdkPixbuf *pb = NULL;
+    guint n = (guint)g_atomic_int_add(&flight.next, 1);
+    FlightSlot *slot = &flight.slots[n & (FLIGHT_SLOTS - 1)];
 
-    // Si es ruta absoluta
-    if (g_path_is_absolute(icon_name)) {
-        pb = gdk_pixbuf_new_from_file_at_scale(icon_name, size, size, TRUE, NULL);
-        if (pb) return pb;
-    }
+    g_atomic_int_set(&slot->seq, 0);
+    slot->phase = phase;
+    slot->name = name;
+    slot->ts = g_get_monotonic_time();
+    slot->thread = g_thread_self();
+    g_atomic_int_set(&slot->seq, (gint)(n + 1));
+}
 
-    // Quita extensión (.png, .svg, etc.)
-    gchar *icon_no_ext = g_strdup(icon_name);
-    gchar *dot = strrchr(icon_no_ext, '.');
-    if (dot && (g_strcmp0(dot, ".png") == 0 ||
-        g_strcmp0(dot, ".svg") == 0 ||
-        g_strcmp0(dot, ".xpm") == 0)) {
-        *dot = '\0';
-        }
+/* Escribe el anillo, del evento más viejo al más nuevo. Corre en el hilo del
+ * watchdog mientras el principal puede seguir escribiendo: los eventos que se
+ * pisan durante la copia se descartan por número de secuencia. */
+static void flight_dump(const char *reason, guint lag_ms)
+{
+    const char *current = g_atomic_pointer_get(&flight.current);
+    guint end = (guint)g_atomic_int_get(&flight.next);
+    guint start = end > FLIGHT_SLOTS ? end - FLIGHT_SLOTS : 0;
+    gint64 now = g_get_monotonic_time();
+    GString *out = g_string_new(NULL);
+
+    g_string_append_printf(out, "modernmenu flight recorder\nreason: %s\npid: %d\n"
+                           "main loop lag: %u ms\ncurrent operation: %s\nevents: %u\n\n",
+                           reason, (int)getpid(), lag_ms, current ? current : "(idle)", end - start);
+
+    for (guint n = start; n != end; n++) {
+        FlightSlot copy = flight.slots[n & (FLIGHT_SLOTS - 1)];
+        if ((guint)g_atomic_int_get(&flight.slots[n & (FLIGHT_SLOTS - 1)].seq) != n + 1 ||
+            (guint)copy.seq != n + 1)
+            continue;
+        g_string_append_printf(out, "%10.3f ms  %s  %c %s\n",
+                               (copy.ts - now) / 1000.0,
+                               copy.thread == (gpointer)flight.main_thread ? "main  " : "worker",
+                               copy.phase, copy.name);
+    }
 
-        // Busca en el tema
-        pb = gtk_icon_theme_load_icon(theme, icon_no_ext, size,
-                                      GTK_ICON_LOOKUP_USE_BUILTIN |
-                                      GTK_ICON_LOOKUP_FORCE_SIZE, NULL);
+    GError *error = NULL;
+    if (!g_file_set_contents(flight.path, out->str, out->len, &error)) {
+        g_warning("modernmenu: could not write flight recorder: %s", error->message);
+        g_error_free(error);
+    }
+    g_string_free(out, TRUE);
+}
 
-        g_free(icon_no_ext);
+static gboolean flight_heartbeat(gpointer user_data)
+{
+    (void)user_data;
+    g_atomic_int_set(&flight.heartbeat, (gint)flight_now_ms());
+    return G_SOURCE_CONTINUE;
+}
 
-        // Fallback si no se encontró
-        if (!pb) {
-            pb = gtk_icon_theme_load_icon(theme, "application-x-executable", size,
-                                          GTK_ICON_LOOKUP_USE_BUILTIN |
-                                          GTK_ICON_LOOKUP_FORCE_SIZE, NULL);
+static gpointer watchdog_thread(gpointer user_data)
+{
+    (void)user_data;
+    gboolean stalled = FALSE;
+
+    g_mutex_lock(&flight.lock);
+    while (!flight.stop) {
+        g_cond_wait_until(&flight.cond, &flight.lock,
+                          g_get_monotonic_time() + WATCHDOG_TICK_MS * G_TIME_SPAN_MILLISECOND);
+        if (flight.stop) break;
+        g_mutex_unlock(&flight.lock);
+
+        guint lag = flight_now_ms() - (guint)g_atomic_int_get(&flight.heartbeat);
+        if (flight.dump_requested) {
+            flight.dump_requested = 0;
+            flight_dump("SIGUSR1", lag);
+        }
+        if (lag > flight.threshold_ms + WATCHDOG_TICK_MS) {
+            // Un volcado por bloqueo, apenas se detecta
+            if (!stalled) {
+                const char *current = g_atomic_pointer_get(&flight.current);
+                g_warning("modernmenu: main loop stalled for %u ms in %s; see %s",
+                          lag, current ? current : "(idle)", flight.path);
+                flight_dump("main loop stall", lag);
+            }
+            stalled = TRUE;
+        } else {
+            stalled = FALSE;
         }
 
-        return pb;
+        g_mutex_lock(&flight.lock);
+    }
+    g_mutex_unlock(&flight.lock);
+    return NULL;
 }
 
-/* ===== 5.2 FUNCIONES DE DATOS Y PERSISTENCIA ===== */
-/* ==== FAVORITOS ==== */
-static void load_favorites(ModernMenu *m)
+/* Sólo marca el pedido (async-signal-safe) y encadena al manejador anterior */
+static void flight_on_sigusr1(int sig, siginfo_t *info, void *context)
 {
-    g_return_if_fail(m != NULL);
-
-    gchar *config_dir = g_build_filename(g_get_user_config_dir(), "modernmenu", NULL);
-    g_mkdir_with_parents(config_dir, 0700);
-    m->favorites_path = g_build_filename(config_dir, "favorites.list", NULL);
-    g_free(config_dir);
+    flight.dump_requested = 1;
 
-    m->favorites = NULL;
-
-    if (!g_file_test(m->favorites_path, G_FILE_TEST_EXISTS))
-        return;
-
-    gchar *content = NULL;
-    if (g_file_get_contents(m->favorites_path, &content, NULL, NULL) && content) {
-        gchar **lines = g_strsplit(content, "\n", -1);
-        for (int i = 0; lines[i]; i++) {
-            if (g_strcmp0(lines[i], "") != 0)
-                m->favorites = g_slist_prepend(m->favorites, g_strdup(lines[i]));
-        }
-        g_strfreev(lines);
-        g_free(content);
+    if (flight.old_usr1.sa_flags & SA_SIGINFO) {
+        if (flight.old_usr1.sa_sigaction)
+            flight.old_usr1.sa_sigaction(sig, info, context);
+    } else if (flight.old_usr1.sa_handler != SIG_DFL && flight.old_usr1.sa_handler != SIG_IGN) {
+        flight.old_usr1.sa_handler(sig);
     }
 }
 
-static void save_favorites(ModernMenu *m)
+static void watchdog_ref(config_setting_t *settings)
 {
-    if (!m || !m->favorites_path) return;
-
-    GString *data = g_string_new("");
-    for (GSList *l = m->favorites; l; l = l->next)
-        g_string_append_printf(data, "%s\n", (char*)l->data);
-    g_file_set_contents(m->favorites_path, data->str, -1, NULL);
-    g_string_free(data, TRUE);
+    if (flight.ref_count++ > 0) return;
+
+    int threshold = WATCHDOG_DEFAULT_MS;
+    const char *env = g_getenv("MODERNMENU_WATCHDOG_MS");
+    if (env && *env)
+        threshold = atoi(env);
+    else if (settings)
+        config_setting_lookup_int(settings, "watchdog_ms", &threshold);
+    if (threshold <= 0) return;
+
+    gchar *dir = g_build_filename(g_get_user_cache_dir(), "modernmenu", NULL);
+    g_mkdir_with_parents(dir, 0700);
+    flight.path = g_build_filename(dir, "flight.log", NULL);
+    g_free(dir);
+
+    flight.origin = g_get_monotonic_time();
+    flight.main_thread = g_thread_self();
+    flight.threshold_ms = threshold;
+    flight.heartbeat = 0;
+    flight.stop = FALSE;
+    flight.enabled = TRUE;
+    flight.heartbeat_id = g_timeout_add(WATCHDOG_TICK_MS, flight_heartbeat, NULL);
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_sigaction = flight_on_sigusr1;
+    sa.sa_flags = SA_SIGINFO | SA_RESTART;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGUSR1, &sa, &flight.old_usr1);
+
+    flight.thread = g_thread_try_new("modernmenu-watchdog", watchdog_thread, NULL, NULL);
 }
 
-static gboolean is_favorite(ModernMenu *m, const char *app_id)
+static void watchdog_unref(void)
 {
-    if (!app_id) return FALSE;
+    if (flight.ref_count == 0 || --flight.ref_count > 0 || !flight.enabled) return;
+
+    g_mutex_lock(&flight.lock);
+    flight.stop = TRUE;
+    g_cond_signal(&flight.cond);
+    g_mutex_unlock(&flight.lock);
+    if (flight.thread)
+        g_thread_join(flight.thread);
+    flight.thread = NULL;
+
+    // Devolver SIGUSR1 sólo si nadie lo tomó después
+    struct sigaction current;
+    if (sigaction(SIGUSR1, NULL, &current) == 0 &&
+        (current.sa_flags & SA_SIGINFO) && current.sa_sigaction == flight_on_sigusr1)
+        sigaction(SIGUSR1, &flight.old_usr1, NULL);
+
+    g_source_remove(flight.heartbeat_id);
+    flight.heartbeat_id = 0;
+    flight.enabled = FALSE;
+    g_free(flight.path);
+    flight.path = NULL;
+}
 
-    for (GSList *l = m->favorites; l; l = l->next) {
-        if (g_strcmp0(l->data, app_id) == 0) {
-            return TRUE;
-        }
+/* ==== TRAZAS DE LATENCIA ==== */
+/* Tramos (spans) medidos alrededor de los caminos calientes, escritos en el
+ * formato JSON de eventos de Chrome ("traceEvents"), que abren Perfetto y
+ * chrome://tracing. Se activa con MODERNMENU_TRACE=<archivo> (o =1 para
+ * ~/.cache/modernmenu/trace.json) o con la clave "trace" de la
+ * configuración. Con esto y el watchdog apagados, cada tramo cuesta una
+ * comparación.
+ *
+ * Además de los tramos por función se registran dos métricas derivadas:
+ * click-to-first-paint (click en el botón del panel hasta el primer expose
+ * de la ventana) y keystroke-to-results (primera tecla sin atender hasta
+ * que la grilla muestra los resultados). El archivo se reescribe completo
+ * TRACE_FLUSH_DELAY segundos después del último evento y al destruir el
+ * plugin. */
+#define TRACE_FLUSH_DELAY 2
+#define TRACE_MAX_BYTES (8 * 1024 * 1024)
+
+typedef struct {
+    const char *name;
+    gint64 start;           // 0 si las trazas y el watchdog están apagados
+    gpointer outer;         // tramo abierto antes en el hilo principal
+    gboolean main;
+} TraceSpan;
+
+static struct {
+    gboolean enabled;
+    GMutex lock;
+    GString *events;        // eventos separados por coma, sin corchetes
+    gchar *path;
+    guint flush_id;
+    guint dropped;
+    gint next_tid;
+} trace;
+
+static int trace_tid(void)
+{
+    static GPrivate tid_key;
+    int tid = GPOINTER_TO_INT(g_private_get(&tid_key));
+    if (!tid) {
+        tid = g_atomic_int_add(&trace.next_tid, 1) + 1;
+        g_private_set(&tid_key, GINT_TO_POINTER(tid));
     }
-    return FALSE;
+    return tid;
 }
 
-static void toggle_favorite(GtkWidget *menuitem, gpointer user_data)
+/* Prende las trazas si lo piden el entorno o la configuración */
+static void trace_init(config_setting_t *settings)
 {
-    GtkWidget *btn = GTK_WIDGET(user_data);
-    ModernMenu *m = g_object_get_data(G_OBJECT(btn), "modern-menu");
-    MenuCacheItem *item = g_object_get_data(G_OBJECT(btn), "menu-item");
-
-    if (!m || !item) return;
-
-    const char *id = menu_cache_item_get_id(item);
-    if (!id) return;
-
-    if (is_favorite(m, id)) {
-        GSList *node = m->favorites;
-        while (node) {
-            if (g_strcmp0(node->data, id) == 0) {
-                g_free(node->data);
-                m->favorites = g_slist_delete_link(m->favorites, node);
-                break;
-            }
-            node = node->next;
-        }
+    if (trace.events) return;
+
+    const char *value = g_getenv("MODERNMENU_TRACE");
+    if ((!value || !*value) && settings)
+        config_setting_lookup_string(settings, "trace", &value);
+    if (!value || !*value || g_strcmp0(value, "0") == 0) return;
+
+    if (g_strcmp0(value, "1") == 0) {
+        gchar *dir = g_build_filename(g_get_user_cache_dir(), "modernmenu", NULL);
+        g_mkdir_with_parents(dir, 0700);
+        trace.path = g_build_filename(dir, "trace.json", NULL);
+        g_free(dir);
     } else {
-        m->favorites = g_slist_prepend(m->favorites, g_strdup(id));
+        trace.path = g_strdup(value);
     }
+    trace.events = g_string_new("");
+    trace.enabled = TRUE;
+    g_message("modernmenu: writing trace to %s", trace.path);
+}
 
-    save_favorites(m);
+static void trace_flush(void)
+{
+    if (!trace.enabled) return;
 
-    // Actualizar label del menu contextual
-    GtkWidget *menu = gtk_widget_get_parent(menuitem);
-    if (menu) {
-        gtk_widget_destroy(menuitem);
-        GtkWidget *new_item;
-        if (is_favorite(m, id))
-            new_item = gtk_menu_item_new_with_label(_("Remove from Favorites"));
-        else
-            new_item = gtk_menu_item_new_with_label(_("Add to Favorites"));
-        gtk_menu_shell_append(GTK_MENU_SHELL(menu), new_item);
-        gtk_widget_show(new_item);
-        g_signal_connect(new_item, "activate", G_CALLBACK(toggle_favorite), btn);
+    g_mutex_lock(&trace.lock);
+    if (trace.flush_id) {
+        g_source_remove(trace.flush_id);
+        trace.flush_id = 0;
+    }
+    GString *out = g_string_sized_new(trace.events->len + 64);
+    g_string_append(out, "{\"traceEvents\":[");
+    g_string_append_len(out, trace.events->str, trace.events->len);
+    g_string_append_printf(out, "],\"displayTimeUnit\":\"ms\",\"otherData\":{\"dropped\":%u}}\n",
+                           trace.dropped);
+    g_mutex_unlock(&trace.lock);
+
+    GError *error = NULL;
+    if (!g_file_set_contents(trace.path, out->str, out->len, &error)) {
+        g_warning("modernmenu: could not write trace: %s", error->message);
+        g_error_free(error);
     }
+    g_string_free(out, TRUE);
 }
-/* ==== FIN FAVORITOS ==== */
 
-/* ===== OCULTAS ===== */
+static gboolean trace_flush_timeout(gpointer user_data)
+{
+    (void)user_data;
+    g_mutex_lock(&trace.lock);
+    trace.flush_id = 0;
+    g_mutex_unlock(&trace.lock);
+    trace_flush();
+    return G_SOURCE_REMOVE;
+}
 
-/* Cargar lista de apps ocultas desde archivo */
-static void load_hidden_apps(ModernMenu *m)
+/* Agrega un evento completo ("ph":"X"); name debe ser un literal */
+static void trace_complete(const char *name, const char *cat, gint64 start, gint64 end)
 {
-    if (m->hidden_apps) {
-        g_slist_free_full(m->hidden_apps, g_free);
-        m->hidden_apps = NULL;
+    int tid = trace_tid();
+
+    g_mutex_lock(&trace.lock);
+    if (trace.events->len >= TRACE_MAX_BYTES) {
+        trace.dropped++;
+    } else {
+        g_string_append_printf(trace.events,
+                               "%s{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%" G_GINT64_FORMAT
+                               ",\"dur\":%" G_GINT64_FORMAT ",\"pid\":%d,\"tid\":%d}",
+                               trace.events->len ? ",\n" : "", name, cat, start, end - start,
+                               (int)getpid(), tid);
     }
+    if (!trace.flush_id)
+        trace.flush_id = g_timeout_add_seconds(TRACE_FLUSH_DELAY, trace_flush_timeout, NULL);
+    g_mutex_unlock(&trace.lock);
+}
 
-    const char *home = g_get_home_dir();
-    gchar *hidden_file = g_build_filename(home, ".config", "modernmenu", "hidden.list", NULL);
-
-    FILE *f = fopen(hidden_file, "r");
-    if (f) {
-        char line[512];
-        while (fgets(line, sizeof(line), f)) {
-            g_strstrip(line);
-            if (*line && *line != '#') {
-                m->hidden_apps = g_slist_prepend(m->hidden_apps, g_strdup(line));
-            }
+static inline TraceSpan trace_begin(const char *name)
+{
+    TraceSpan span = { name, 0, NULL, FALSE };
+    if (!trace.enabled && !flight.enabled) return span;
+
+    span.start = g_get_monotonic_time();
+    if (flight.enabled) {
+        flight_record('B', name);
+        span.main = g_thread_self() == flight.main_thread;
+        if (span.main) {
+            span.outer = g_atomic_pointer_get(&flight.current);
+            g_atomic_pointer_set(&flight.current, (gpointer)name);
         }
-        fclose(f);
     }
-    g_free(hidden_file);
+    return span;
 }
 
-/* Guardar lista de apps ocultas */
-static void save_hidden_apps(ModernMenu *m)
+static void trace_end(TraceSpan *span)
 {
-    const char *home = g_get_home_dir();
-    gchar *config_dir = g_build_filename(home, ".config", "modernmenu", NULL);
-    g_mkdir_with_parents(config_dir, 0755);
+    if (!span->start) return;
 
-    gchar *hidden_file = g_build_filename(config_dir, "hidden.list", NULL);
-    FILE *f = fopen(hidden_file, "w");
-
-    if (f) {
-        fprintf(f, _("# Hidden applications for Modern Menu\n"));
-        for (GSList *l = m->hidden_apps; l; l = l->next) {
-            fprintf(f, "%s\n", (char *)l->data);
-        }
-        fclose(f);
+    if (flight.enabled) {
+        flight_record('E', span->name);
+        if (span->main)
+            g_atomic_pointer_set(&flight.current, span->outer);
     }
-
-    g_free(hidden_file);
-    g_free(config_dir);
+    if (trace.enabled)
+        trace_complete(span->name, "span", span->start, g_get_monotonic_time());
 }
 
-/* Verificar si una app está oculta */
-static gboolean is_hidden(ModernMenu *m, const char *app_id)
+/* Tramo que termina solo al salir del bloque (cleanup de GCC/Clang, como g_autoptr) */
+#define TRACE_SPAN(name) \
+    TraceSpan _trace_span __attribute__((cleanup(trace_end), unused)) = trace_begin(name)
+
+/* Marca el inicio de una métrica si no hay una abierta */
+static inline void trace_mark(gint64 *since)
 {
-    if (!app_id || !m->hidden_apps) return FALSE;
-    return (g_slist_find_custom(m->hidden_apps, app_id, (GCompareFunc)g_strcmp0) != NULL);
+    if (trace.enabled && !*since)
+        *since = g_get_monotonic_time();
 }
 
-static void toggle_hidden(GtkMenuItem *item, gpointer user_data)
+/* Cierra la métrica abierta en *since, si la hay */
+static void trace_metric(const char *name, gint64 *since)
 {
-    GtkWidget *app_button = GTK_WIDGET(user_data);
-    MenuCacheItem *menu_item = g_object_get_data(G_OBJECT(app_button), "menu-item");
-    ModernMenu *m = g_object_get_data(G_OBJECT(app_button), "modern-menu");
+    if (!*since) return;
+    trace_complete(name, "metric", *since, g_get_monotonic_time());
+    *since = 0;
+}
 
-    if (!menu_item || !m) return;
+/* ----- 5.1 Iconos y gráficos ----- */
 
-    const char *app_id = menu_cache_item_get_id(menu_item);
-    if (!app_id) return;
 
-    GSList *found = g_slist_find_custom(m->hidden_apps, app_id, (GCompareFunc)g_strcmp0);
+/* ==== ATLAS DE ICONOS EN DISCO ==== */
+/* Iconos ya escalados a los tamaños que usa el plugin (48 y 24 px) guardados en
+ * un único archivo ~/.cache/modernmenu/icons.atlas que se mapea en memoria.
+ * Cada entrada se indexa por "tema:tamaño:nombre" y se valida con el mtime del
+ * archivo de origen; los pixbufs apuntan directo a las páginas del mapa, sin
+ * decodificar nada. El archivo siempre se reescribe completo (temporal +
+ * rename), nunca se modifica mientras está mapeado. El contenido nuevo se
+ * arma en el bucle principal (sólo copias en memoria) y lo escribe un hilo
+ * propio; al terminar se vuelve a mapear. */
+#define ATLAS_MAGIC "MMATLAS"
+#define ATLAS_VERSION 1
+#define ATLAS_BYTE_ORDER 0x01020304
+#define ATLAS_MAX_BYTES (32 * 1024 * 1024)
+#define ATLAS_SAVE_DELAY 5  // segundos tras el último icono nuevo
 
-    if (found) {
-        // Mostrar
-        m->hidden_apps = g_slist_remove(m->hidden_apps, found->data);
-        g_free(found->data);
-    } else {
-        // Ocultar
-        m->hidden_apps = g_slist_prepend(m->hidden_apps, g_strdup(app_id));
-    }
+typedef struct {
+    char magic[8];
+    guint32 version;
+    guint32 byte_order;
+    guint32 n_entries;
+    guint32 reserved;
+} AtlasHeader;
 
-    save_hidden_apps(m);
+typedef struct {
+    gint64 mtime;           // mtime del archivo de origen
+    guint32 key_offset;     // clave terminada en NUL
+    guint32 key_len;
+    guint32 data_offset;    // píxeles, alineados a 16 bytes
+    guint16 width, height;
+    guint32 rowstride;
+    guint32 has_alpha;
+} AtlasEntry;
 
-    // Refrescar la vista actual
-    if (m->current_dir) {
-        populate_apps_for_dir(m, m->current_dir);
-    } else {
-        show_favorites_category(NULL, m);
-    }
+typedef struct {
+    gint64 mtime;
+    GdkPixbuf *pixbuf;
+    guint serial;           // orden de llegada, para saber si ya se escribió
+} AtlasPending;
+
+typedef struct {
+    GMappedFile *map;
+    GHashTable *index;      // clave (dentro del mapa) -> const AtlasEntry*
+    GHashTable *pending;    // clave -> AtlasPending* aún no escrito
+    gchar *path;
+    gchar *theme_name;
+    guint save_id;
+    GThreadPool *writer;    // un solo hilo
+    gboolean writing;       // hay una escritura en curso
+    guint serial;
+} IconAtlas;
+
+static IconAtlas icon_atlas;
+static guint atlas_epoch;   // cambia al cerrar: escrituras viejas no tocan el estado nuevo
+
+typedef struct {
+    gchar *path;
+    gchar *data;
+    gsize length;
+    guint serial;           // pendientes hasta este número van en data
+    guint epoch;
+} AtlasWrite;
+
+static gboolean atlas_size_cached(int size)
+{
+    return size == 48 || size == 24;
 }
-/* ===== FIN OCULTAS ===== */
 
-static void load_categories(ModernMenu *m)
+static void atlas_pending_free(gpointer data)
 {
-    if (!m || !m->cat_store || !m->menu_cache) return;
+    AtlasPending *p = data;
+    g_object_unref(p->pixbuf);
+    g_free(p);
+}
 
-    gtk_list_store_clear(m->cat_store);
+static void atlas_update_theme_name(void)
+{
+    g_free(icon_atlas.theme_name);
+    icon_atlas.theme_name = NULL;
+    g_object_get(gtk_settings_get_default(), "gtk-icon-theme-name", &icon_atlas.theme_name, NULL);
+    if (!icon_atlas.theme_name)
+        icon_atlas.theme_name = g_strdup("hicolor");
+}
 
-    #if MENU_CACHE_CHECK_VERSION(0,4,0)
-    MenuCacheDir *root = menu_cache_dup_root_dir(m->menu_cache);
-    #else
-    MenuCacheDir *root = menu_cache_get_root_dir(m->menu_cache);
-    #endif
-    if (!root) return;
+static void atlas_unmap(void)
+{
+    if (icon_atlas.index) {
+        g_hash_table_destroy(icon_atlas.index);
+        icon_atlas.index = NULL;
+    }
+    if (icon_atlas.map) {
+        g_mapped_file_unref(icon_atlas.map);
+        icon_atlas.map = NULL;
+    }
+}
+
+/* Mapea el archivo y arma el índice; las entradas dañadas se ignoran */
+static void atlas_map(void)
+{
+    icon_atlas.map = g_mapped_file_new(icon_atlas.path, FALSE, NULL);
+    if (!icon_atlas.map) return;
+
+    gsize len = g_mapped_file_get_length(icon_atlas.map);
+    const gchar *base = g_mapped_file_get_contents(icon_atlas.map);
+    const AtlasHeader *h = (const AtlasHeader *)base;
+
+    if (len < sizeof(AtlasHeader) ||
+        memcmp(h->magic, ATLAS_MAGIC, sizeof(h->magic)) != 0 ||
+        h->version != ATLAS_VERSION || h->byte_order != ATLAS_BYTE_ORDER ||
+        h->n_entries > (len - sizeof(AtlasHeader)) / sizeof(AtlasEntry)) {
+        g_debug("modernmenu: discarding invalid icon atlas %s", icon_atlas.path);
+        atlas_unmap();
+        return;
+    }
+
+    icon_atlas.index = g_hash_table_new(g_str_hash, g_str_equal);
+    const AtlasEntry *entries = (const AtlasEntry *)(base + sizeof(AtlasHeader));
 
-    GSList *children = menu_cache_dir_list_children(root);
-    gboolean first = TRUE;
-    GtkTreeIter first_iter;
+    for (guint32 i = 0; i < h->n_entries; i++) {
+        const AtlasEntry *e = &entries[i];
+        guint n_channels = e->has_alpha ? 4 : 3;
 
-    for (GSList *l = children; l; l = l->next) {
-        MenuCacheItem *item = MENU_CACHE_ITEM(l->data);
-        if (menu_cache_item_get_type(item) != MENU_CACHE_TYPE_DIR)
+        // En 64 bits: en i386 estas sumas en gsize pueden dar la vuelta
+        if ((guint64)e->key_offset + e->key_len >= len || base[e->key_offset + e->key_len] != '\0')
+            continue;
+        if (e->width == 0 || e->height == 0 || e->rowstride < e->width * n_channels)
+            continue;
+        if ((guint64)e->data_offset + (guint64)e->rowstride * e->height > len)
             continue;
 
-        const char *name = menu_cache_item_get_name(item);
-        MenuCacheDir *dir_ptr = MENU_CACHE_DIR(item);
+        g_hash_table_insert(icon_atlas.index, (gpointer)(base + e->key_offset), (gpointer)e);
+    }
+}
 
+static void atlas_write_free(AtlasWrite *w)
+{
+    g_free(w->path);
+    g_free(w->data);
+    g_free(w);
+}
 
-        GtkTreeIter iter;
-        gtk_list_store_append(m->cat_store, &iter);
-        gtk_list_store_set(m->cat_store, &iter,
-                           COL_NAME, name ? name : "",
-                           COL_DIR_PTR, dir_ptr,
-                           -1);
+static gboolean atlas_save(gpointer user_data);
 
-        if (first) {
-            first_iter = iter;
-            first = FALSE;
-        }
-    }
+/* Ya escrito: soltar lo pendiente que entró en el archivo y volver a mapear */
+static gboolean atlas_write_done(gpointer data)
+{
+    AtlasWrite *w = data;
 
-    if (!first) {
-        GtkTreeSelection *sel = gtk_tree_view_get_selection(GTK_TREE_VIEW(m->categories));
-        gtk_tree_selection_select_iter(sel, &first_iter);
-    }
+    if (w->epoch == atlas_epoch && icon_atlas.pending) {
+        icon_atlas.writing = FALSE;
 
-    g_slist_foreach(children, (GFunc)menu_cache_item_unref, NULL);
-    g_slist_free(children);
+        GHashTableIter it;
+        gpointer value;
+        g_hash_table_iter_init(&it, icon_atlas.pending);
+        while (g_hash_table_iter_next(&it, NULL, &value))
+            if (((AtlasPending *)value)->serial <= w->serial)
+                g_hash_table_iter_remove(&it);
 
-    #if MENU_CACHE_CHECK_VERSION(0,4,0)
-    menu_cache_item_unref(MENU_CACHE_ITEM(root));
-    #endif
+        // Los pixbufs ya entregados conservan su referencia al mapa anterior
+        atlas_unmap();
+        atlas_map();
+
+        // Llegaron iconos mientras se escribía
+        if (g_hash_table_size(icon_atlas.pending) && !icon_atlas.save_id)
+            icon_atlas.save_id = g_timeout_add_seconds(ATLAS_SAVE_DELAY, atlas_save, NULL);
+    }
+    atlas_write_free(w);
+    return G_SOURCE_REMOVE;
 }
-static void build_all_apps_list(ModernMenu *m)
+
+static void atlas_write_worker(gpointer data, gpointer user_data)
 {
-    if (!m || !m->menu_cache) return;
+    (void)user_data;
+    TRACE_SPAN("atlas_write");
+    AtlasWrite *w = data;
+    GError *error = NULL;
 
-    if (m->all_apps) {
-        g_slist_free_full(m->all_apps, (GDestroyNotify)menu_cache_item_unref);
-        m->all_apps = NULL;
+    if (!g_file_set_contents(w->path, w->data, w->length, &error)) {
+        g_warning("modernmenu: could not write icon atlas: %s", error->message);
+        g_error_free(error);
     }
+    g_free(w->data);
+    w->data = NULL;
+    g_idle_add(atlas_write_done, w);
+}
 
-    #if MENU_CACHE_CHECK_VERSION(0,4,0)
-    MenuCacheDir *root = menu_cache_dup_root_dir(m->menu_cache);
-    #else
-    MenuCacheDir *root = menu_cache_get_root_dir(m->menu_cache);
-    #endif
-    if (!root) return;
+static void atlas_open(void)
+{
+    gchar *cache_dir = g_build_filename(g_get_user_cache_dir(), "modernmenu", NULL);
+    g_mkdir_with_parents(cache_dir, 0700);
+    icon_atlas.path = g_build_filename(cache_dir, "icons.atlas", NULL);
+    g_free(cache_dir);
+
+    icon_atlas.pending = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, atlas_pending_free);
+    icon_atlas.writer = g_thread_pool_new(atlas_write_worker, NULL, 1, FALSE, NULL);
+    atlas_update_theme_name();
+    atlas_map();
+}
 
-    GSList *stack = g_slist_append(NULL, root);
-    GSList *added_ids = NULL; // <--- lista temporal de IDs únicos
+typedef struct {
+    const char *key;
+    gint64 mtime;
+    guint width, height, n_channels, src_rowstride;
+    const guchar *pixels;
+} AtlasSource;
 
-    while (stack) {
-        MenuCacheDir *dir = stack->data;
-        stack = g_slist_delete_link(stack, stack);
+static gsize atlas_align(gsize n)
+{
+    return (n + 15) & ~(gsize)15;
+}
 
-        GSList *children = menu_cache_dir_list_children(dir);
-        for (GSList *l = children; l; l = l->next) {
-            MenuCacheItem *item = MENU_CACHE_ITEM(l->data);
-            if (menu_cache_item_get_type(item) == MENU_CACHE_TYPE_APP) {
-                const char *id = menu_cache_item_get_id(item);
-                if (!g_slist_find_custom(added_ids, id, (GCompareFunc)g_strcmp0)) {
-                    m->all_apps = g_slist_prepend(m->all_apps, menu_cache_item_ref(item));
-                    added_ids = g_slist_prepend(added_ids, (gpointer)id);
-                }
-            } else if (menu_cache_item_get_type(item) == MENU_CACHE_TYPE_DIR) {
-                stack = g_slist_prepend(stack, MENU_CACHE_DIR(item));
-            }
+/* Arma el atlas con las entradas vigentes más las pendientes y se lo pasa
+ * al hilo escritor. Con una escritura en curso espera a que termine, salvo
+ * al cerrar (user_data no NULL): la nueva sale detrás y la reemplaza. */
+static gboolean atlas_save(gpointer user_data)
+{
+    icon_atlas.save_id = 0;
+
+    if (!icon_atlas.pending || g_hash_table_size(icon_atlas.pending) == 0)
+        return G_SOURCE_REMOVE;
+    if (icon_atlas.writing && !user_data)
+        return G_SOURCE_REMOVE;  // atlas_write_done vuelve a programarlo
+
+    GArray *srcs = g_array_new(FALSE, FALSE, sizeof(AtlasSource));
+    gsize keys_size = 0, pixels_size = 0;
+    GHashTableIter it;
+    gpointer key, value;
+
+    // Primero las nuevas, luego las del mapa que no fueron reemplazadas
+    g_hash_table_iter_init(&it, icon_atlas.pending);
+    while (g_hash_table_iter_next(&it, &key, &value)) {
+        AtlasPending *p = value;
+        AtlasSource src = {
+            key, p->mtime,
+            gdk_pixbuf_get_width(p->pixbuf), gdk_pixbuf_get_height(p->pixbuf),
+            gdk_pixbuf_get_n_channels(p->pixbuf), gdk_pixbuf_get_rowstride(p->pixbuf),
+            gdk_pixbuf_get_pixels(p->pixbuf)
+        };
+        g_array_append_val(srcs, src);
+    }
+    if (icon_atlas.index) {
+        const gchar *base = g_mapped_file_get_contents(icon_atlas.map);
+        g_hash_table_iter_init(&it, icon_atlas.index);
+        while (g_hash_table_iter_next(&it, &key, &value)) {
+            const AtlasEntry *e = value;
+            if (g_hash_table_contains(icon_atlas.pending, key))
+                continue;
+            AtlasSource src = {
+                key, e->mtime, e->width, e->height, e->has_alpha ? 4 : 3,
+                e->rowstride, (const guchar *)base + e->data_offset
+            };
+            g_array_append_val(srcs, src);
         }
-        g_slist_foreach(children, (GFunc)menu_cache_item_unref, NULL);
-        g_slist_free(children);
     }
 
-    m->all_apps = g_slist_reverse(m->all_apps);
-    g_slist_free(added_ids); // liberamos la lista temporal
+    // Calcular tamaños respetando el límite total
+    guint n = 0;
+    for (; n < srcs->len; n++) {
+        AtlasSource *src = &g_array_index(srcs, AtlasSource, n);
+        gsize entry_bytes = strlen(src->key) + 1 +
+                            atlas_align((gsize)src->width * src->n_channels * src->height) +
+                            sizeof(AtlasEntry) + 16;
+        if (sizeof(AtlasHeader) + (n + 1) * sizeof(AtlasEntry) + keys_size + pixels_size + entry_bytes > ATLAS_MAX_BYTES)
+            break;
+        keys_size += strlen(src->key) + 1;
+        pixels_size += atlas_align((gsize)src->width * src->n_channels * src->height);
+    }
 
-    #if MENU_CACHE_CHECK_VERSION(0,4,0)
-    menu_cache_item_unref(MENU_CACHE_ITEM(root));
-    #endif
+    gsize keys_start = sizeof(AtlasHeader) + n * sizeof(AtlasEntry);
+    gsize data_start = atlas_align(keys_start + keys_size);
+    gsize total = data_start + pixels_size;
+    gchar *buf = g_malloc0(total);
+
+    AtlasHeader *h = (AtlasHeader *)buf;
+    memcpy(h->magic, ATLAS_MAGIC, sizeof(h->magic));
+    h->version = ATLAS_VERSION;
+    h->byte_order = ATLAS_BYTE_ORDER;
+    h->n_entries = n;
+
+    AtlasEntry *entries = (AtlasEntry *)(buf + sizeof(AtlasHeader));
+    gsize key_pos = keys_start, data_pos = data_start;
+
+    for (guint i = 0; i < n; i++) {
+        AtlasSource *src = &g_array_index(srcs, AtlasSource, i);
+        AtlasEntry *e = &entries[i];
+        gsize key_len = strlen(src->key);
+        guint row_bytes = src->width * src->n_channels;
+
+        e->mtime = src->mtime;
+        e->key_offset = key_pos;
+        e->key_len = key_len;
+        e->data_offset = data_pos;
+        e->width = src->width;
+        e->height = src->height;
+        e->rowstride = row_bytes;
+        e->has_alpha = src->n_channels == 4;
+
+        memcpy(buf + key_pos, src->key, key_len + 1);
+        key_pos += key_len + 1;
+
+        for (guint y = 0; y < src->height; y++)
+            memcpy(buf + data_pos + (gsize)y * row_bytes, src->pixels + (gsize)y * src->src_rowstride, row_bytes);
+        data_pos += atlas_align((gsize)row_bytes * src->height);
+    }
+
+    g_array_free(srcs, TRUE);
+
+    AtlasWrite *w = g_new0(AtlasWrite, 1);
+    w->path = g_strdup(icon_atlas.path);
+    w->data = buf;
+    w->length = total;
+    w->serial = icon_atlas.serial;
+    w->epoch = atlas_epoch;
+    icon_atlas.writing = TRUE;
+    g_thread_pool_push(icon_atlas.writer, w, NULL);
+
+    return G_SOURCE_REMOVE;
 }
-static gchar *get_exec_from_desktop(const char *desktop_file)
+
+/* La última escritura sigue en el hilo sin esperarla: si el proceso termina
+ * antes queda el atlas anterior, que es sólo una caché */
+static void atlas_close(void)
 {
-    if (!desktop_file) return NULL;
+    if (icon_atlas.save_id) {
+        g_source_remove(icon_atlas.save_id);
+        icon_atlas.save_id = 0;
+    }
+    atlas_save(GINT_TO_POINTER(TRUE));
+    atlas_epoch++;
+    g_thread_pool_free(icon_atlas.writer, FALSE, FALSE);
+    atlas_unmap();
+
+    if (icon_atlas.pending)
+        g_hash_table_destroy(icon_atlas.pending);
+    g_free(icon_atlas.path);
+    g_free(icon_atlas.theme_name);
+    memset(&icon_atlas, 0, sizeof(icon_atlas));
+}
 
-    GKeyFile *keyfile = g_key_file_new();
-    GError *error = NULL;
+/* Busca el icono rasterizado en el atlas. Si el tamaño se cachea en disco,
+ * devuelve en *mtime el del archivo de origen (para atlas_store) */
+static GdkPixbuf *atlas_lookup(const char *name, int size, const char *file, gint64 *mtime)
+{
+    *mtime = -1;
+    if (!icon_atlas.pending || !atlas_size_cached(size))
+        return NULL;
 
-    if (!g_key_file_load_from_file(keyfile, desktop_file, G_KEY_FILE_NONE, &error)) {
-        show_error_dialog(_("Could not load .desktop file."));
-        if (error) g_error_free(error);
-        g_key_file_free(keyfile);
+    GStatBuf st;
+    if (g_stat(file, &st) != 0)
         return NULL;
-    }
+    *mtime = st.st_mtime;
 
-    gchar *exec = g_key_file_get_string(keyfile, "Desktop Entry", "Exec", NULL);
-    g_key_file_free(keyfile);
+    gchar *key = g_strdup_printf("%s:%d:%s", icon_atlas.theme_name, size, name);
+    AtlasPending *p = g_hash_table_lookup(icon_atlas.pending, key);
+    const AtlasEntry *e = icon_atlas.index ? g_hash_table_lookup(icon_atlas.index, key) : NULL;
+    g_free(key);
 
-    if (!exec || !*exec) {
-        show_error_dialog(_("The .desktop file does not have a valid 'Exec' field."));
-        g_free(exec);
+    if (p && p->mtime == *mtime)
+        return g_object_ref(p->pixbuf);
+    if (!e || e->mtime != *mtime)
         return NULL;
-    }
 
-    /* Limpiar parámetros tipo %f, %u, %U, etc. */
-    gchar *cleaned = g_strdup(exec);
-    gchar *percent = strchr(cleaned, '%');
-    if (percent) *percent = '\0';
+    // Pixbuf sin copia sobre el mapa; mantiene viva una referencia al archivo
+    guchar *pixels = (guchar *)g_mapped_file_get_contents(icon_atlas.map) + e->data_offset;
+    return gdk_pixbuf_new_from_data(pixels, GDK_COLORSPACE_RGB, e->has_alpha, 8,
+                                    e->width, e->height, e->rowstride,
+                                    (GdkPixbufDestroyNotify)g_mapped_file_unref,
+                                    g_mapped_file_ref(icon_atlas.map));
+}
 
-    /* Eliminar comillas */
-    gchar *trimmed = g_strstrip(cleaned);
-    if (trimmed[0] == '"' || trimmed[0] == '\'') {
-        trimmed++;
-        size_t len = strlen(trimmed);
-        if (len > 0 && (trimmed[len - 1] == '"' || trimmed[len - 1] == '\'')) {
-            trimmed[len - 1] = '\0';
-        }
-    }
+static void atlas_store(const char *name, int size, gint64 mtime, GdkPixbuf *pb)
+{
+    if (!icon_atlas.pending || mtime < 0 ||
+        gdk_pixbuf_get_bits_per_sample(pb) != 8 ||
+        gdk_pixbuf_get_colorspace(pb) != GDK_COLORSPACE_RGB)
+        return;
 
-    gchar *result = g_strdup(trimmed);
-    g_free(cleaned);
-    g_free(exec);
+    AtlasPending *p = g_new0(AtlasPending, 1);
+    p->mtime = mtime;
+    p->pixbuf = g_object_ref(pb);
+    p->serial = ++icon_atlas.serial;
+    g_hash_table_replace(icon_atlas.pending,
+                         g_strdup_printf("%s:%d:%s", icon_atlas.theme_name, size, name), p);
+
+    if (icon_atlas.save_id)
+        g_source_remove(icon_atlas.save_id);
+    icon_atlas.save_id = g_timeout_add_seconds(ATLAS_SAVE_DELAY, atlas_save, NULL);
+}
+
+/* ==== CACHÉ DE ICONOS ==== */
+/* Caché compartida por todo el proceso (todas las instancias del plugin).
+ * Se indexa por "tamaño:nombre" y, una vez resuelto el archivo del tema,
+ * también por "tamaño:ruta" para que varias apps que usan el mismo archivo
+ * compartan un único GdkPixbuf. Los fallos se guardan con valor NULL. */
+typedef struct {
+    GHashTable *by_name;    // "tamaño:nombre" -> GdkPixbuf* (o NULL si falló)
+    GHashTable *by_file;    // "tamaño:ruta"   -> GdkPixbuf*
+    GtkIconTheme *theme;
+    gulong theme_changed_id;
+    guint users;            // instancias del plugin que usan la caché
+    guint hits, misses;
+} IconCache;
+
+static IconCache icon_cache;
+
+static void icon_cache_value_free(gpointer data)
+{
+    if (data) g_object_unref(data);
+}
+
+static void icon_cache_get_stats(guint *hits, guint *misses)
+{
+    if (hits) *hits = icon_cache.hits;
+    if (misses) *misses = icon_cache.misses;
+}
+
+static void icon_loader_cancel(void);
+
+static void icon_cache_flush(void)
+{
+    if (!icon_cache.by_name) return;
+
+    icon_loader_cancel();  // lo resuelto con el tema anterior ya no sirve
+
+    g_debug("modernmenu: icon cache flushed (%u entries, %u hits, %u misses)",
+            g_hash_table_size(icon_cache.by_name), icon_cache.hits, icon_cache.misses);
+    g_hash_table_remove_all(icon_cache.by_name);
+    g_hash_table_remove_all(icon_cache.by_file);
+}
+
+static void on_icon_theme_changed(GtkIconTheme *theme, gpointer user_data)
+{
+    (void)theme;
+    (void)user_data;
+    icon_cache_flush();
+    atlas_update_theme_name();
+}
+
+static void icon_loader_start(void);
+static void icon_loader_stop(void);
+
+static void icon_cache_ref(void)
+{
+    if (icon_cache.users++ > 0) return;
+
+    icon_cache.by_name = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, icon_cache_value_free);
+    icon_cache.by_file = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, icon_cache_value_free);
+    icon_cache.theme = g_object_ref(gtk_icon_theme_get_default());
+    icon_cache.theme_changed_id = g_signal_connect(icon_cache.theme, "changed",
+                                                   G_CALLBACK(on_icon_theme_changed), NULL);
+    atlas_open();
+    icon_loader_start();
+}
+
+static void icon_cache_unref(void)
+{
+    if (icon_cache.users == 0 || --icon_cache.users > 0) return;
+
+    guint hits, misses;
+    icon_cache_get_stats(&hits, &misses);
+    g_debug("modernmenu: icon cache stats: %u hits, %u misses", hits, misses);
+
+    icon_loader_stop();
+
+    g_signal_handler_disconnect(icon_cache.theme, icon_cache.theme_changed_id);
+    g_object_unref(icon_cache.theme);
+    g_hash_table_destroy(icon_cache.by_name);
+    g_hash_table_destroy(icon_cache.by_file);
+    memset(&icon_cache, 0, sizeof(icon_cache));
+    atlas_close();
+}
+
+/* Carga un archivo de icono reutilizando el pixbuf si otro nombre ya lo cargó.
+ * Antes de decodificar se prueba el atlas en disco */
+static GdkPixbuf *icon_cache_load_file(const char *file, const char *name, int size)
+{
+    gchar *file_key = g_strdup_printf("%d:%s", size, file);
+    GdkPixbuf *pb = icon_cache.by_file ? g_hash_table_lookup(icon_cache.by_file, file_key) : NULL;
+
+    if (pb) {
+        g_free(file_key);
+        return g_object_ref(pb);
+    }
+
+    gint64 mtime;
+    pb = atlas_lookup(name, size, file, &mtime);
+    if (!pb) {
+        pb = gdk_pixbuf_new_from_file_at_scale(file, size, size, TRUE, NULL);
+        if (pb)
+            atlas_store(name, size, mtime, pb);
+    }
+
+    if (pb && icon_cache.by_file)
+        g_hash_table_insert(icon_cache.by_file, file_key, g_object_ref(pb));
+    else
+        g_free(file_key);
+    return pb;
+}
+
+/* Busca un nombre en el tema; los iconos con archivo se comparten por ruta */
+static GdkPixbuf *icon_cache_load_themed(GtkIconTheme *theme, const char *name, int size)
+{
+    GtkIconInfo *info = gtk_icon_theme_lookup_icon(theme, name, size,
+                                                   GTK_ICON_LOOKUP_USE_BUILTIN |
+                                                   GTK_ICON_LOOKUP_FORCE_SIZE);
+    if (!info) return NULL;
+
+    GdkPixbuf *pb = NULL;
+    const gchar *file = gtk_icon_info_get_filename(info);
+    if (file)
+        pb = icon_cache_load_file(file, name, size);
+    if (!pb)
+        pb = gtk_icon_info_load_icon(info, NULL);  // iconos integrados (builtin)
+
+    gtk_icon_info_free(info);
+    return pb;
+}
+
+/* Resolución sin caché por nombre: ruta absoluta, tema y fallback genérico */
+static GdkPixbuf *load_icon_uncached(const char *icon_name, int size)
+{
+    TRACE_SPAN("load_icon_uncached");
+    GtkIconTheme *theme = gtk_icon_theme_get_default();
+    GdkPixbuf *pb = NULL;
+
+    // Si es ruta absoluta
+    if (g_path_is_absolute(icon_name)) {
+        pb = icon_cache_load_file(icon_name, icon_name, size);
+        if (pb) return pb;
+    }
+
+    // Quita extensión (.png, .svg, etc.)
+    gchar *icon_no_ext = g_strdup(icon_name);
+    gchar *dot = strrchr(icon_no_ext, '.');
+    if (dot && (g_strcmp0(dot, ".png") == 0 ||
+        g_strcmp0(dot, ".svg") == 0 ||
+        g_strcmp0(dot, ".xpm") == 0)) {
+        *dot = '\0';
+    }
+
+    // Busca en el tema
+    pb = icon_cache_load_themed(theme, icon_no_ext, size);
+    g_free(icon_no_ext);
+
+    // Fallback si no se encontró
+    if (!pb)
+        pb = icon_cache_load_themed(theme, "application-x-executable", size);
+
+    return pb;
+}
+
+/* Devuelve una referencia nueva (el llamador hace g_object_unref) o NULL */
+static GdkPixbuf *icon_cache_lookup(const char *icon_name, int size)
+{
+    if (!icon_cache.by_name)
+        return load_icon_uncached(icon_name, size);
+
+    gchar *key = g_strdup_printf("%d:%s", size, icon_name);
+    gpointer cached = NULL;
+
+    if (g_hash_table_lookup_extended(icon_cache.by_name, key, NULL, &cached)) {
+        icon_cache.hits++;
+        g_free(key);
+        return cached ? g_object_ref(cached) : NULL;
+    }
+
+    icon_cache.misses++;
+    GdkPixbuf *pb = load_icon_uncached(icon_name, size);
+    // Se guarda incluso si falló, para no volver a recorrer el tema
+    g_hash_table_insert(icon_cache.by_name, key, pb ? g_object_ref(pb) : NULL);
+    return pb;
+}
+
+/* Nombre de icono de la app, con fallback seguro */
+static const char *app_icon_name(AppEntry *e)
+{
+    const char *icon_name = e->icon;
+    if (!icon_name || !*icon_name) {
+        icon_name = "application-x-executable"; // fallback seguro
+    }
+    return icon_name;
+}
+
+/* Obtener el icono de la app */
+static GdkPixbuf *get_app_icon(AppEntry *e, int size)
+{
+    TRACE_SPAN("get_app_icon");
+    return icon_cache_lookup(app_icon_name(e), size);
+}
+
+/* ==== DECODIFICACIÓN ASÍNCRONA DE ICONOS ==== */
+/* El hilo principal sólo resuelve nombre -> archivo (una búsqueda en el índice
+ * del tema) y consulta las cachés; la decodificación del PNG/SVG se hace en
+ * hilos de trabajo. Los botones se muestran con el icono genérico y el pixbuf
+ * real se coloca en el GtkImage al volver al bucle principal. Las peticiones
+ * se ordenan por posición en la vista y las de vistas anteriores se descartan
+ * al cambiar la generación (cambio de categoría o de búsqueda). */
+#define ICON_LOADER_THREADS 2
+
+typedef struct {
+    gchar *key;             // "tamaño:nombre", igual que en icon_cache.by_name
+    gchar *name, *file;
+    int size, rank;
+    gint generation;
+    gint64 mtime;           // para guardar el resultado en el atlas
+    GSList *images;         // GtkImage* (con referencia) que esperan este icono
+    GdkPixbuf *pixbuf;      // resultado, NULL si falló o se canceló
+    gboolean decoded;       // FALSE si se saltó por estar cancelado
+} IconJob;
+
+typedef struct {
+    GThreadPool *pool;
+    GHashTable *inflight;   // clave -> IconJob* pendiente
+    gint generation;
+} IconLoader;
+
+static IconLoader icon_loader;
+
+static void icon_job_free(IconJob *job)
+{
+    g_slist_free_full(job->images, g_object_unref);
+    if (job->pixbuf) g_object_unref(job->pixbuf);
+    g_free(job->key);
+    g_free(job->name);
+    g_free(job->file);
+    g_free(job);
+}
+
+static void icon_image_set(GtkWidget *img, GdkPixbuf *pb, int size)
+{
+    gtk_image_set_from_pixbuf(GTK_IMAGE(img), pb);
+    gtk_image_set_pixel_size(GTK_IMAGE(img), size);
+}
+
+/* De vuelta en el hilo principal: guardar en caché y reemplazar el placeholder */
+static gboolean icon_job_done(gpointer data)
+{
+    IconJob *job = data;
+
+    if (icon_loader.inflight && g_hash_table_lookup(icon_loader.inflight, job->key) == job)
+        g_hash_table_remove(icon_loader.inflight, job->key);
+
+    if (job->pixbuf && icon_cache.by_name) {
+        g_hash_table_replace(icon_cache.by_name, g_strdup(job->key), g_object_ref(job->pixbuf));
+        g_hash_table_replace(icon_cache.by_file, g_strdup_printf("%d:%s", job->size, job->file),
+                             g_object_ref(job->pixbuf));
+        atlas_store(job->name, job->size, job->mtime, job->pixbuf);
+    } else if (job->decoded && icon_cache.by_name) {
+        g_hash_table_replace(icon_cache.by_name, g_strdup(job->key), NULL);  // fallo cacheado
+    }
+
+    for (GSList *l = job->images; l && job->pixbuf; l = l->next) {
+        // El GtkImage pudo haberse reutilizado para otra app mientras tanto
+        if (g_strcmp0(g_object_get_data(G_OBJECT(l->data), "icon-key"), job->key) == 0)
+            icon_image_set(GTK_WIDGET(l->data), job->pixbuf, job->size);
+    }
+
+    icon_job_free(job);
+    return G_SOURCE_REMOVE;
+}
+
+static void icon_decode_worker(gpointer data, gpointer user_data)
+{
+    (void)user_data;
+    IconJob *job = data;
+
+    if (job->generation == g_atomic_int_get(&icon_loader.generation)) {
+        job->pixbuf = gdk_pixbuf_new_from_file_at_scale(job->file, job->size, job->size, TRUE, NULL);
+        job->decoded = TRUE;
+    }
+
+    g_idle_add(icon_job_done, job);
+}
+
+static gint icon_job_compare(gconstpointer a, gconstpointer b, gpointer user_data)
+{
+    (void)user_data;
+    const IconJob *ja = a, *jb = b;
+
+    // Primero la vista actual, y dentro de ella los primeros puestos
+    if (ja->generation != jb->generation)
+        return ja->generation > jb->generation ? -1 : 1;
+    return ja->rank - jb->rank;
+}
+
+static void icon_loader_start(void)
+{
+    icon_loader.inflight = g_hash_table_new(g_str_hash, g_str_equal);
+    icon_loader.pool = g_thread_pool_new(icon_decode_worker, NULL, ICON_LOADER_THREADS, FALSE, NULL);
+    if (icon_loader.pool)
+        g_thread_pool_set_sort_function(icon_loader.pool, icon_job_compare, NULL);
+}
+
+/* Descarta las peticiones pendientes (las ya encoladas se saltan en el hilo) */
+static void icon_loader_cancel(void)
+{
+    g_atomic_int_inc(&icon_loader.generation);
+    if (icon_loader.inflight)
+        g_hash_table_remove_all(icon_loader.inflight);
+}
+
+static void icon_loader_stop(void)
+{
+    icon_loader_cancel();
+    if (icon_loader.pool) {
+        // Los trabajos restantes sólo encolan su liberación en el bucle principal
+        g_thread_pool_free(icon_loader.pool, FALSE, TRUE);
+        icon_loader.pool = NULL;
+    }
+    if (icon_loader.inflight) {
+        g_hash_table_destroy(icon_loader.inflight);
+        icon_loader.inflight = NULL;
+    }
+}
+
+/* Archivo del icono (hilo principal). NULL si es integrado o no existe */
+static gchar *icon_resolve_file(const char *icon_name, int size)
+{
+    if (g_path_is_absolute(icon_name))
+        return g_file_test(icon_name, G_FILE_TEST_IS_REGULAR) ? g_strdup(icon_name) : NULL;
+
+    gchar *icon_no_ext = g_strdup(icon_name);
+    gchar *dot = strrchr(icon_no_ext, '.');
+    if (dot && (g_strcmp0(dot, ".png") == 0 ||
+        g_strcmp0(dot, ".svg") == 0 ||
+        g_strcmp0(dot, ".xpm") == 0)) {
+        *dot = '\0';
+    }
+
+    const char *candidates[] = { icon_no_ext, "application-x-executable", NULL };
+    gchar *file = NULL;
+    for (int i = 0; candidates[i] && !file; i++) {
+        GtkIconInfo *info = gtk_icon_theme_lookup_icon(gtk_icon_theme_get_default(), candidates[i], size,
+                                                       GTK_ICON_LOOKUP_USE_BUILTIN |
+                                                       GTK_ICON_LOOKUP_FORCE_SIZE);
+        if (!info) continue;
+        file = g_strdup(gtk_icon_info_get_filename(info));
+        gtk_icon_info_free(info);
+        if (!file) break;  // integrado: lo resuelve el camino síncrono
+    }
+
+    g_free(icon_no_ext);
+    return file;
+}
+
+/* Pone el icono en img: al instante si está en caché, si no en segundo plano.
+ * rank es la posición en la vista (menor = antes) */
+static void icon_loader_request(GtkWidget *img, const char *icon_name, int size, int rank)
+{
+    gchar *key = g_strdup_printf("%d:%s", size, icon_name);
+    gpointer cached = NULL;
+    GdkPixbuf *pb = NULL;
+
+    g_object_set_data_full(G_OBJECT(img), "icon-key", g_strdup(key), g_free);
+
+    if (!icon_loader.pool || !icon_cache.by_name) {
+        pb = icon_cache_lookup(icon_name, size);
+        goto set_now;
+    }
+
+    if (g_hash_table_lookup_extended(icon_cache.by_name, key, NULL, &cached)) {
+        icon_cache.hits++;
+        pb = cached ? g_object_ref(cached) : NULL;
+        goto set_now;
+    }
+
+    // Ya hay una decodificación en curso para el mismo icono
+    IconJob *job = g_hash_table_lookup(icon_loader.inflight, key);
+    if (job) {
+        job->images = g_slist_prepend(job->images, g_object_ref(img));
+        g_free(key);
+        return;
+    }
+
+    icon_cache.misses++;
+    gchar *file = icon_resolve_file(icon_name, size);
+    gint64 mtime = -1;
+
+    if (!file) {
+        pb = load_icon_uncached(icon_name, size);
+    } else {
+        gchar *file_key = g_strdup_printf("%d:%s", size, file);
+        pb = g_hash_table_lookup(icon_cache.by_file, file_key);
+        if (pb)
+            g_object_ref(pb);
+        else if ((pb = atlas_lookup(icon_name, size, file, &mtime)) != NULL)
+            g_hash_table_insert(icon_cache.by_file, g_strdup(file_key), g_object_ref(pb));
+        g_free(file_key);
+    }
+
+    if (pb || !file) {
+        g_hash_table_insert(icon_cache.by_name, g_strdup(key), pb ? g_object_ref(pb) : NULL);
+        g_free(file);
+        goto set_now;
+    }
+
+    job = g_new0(IconJob, 1);
+    job->key = key;
+    job->name = g_strdup(icon_name);
+    job->file = file;
+    job->size = size;
+    job->rank = rank;
+    job->mtime = mtime;
+    job->generation = g_atomic_int_get(&icon_loader.generation);
+    job->images = g_slist_prepend(NULL, g_object_ref(img));
+
+    g_hash_table_insert(icon_loader.inflight, job->key, job);
+    g_thread_pool_push(icon_loader.pool, job, NULL);
+    return;
+
+set_now:
+    if (pb) {
+        icon_image_set(img, pb, size);
+        g_object_unref(pb);
+    }
+    g_free(key);
+}
+
+/* ===== 5.2 FUNCIONES DE DATOS Y PERSISTENCIA ===== */
+/* Los conjuntos de ids y su formato en disco están en modern_menu_model.c */
+
+/* Entrada del catálogo con ese id, o NULL */
+static AppEntry *lookup_app(ModernMenu *m, const char *app_id)
+{
+    return catalog_lookup(m->catalog, app_id);
+}
+
+/* ==== ESCRITURA DIFERIDA ==== */
+/* Favoritos y ocultas no se escriben en cada cambio: el contenido nuevo se
+ * arma en el momento (son unos pocos ids) y queda pendiente por ruta, así
+ * una ráfaga de cambios termina en una sola escritura. PERSIST_DELAY_MS
+ * después del último cambio un hilo propio reemplaza los archivos con
+ * temporal + rename; un corte a mitad de camino deja el archivo anterior.
+ * Lo pendiente se escribe igual al destruir el plugin o al salir de gtk_main
+ * (fin de sesión). */
+#define PERSIST_DELAY_MS 500
+
+typedef struct {
+    gchar *path;
+    gchar *data;
+    gsize length;
+} PersistJob;
+
+static struct {
+    GHashTable *pending;            // ruta -> PersistJob*, el último contenido gana
+    GThreadPool *writer;            // un solo hilo: las escrituras salen en orden
+    guint flush_id;
+    guint quit_id;
+    gint users;
+} persist;
+
+static void persist_job_free(gpointer data)
+{
+    PersistJob *job = data;
+    g_free(job->path);
+    g_free(job->data);
+    g_free(job);
+}
+
+static void persist_write_worker(gpointer data, gpointer user_data)
+{
+    (void)user_data;
+    TRACE_SPAN("persist_write");
+    PersistJob *job = data;
+    GError *error = NULL;
+
+    if (!id_set_write(job->path, job->data, job->length, &error)) {
+        g_warning("modernmenu: could not save %s: %s", job->path, error->message);
+        g_error_free(error);
+    }
+    persist_job_free(job);
+}
+
+/* Pasa lo pendiente al hilo escritor (o lo escribe acá si no hay hilo) */
+static void persist_flush(void)
+{
+    if (persist.flush_id) {
+        g_source_remove(persist.flush_id);
+        persist.flush_id = 0;
+    }
+    if (!persist.pending) return;
+
+    GHashTableIter it;
+    gpointer job;
+    g_hash_table_iter_init(&it, persist.pending);
+    while (g_hash_table_iter_next(&it, NULL, &job)) {
+        g_hash_table_iter_steal(&it);
+        if (!persist.writer || !g_thread_pool_push(persist.writer, job, NULL))
+            persist_write_worker(job, NULL);
+    }
+}
+
+static gboolean persist_flush_timeout(gpointer user_data)
+{
+    (void)user_data;
+    persist.flush_id = 0;
+    persist_flush();
+    return G_SOURCE_REMOVE;
+}
+
+/* Al salir de gtk_main el proceso puede terminar sin destruir el plugin:
+ * se vacía la cola del hilo y lo que quede se escribe acá mismo */
+static gboolean persist_on_quit(gpointer user_data)
+{
+    (void)user_data;
+    persist.quit_id = 0;
+    if (persist.writer) {
+        g_thread_pool_free(persist.writer, FALSE, TRUE);
+        persist.writer = NULL;
+    }
+    persist_flush();
+    return FALSE;  // gtk_quit_add: no volver a llamar
+}
+
+/* Deja el conjunto listo para escribirse en un rato, reemplazando lo anterior */
+static void persist_id_set(const char *path, GHashTable *set, const char *header)
+{
+    if (!path || !persist.pending) return;
+
+    PersistJob *job = g_new0(PersistJob, 1);
+    job->path = g_strdup(path);
+    job->data = id_set_serialize(set, header, &job->length);
+    g_hash_table_replace(persist.pending, job->path, job);
+
+    if (persist.flush_id)
+        g_source_remove(persist.flush_id);
+    persist.flush_id = g_timeout_add(PERSIST_DELAY_MS, persist_flush_timeout, NULL);
+}
+
+static void persist_ref(void)
+{
+    if (persist.users++ > 0) return;
+
+    persist.pending = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, persist_job_free);
+    persist.writer = g_thread_pool_new(persist_write_worker, NULL, 1, FALSE, NULL);
+    persist.quit_id = gtk_quit_add(0, persist_on_quit, NULL);
+}
+
+/* Con el último usuario se espera a que el hilo termine de escribir */
+static void persist_unref(void)
+{
+    if (persist.users == 0 || --persist.users > 0) return;
+
+    persist_flush();
+    if (persist.quit_id)
+        gtk_quit_remove(persist.quit_id);
+    if (persist.writer)
+        g_thread_pool_free(persist.writer, FALSE, TRUE);
+    g_hash_table_destroy(persist.pending);
+    memset(&persist, 0, sizeof(persist));
+}
+/* ==== FIN ESCRITURA DIFERIDA ==== */
+
+/* ==== FRECUENCIA DE USO ==== */
+/* Cada lanzamiento suma al puntaje de la app en ~/.local/share/modernmenu/
+ * frecency.bin (tabla mapeada, ver modern_menu_model.c). La búsqueda lo usa
+ * como bono y los favoritos se ordenan por él. Compartida por todas las
+ * instancias del plugin. */
+static struct {
+    FrecencyStore *store;
+    gint users;
+} frecency;
+
+static gint64 frecency_now(void)
+{
+    return g_get_real_time() / G_USEC_PER_SEC;
+}
+
+static void frecency_ref(void)
+{
+    if (frecency.users++ > 0) return;
+
+    gchar *path = g_build_filename(g_get_user_data_dir(), "modernmenu", "frecency.bin", NULL);
+    GError *error = NULL;
+    frecency.store = frecency_open(path, &error);
+    if (!frecency.store) {
+        g_warning("modernmenu: launch history disabled: %s", error->message);
+        g_error_free(error);
+    }
+    g_free(path);
+}
+
+static void frecency_unref(void)
+{
+    if (frecency.users == 0 || --frecency.users > 0) return;
+
+    frecency_close(frecency.store);
+    frecency.store = NULL;
+}
+
+typedef struct {
+    FrecencyStore *store;
+    gint64 now;
+} FrecencyBoost;
+
+/* SearchBoostFunc sobre las claves del índice (los ids de las apps) */
+static gint frecency_boost_entry(const char *key, gpointer user_data)
+{
+    FrecencyBoost *fb = user_data;
+    return frecency_boost(fb->store, key, fb->now);
+}
+
+static GArray *search_rank_with_frecency(SearchIndex *idx, const char *query)
+{
+    FrecencyBoost fb = { frecency.store, frecency_now() };
+    if (!fb.store)
+        return search_index_rank(idx, query, SEARCH_MAX_RESULTS);
+    return search_index_rank_boosted(idx, query, SEARCH_MAX_RESULTS, frecency_boost_entry, &fb);
+}
+
+typedef struct {
+    AppEntry *entry;
+    gdouble score;
+} FrecencyRanked;
+
+static gint frecency_ranked_compare(gconstpointer a, gconstpointer b)
+{
+    const FrecencyRanked *x = a, *y = b;
+    return (x->score < y->score) - (x->score > y->score);
+}
+
+/* Ordena items (AppEntry*) de más a menos usado; a igual uso queda el orden previo */
+static void frecency_sort(GPtrArray *items)
+{
+    if (!frecency.store || items->len < 2) return;
+
+    gint64 now = frecency_now();
+    GArray *ranked = g_array_sized_new(FALSE, FALSE, sizeof(FrecencyRanked), items->len);
+    for (guint i = 0; i < items->len; i++) {
+        AppEntry *e = g_ptr_array_index(items, i);
+        FrecencyRanked r = { e, frecency_score(frecency.store, e->id, now) };
+        g_array_append_val(ranked, r);
+    }
+
+    g_array_sort(ranked, frecency_ranked_compare);  // estable (g_qsort_with_data)
+    for (guint i = 0; i < items->len; i++)
+        g_ptr_array_index(items, i) = g_array_index(ranked, FrecencyRanked, i).entry;
+    g_array_free(ranked, TRUE);
+}
+/* ==== FIN FRECUENCIA DE USO ==== */
+
+/* ==== FAVORITOS ==== */
+static void load_favorites(ModernMenu *m)
+{
+    g_return_if_fail(m != NULL);
+
+    gchar *config_dir = g_build_filename(g_get_user_config_dir(), "modernmenu", NULL);
+    g_mkdir_with_parents(config_dir, 0700);
+    m->favorites_path = g_build_filename(config_dir, "favorites.list", NULL);
+    g_free(config_dir);
+
+    if (!m->favorites)
+        m->favorites = id_set_new();
+    g_hash_table_remove_all(m->favorites);
+    id_set_load(m->favorites, m->favorites_path);
+}
+
+static void save_favorites(ModernMenu *m)
+{
+    if (!m || !m->favorites_path) return;
+
+    persist_id_set(m->favorites_path, m->favorites, NULL);
+}
+
+static gboolean is_favorite(ModernMenu *m, const char *app_id)
+{
+    return app_id && m->favorites && g_hash_table_contains(m->favorites, app_id);
+}
+
+static void toggle_favorite(GtkWidget *menuitem, gpointer user_data)
+{
+    GtkWidget *btn = GTK_WIDGET(user_data);
+    ModernMenu *m = g_object_get_data(G_OBJECT(btn), "modern-menu");
+    AppEntry *entry = g_object_get_data(G_OBJECT(btn), "app-entry");
+
+    if (!m || !entry) return;
+
+    const char *id = entry->id;
+    if (!id) return;
+
+    if (!g_hash_table_remove(m->favorites, id))
+        g_hash_table_add(m->favorites, g_strdup(id));
+
+    save_favorites(m);
+
+    // Actualizar label del menu contextual
+    GtkWidget *menu = gtk_widget_get_parent(menuitem);
+    if (menu) {
+        gtk_widget_destroy(menuitem);
+        GtkWidget *new_item;
+        if (is_favorite(m, id))
+            new_item = gtk_menu_item_new_with_label(_("Remove from Favorites"));
+        else
+            new_item = gtk_menu_item_new_with_label(_("Add to Favorites"));
+        gtk_menu_shell_append(GTK_MENU_SHELL(menu), new_item);
+        gtk_widget_show(new_item);
+        g_signal_connect(new_item, "activate", G_CALLBACK(toggle_favorite), btn);
+    }
+
+    // Favoritos a la vista: rehacerlos ya (o al abrir). Va al final porque
+    // puede sacar btn de la grilla
+    if (!m->current_dir)
+        view_invalidate(m);
+}
+/* ==== FIN FAVORITOS ==== */
+
+/* ===== OCULTAS ===== */
+
+static gchar *hidden_apps_path(void)
+{
+    return g_build_filename(g_get_home_dir(), ".config", "modernmenu", "hidden.list", NULL);
+}
+
+/* Cargar lista de apps ocultas desde archivo */
+static void load_hidden_apps(ModernMenu *m)
+{
+    if (!m->hidden_apps)
+        m->hidden_apps = id_set_new();
+    g_hash_table_remove_all(m->hidden_apps);
+
+    gchar *hidden_file = hidden_apps_path();
+    id_set_load(m->hidden_apps, hidden_file);
+    g_free(hidden_file);
+}
+
+/* Guardar lista de apps ocultas */
+static void save_hidden_apps(ModernMenu *m)
+{
+    gchar *hidden_file = hidden_apps_path();
+    persist_id_set(hidden_file, m->hidden_apps, _("Hidden applications for Modern Menu"));
+    g_free(hidden_file);
+}
+
+/* Verificar si una app está oculta */
+static gboolean is_hidden(ModernMenu *m, const char *app_id)
+{
+    return app_id && m->hidden_apps && g_hash_table_contains(m->hidden_apps, app_id);
+}
+
+static void toggle_hidden(GtkMenuItem *item, gpointer user_data)
+{
+    GtkWidget *app_button = GTK_WIDGET(user_data);
+    AppEntry *entry = g_object_get_data(G_OBJECT(app_button), "app-entry");
+    ModernMenu *m = g_object_get_data(G_OBJECT(app_button), "modern-menu");
+
+    if (!entry || !m) return;
+
+    const char *app_id = entry->id;
+    if (!app_id) return;
+
+    // Mostrar si estaba oculta, ocultar si no
+    if (!g_hash_table_remove(m->hidden_apps, app_id))
+        g_hash_table_add(m->hidden_apps, g_strdup(app_id));
+
+    save_hidden_apps(m);
+    category_pages_clear(m);
+
+    // Refrescar la vista actual
+    if (m->current_dir) {
+        populate_apps_for_dir(m, m->current_dir);
+    } else {
+        show_favorites_category(NULL, m);
+    }
+}
+/* ===== FIN OCULTAS ===== */
+
+/* ==== CATÁLOGO ==== */
+/* Las entradas, el catálogo y el índice viven en modern_menu_model.c; acá
+ * sólo se arman desde menu-cache y se instalan en la UI.
+ *
+ * menu-cached avisa muchas veces seguidas durante una instalación; los avisos
+ * se agrupan y se procesa una sola pasada RELOAD_DEBOUNCE_MS después del
+ * último. Esa pasada compara con el catálogo anterior: las apps sin cambios
+ * conservan su AppEntry (y con él su botón y su entrada del índice), y sólo
+ * las agregadas, cambiadas o eliminadas tocan el índice de búsqueda y el pool.
+ * Las categorías se referencian por id, nunca como punteros a un MenuCacheDir
+ * de un árbol viejo. */
+#define RELOAD_DEBOUNCE_MS 300
+
+/* Item vivo de menu-cache detrás de la entrada, o NULL (instantánea) */
+static MenuCacheItem *app_entry_item(AppEntry *e)
+{
+    return e->live ? e->backing : NULL;
+}
+
+static AppEntry *app_entry_new_from_item(MenuCacheItem *item)
+{
+    gchar *file = menu_cache_item_get_file_path(item);
+    AppEntry *e = app_entry_new_backed(menu_cache_item_get_id(item), menu_cache_item_get_name(item),
+                                       menu_cache_item_get_icon(item),
+                                       menu_cache_app_get_exec(MENU_CACHE_APP(item)), file,
+                                       menu_cache_item_ref(item),
+                                       (GDestroyNotify)menu_cache_item_unref, TRUE);
+    g_free(file);
+    return e;
+}
+
+/* Actualiza cat_store con las categorías del catálogo, agregando, moviendo o
+ * quitando sólo las filas que cambiaron */
+static void load_categories(ModernMenu *m)
+{
+    TRACE_SPAN("load_categories");
+    if (!m || !m->cat_store || !m->catalog) return;
+
+    GtkTreeModel *model = GTK_TREE_MODEL(m->cat_store);
+    GtkTreeIter iter;
+    gboolean was_empty = !gtk_tree_model_get_iter_first(model, &iter);
+    gboolean switching = m->switching_category;
+
+    // Que quitar o mover filas no dispare on_category_selected
+    m->switching_category = TRUE;
+
+    for (gboolean valid = !was_empty; valid; ) {
+        gchar *id = NULL;
+        gtk_tree_model_get(model, &iter, COL_DIR_ID, &id, -1);
+        if (!id || !catalog_lookup_category(m->catalog, id))
+            valid = gtk_list_store_remove(m->cat_store, &iter);
+        else
+            valid = gtk_tree_model_iter_next(model, &iter);
+        g_free(id);
+    }
+
+    for (guint i = 0; i < m->catalog->categories->len; i++) {
+        CategoryEntry *cat = g_ptr_array_index(m->catalog->categories, i);
+        GtkTreeIter at, row;
+        gboolean found = FALSE;
+        guint j = i;
+
+        // Las filas antes de i ya quedaron en orden: buscar desde i
+        gboolean have_at = gtk_tree_model_iter_nth_child(model, &at, NULL, i);
+        row = at;
+        for (gboolean valid = have_at; valid; valid = gtk_tree_model_iter_next(model, &row), j++) {
+            gchar *row_id = NULL;
+            gtk_tree_model_get(model, &row, COL_DIR_ID, &row_id, -1);
+            found = g_strcmp0(row_id, cat->id) == 0;
+            g_free(row_id);
+            if (found) break;
+        }
+
+        if (!found) {
+            gtk_list_store_insert(m->cat_store, &row, i);
+            gtk_list_store_set(m->cat_store, &row, COL_NAME, cat->name, COL_DIR_ID, cat->id, -1);
+            continue;
+        }
+        if (j != i)
+            gtk_list_store_move_before(m->cat_store, &row, &at);
+
+        gchar *old_name = NULL;
+        gtk_tree_model_get(model, &row, COL_NAME, &old_name, -1);
+        if (g_strcmp0(old_name, cat->name) != 0)
+            gtk_list_store_set(m->cat_store, &row, COL_NAME, cat->name, -1);
+        g_free(old_name);
+    }
+
+    m->switching_category = switching;
+
+    if (was_empty && gtk_tree_model_get_iter_first(model, &iter)) {
+        GtkTreeSelection *sel = gtk_tree_view_get_selection(GTK_TREE_VIEW(m->categories));
+        gtk_tree_selection_select_iter(sel, &iter);
+    }
+}
+
+/* Reemplaza el catálogo por uno nuevo. Agrega a touched los ids que ya no
+ * están. */
+static void catalog_install(ModernMenu *m, Catalog *catalog, GHashTable *touched)
+{
+    catalog_diff_removed(m->catalog, catalog, touched);
+    catalog_free(m->catalog);
+    m->catalog = catalog;
+
+    // La categoría abierta pasa a la versión nueva (o desaparece)
+    m->current_dir = catalog_lookup_category(catalog, m->current_dir_id);
+
+    m->search_index = catalog_search_index_update(m->search_index, catalog, touched);
+    load_categories(m);
+}
+
+/* Entrada para un item vivo: la anterior si no cambió, o una nueva */
+static AppEntry *catalog_entry_for_item(ModernMenu *m, MenuCacheItem *item, GHashTable *touched)
+{
+    const char *id = menu_cache_item_get_id(item);
+    AppEntry *old = lookup_app(m, id);
+    gchar *file = menu_cache_item_get_file_path(item);
+    gboolean same = old && app_entry_matches(old, menu_cache_item_get_name(item),
+                                             menu_cache_item_get_icon(item),
+                                             menu_cache_app_get_exec(MENU_CACHE_APP(item)), file);
+    g_free(file);
+
+    if (same) {
+        // Mismo contenido: sólo cambia quién respalda las cadenas
+        if (app_entry_item(old) != item)
+            app_entry_set_backing(old, id, menu_cache_item_get_name(item), menu_cache_item_get_icon(item),
+                                  menu_cache_app_get_exec(MENU_CACHE_APP(item)), menu_cache_item_ref(item),
+                                  (GDestroyNotify)menu_cache_item_unref, TRUE);
+        return app_entry_ref(old);
+    }
+    g_hash_table_add(touched, g_strdup(id));
+    return app_entry_new_from_item(item);
+}
+
+/* Recorre el árbol de menu-cache y reemplaza el catálogo. Si touched no es
+ * NULL, recibe los ids (copias) de las apps agregadas, cambiadas o quitadas. */
+static void build_all_apps_list(ModernMenu *m, GHashTable *touched)
+{
+    TRACE_SPAN("build_all_apps_list");
+    if (!m || !m->menu_cache) return;
+
+    #if MENU_CACHE_CHECK_VERSION(0,4,0)
+    MenuCacheDir *root = menu_cache_dup_root_dir(m->menu_cache);
+    #else
+    MenuCacheDir *root = menu_cache_get_root_dir(m->menu_cache);
+    #endif
+    if (!root) return;
+
+    Catalog *catalog = catalog_new();
+    GHashTable *diff = touched ? touched : g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+
+    // Recorrido en anchura: las categorías quedan en el orden del menú
+    GQueue queue = G_QUEUE_INIT;
+    g_queue_push_tail(&queue, menu_cache_item_ref(MENU_CACHE_ITEM(root)));
+    g_queue_push_tail(&queue, NULL);
+
+    while (!g_queue_is_empty(&queue)) {
+        MenuCacheDir *dir = g_queue_pop_head(&queue);
+        CategoryEntry *cat = g_queue_pop_head(&queue);  // sólo para carpetas de primer nivel
+
+        GSList *children = menu_cache_dir_list_children(dir);
+        for (GSList *l = children; l; l = l->next) {
+            MenuCacheItem *item = MENU_CACHE_ITEM(l->data);
+            const char *id = menu_cache_item_get_id(item);
+            if (!id) continue;
+
+            if (menu_cache_item_get_type(item) == MENU_CACHE_TYPE_APP) {
+                // Las apps que están en varias carpetas quedan una sola vez
+                AppEntry *e = catalog_lookup(catalog, id);
+                if (!e)
+                    e = catalog_add_app(catalog, catalog_entry_for_item(m, item, diff));
+                if (cat && e)
+                    g_ptr_array_add(cat->apps, app_entry_ref(e));
+            } else if (menu_cache_item_get_type(item) == MENU_CACHE_TYPE_DIR) {
+                CategoryEntry *sub = NULL;
+                if (MENU_CACHE_DIR(dir) == root)
+                    sub = catalog_add_category(catalog, id, menu_cache_item_get_name(item));
+                g_queue_push_tail(&queue, menu_cache_item_ref(item));
+                g_queue_push_tail(&queue, sub);
+            }
+        }
+        g_slist_foreach(children, (GFunc)menu_cache_item_unref, NULL);
+        g_slist_free(children);
+        menu_cache_item_unref(MENU_CACHE_ITEM(dir));
+    }
+
+    catalog_install(m, catalog, diff);
+    if (!touched)
+        g_hash_table_destroy(diff);
+    m->catalog_live = TRUE;
+    catalog_snapshot_save_later(m);
+
+    #if MENU_CACHE_CHECK_VERSION(0,4,0)
+    menu_cache_item_unref(MENU_CACHE_ITEM(root));
+    #endif
+}
+
+/* ==== INSTANTÁNEA DEL CATÁLOGO ==== */
+/* Al inicio de sesión menu-cached suele tardar unos segundos. Mientras tanto
+ * el menú se arma con la última copia del catálogo, guardada en
+ * ~/.cache/modernmenu/catalog.bin y mapeada en memoria (el formato está en
+ * modern_menu_model.c). Cuando llega el árbol vivo, la recarga incremental
+ * reconcilia en silencio: las entradas iguales sólo cambian de respaldo. */
+#define CATALOG_SAVE_DELAY 2  // segundos tras la última recarga viva
+
+static gchar *catalog_snapshot_path(void)
+{
+    return g_build_filename(g_get_user_cache_dir(), "modernmenu", "catalog.bin", NULL);
+}
+
+static const char *catalog_locale(void)
+{
+    const char *locale = setlocale(LC_MESSAGES, NULL);
+    return locale ? locale : "C";
+}
+
+/* Carga la instantánea como catálogo provisorio. FALSE si no hay o no vale. */
+static gboolean catalog_snapshot_load(ModernMenu *m)
+{
+    TRACE_SPAN("catalog_snapshot_load");
+    gchar *path = catalog_snapshot_path();
+    Catalog *catalog = catalog_snapshot_read(path, catalog_locale());
+    g_free(path);
+    if (!catalog) return FALSE;
+
+    GHashTable *touched = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    catalog_install(m, catalog, touched);
+    g_hash_table_destroy(touched);
+
+    g_debug("modernmenu: catalog snapshot loaded (%u apps, %u categories)",
+            m->catalog->apps->len, m->catalog->categories->len);
+    return TRUE;
+}
+
+static void catalog_snapshot_write_now(ModernMenu *m)
+{
+    if (!m->catalog) return;
+
+    gchar *path = catalog_snapshot_path();
+    GError *error = NULL;
+    if (!catalog_snapshot_write(m->catalog, path, catalog_locale(), &error)) {
+        g_warning("modernmenu: could not write catalog snapshot: %s", error->message);
+        g_error_free(error);
+    }
+    g_free(path);
+}
+
+static gboolean catalog_snapshot_save(gpointer user_data)
+{
+    ModernMenu *m = user_data;
+    m->catalog_save_id = 0;
+    catalog_snapshot_write_now(m);
+    return G_SOURCE_REMOVE;
+}
+
+static void catalog_snapshot_save_later(ModernMenu *m)
+{
+    if (m->catalog_save_id)
+        g_source_remove(m->catalog_save_id);
+    m->catalog_save_id = g_timeout_add_seconds(CATALOG_SAVE_DELAY, catalog_snapshot_save, m);
+}
+
+/* Guarda ya lo pendiente (al destruir el plugin) */
+static void catalog_snapshot_flush(ModernMenu *m)
+{
+    if (!m->catalog_save_id) return;
+    g_source_remove(m->catalog_save_id);
+    m->catalog_save_id = 0;
+    catalog_snapshot_write_now(m);
+}
+
+static gchar *get_exec_from_desktop(const char *desktop_file)
+{
+    if (!desktop_file) return NULL;
+
+    GKeyFile *keyfile = g_key_file_new();
+    GError *error = NULL;
+
+    if (!g_key_file_load_from_file(keyfile, desktop_file, G_KEY_FILE_NONE, &error)) {
+        show_error_dialog(_("Could not load .desktop file."));
+        if (error) g_error_free(error);
+        g_key_file_free(keyfile);
+        return NULL;
+    }
+
+    gchar *exec = g_key_file_get_string(keyfile, "Desktop Entry", "Exec", NULL);
+    g_key_file_free(keyfile);
+
+    if (!exec || !*exec) {
+        show_error_dialog(_("The .desktop file does not have a valid 'Exec' field."));
+        g_free(exec);
+        return NULL;
+    }
+
+    /* Limpiar parámetros tipo %f, %u, %U, etc. */
+    gchar *cleaned = g_strdup(exec);
+    gchar *percent = strchr(cleaned, '%');
+    if (percent) *percent = '\0';
+
+    /* Eliminar comillas */
+    gchar *trimmed = g_strstrip(cleaned);
+    if (trimmed[0] == '"' || trimmed[0] == '\'') {
+        trimmed++;
+        size_t len = strlen(trimmed);
+        if (len > 0 && (trimmed[len - 1] == '"' || trimmed[len - 1] == '\'')) {
+            trimmed[len - 1] = '\0';
+        }
+    }
+
+    gchar *result = g_strdup(trimmed);
+    g_free(cleaned);
+    g_free(exec);
 
     return result;
 }
 
-/* ===== 5.3 FUNCIONES DE UI Y WIDGETS ===== */
-static GtkWidget* create_app_button(MenuCacheItem *item, ModernMenu *m)
+/* ===== 5.3 FUNCIONES DE UI Y WIDGETS ===== */
+/* FmFileInfo de la app (como lo arma lxpanel), o NULL si todavía no hay item
+ * vivo de menu-cache (catálogo tomado de la instantánea). Sólo se usa al
+ * arrastrar o en Propiedades, así que se arma la primera vez que se pide y
+ * queda en la entrada; armar una vista no crea objetos de libfm. La
+ * referencia es de la entrada. */
+static FmFileInfo *app_entry_file_info(AppEntry *e)
+{
+    MenuCacheItem *item = app_entry_item(e);
+    if (e->file_info || !item) return e->file_info;
+
+    char *mpath = menu_cache_dir_make_path(MENU_CACHE_DIR(item));
+    FmPath *path = fm_path_new_relative(fm_path_get_apps_menu(), mpath + 13);
+    /* skip "/Applications" */
+    e->file_info = fm_file_info_new_from_menu_cache_item(path, item);
+    e->file_info_free = (GDestroyNotify)fm_file_info_unref;
+    g_free(mpath);
+    fm_path_unref(path);
+    return e->file_info;
+}
+
+/* ==== PRECARGA AL LANZAR ==== */
+/* Cuando el puntero se queda sobre una app (o una búsqueda la deja primera)
+ * se adelanta el trabajo del click: en un hilo se lee el .desktop (el
+ * GDesktopAppInfo queda en caché para el lanzamiento) y se le pide al kernel
+ * que traiga el ejecutable y sus bibliotecas. En discos lentos, al llegar el
+ * click casi todo sale de la caché de páginas. */
+#define PREFETCH_DWELL_MS 150           // cuánto tiene que quedarse el puntero
+#define PREFETCH_REWARM_S 120           // pasado esto se vuelve a pedir al kernel
+#define PREFETCH_CACHE_MAX 48
+
+typedef struct {
+    GDesktopAppInfo *info;              // NULL hasta que termina el hilo
+    gint64 warmed;                      // último pedido (reloj monotónico)
+} PrefetchEntry;
+
+typedef struct {
+    gchar *file;
+    gboolean parse;                     // falta el GDesktopAppInfo
+    guint generation;
+    GDesktopAppInfo *info;
+} PrefetchJob;
+
+static struct {
+    GHashTable *entries;                // ruta del .desktop -> PrefetchEntry*
+    GThreadPool *pool;
+    AppEntry *pending;                  // esperando PREFETCH_DWELL_MS
+    guint dwell_id;
+    guint generation;                   // cambia al descartar la caché
+    gint cancelled;                     // atómico: al cerrar, lo encolado no se hace
+    gint users;
+} prefetch;
+
+static void prefetch_entry_free(gpointer data)
+{
+    PrefetchEntry *pe = data;
+    if (pe->info) g_object_unref(pe->info);
+    g_free(pe);
+}
+
+static void prefetch_job_free(PrefetchJob *job)
+{
+    if (job->info) g_object_unref(job->info);
+    g_free(job->file);
+    g_free(job);
+}
+
+static gboolean prefetch_job_done(gpointer data)
+{
+    PrefetchJob *job = data;
+
+    if (prefetch.users && job->info && job->generation == prefetch.generation) {
+        PrefetchEntry *pe = g_hash_table_lookup(prefetch.entries, job->file);
+        if (pe && !pe->info)
+            pe->info = g_object_ref(job->info);
+    }
+    prefetch_job_free(job);
+    return G_SOURCE_REMOVE;
+}
+
+static void prefetch_worker(gpointer data, gpointer user_data)
+{
+    (void)user_data;
+    PrefetchJob *job = data;
+    if (g_atomic_int_get(&prefetch.cancelled)) {
+        prefetch_job_free(job);
+        return;
+    }
+    GDesktopAppInfo *info = g_desktop_app_info_new_from_filename(job->file);
+
+    const char *exec = info ? g_app_info_get_executable(G_APP_INFO(info)) : NULL;
+    gchar *path = !exec ? NULL : g_path_is_absolute(exec) ? g_strdup(exec) : g_find_program_in_path(exec);
+    if (path) {
+        GPtrArray *files = g_ptr_array_new_with_free_func(g_free);
+        prefetch_collect(path, files);
+        for (guint i = 0; i < files->len && !g_atomic_int_get(&prefetch.cancelled); i++)
+            prefetch_readahead(g_ptr_array_index(files, i));
+        g_ptr_array_free(files, TRUE);
+        g_free(path);
+    }
+
+    if (job->parse) job->info = info;
+    else if (info) g_object_unref(info);
+    g_idle_add(prefetch_job_done, job);
+}
+
+/* Saca la entrada pedida hace más tiempo */
+static void prefetch_evict(void)
+{
+    GHashTableIter it;
+    gpointer key, value, oldest = NULL;
+    gint64 oldest_time = G_MAXINT64;
+
+    g_hash_table_iter_init(&it, prefetch.entries);
+    while (g_hash_table_iter_next(&it, &key, &value)) {
+        PrefetchEntry *pe = value;
+        if (pe->warmed < oldest_time) {
+            oldest_time = pe->warmed;
+            oldest = key;
+        }
+    }
+    if (oldest) g_hash_table_remove(prefetch.entries, oldest);
+}
+
+static void prefetch_request(AppEntry *e)
+{
+    if (!prefetch.pool || !e || !e->file) return;
+
+    gint64 now = g_get_monotonic_time();
+    PrefetchEntry *pe = g_hash_table_lookup(prefetch.entries, e->file);
+    if (pe && now - pe->warmed < PREFETCH_REWARM_S * G_USEC_PER_SEC)
+        return;
+    if (!pe) {
+        if (g_hash_table_size(prefetch.entries) >= PREFETCH_CACHE_MAX)
+            prefetch_evict();
+        pe = g_new0(PrefetchEntry, 1);
+        g_hash_table_insert(prefetch.entries, g_strdup(e->file), pe);
+    }
+    pe->warmed = now;
+
+    PrefetchJob *job = g_new0(PrefetchJob, 1);
+    job->file = g_strdup(e->file);
+    job->parse = pe->info == NULL;
+    job->generation = prefetch.generation;
+    g_thread_pool_push(prefetch.pool, job, NULL);
+}
+
+static gboolean prefetch_dwell_timeout(gpointer data)
+{
+    (void)data;
+    AppEntry *e = prefetch.pending;
+    prefetch.dwell_id = 0;
+    prefetch.pending = NULL;
+
+    prefetch_request(e);
+    app_entry_unref(e);
+    return G_SOURCE_REMOVE;
+}
+
+/* Precarga e si nada la reemplaza durante PREFETCH_DWELL_MS; NULL cancela */
+static void prefetch_schedule(AppEntry *e)
+{
+    if (prefetch.dwell_id) {
+        g_source_remove(prefetch.dwell_id);
+        prefetch.dwell_id = 0;
+    }
+    if (prefetch.pending) {
+        app_entry_unref(prefetch.pending);
+        prefetch.pending = NULL;
+    }
+    if (!e || !prefetch.pool) return;
+
+    prefetch.pending = app_entry_ref(e);
+    prefetch.dwell_id = g_timeout_add(PREFETCH_DWELL_MS, prefetch_dwell_timeout, NULL);
+}
+
+static gboolean on_app_button_enter(GtkWidget *widget, GdkEventCrossing *event, gpointer user_data)
+{
+    (void)widget; (void)event;
+    prefetch_schedule(user_data);
+    return FALSE;
+}
+
+static gboolean on_app_button_leave(GtkWidget *widget, GdkEventCrossing *event, gpointer user_data)
+{
+    (void)widget; (void)event;
+    if (prefetch.pending == user_data)
+        prefetch_schedule(NULL);
+    return FALSE;
+}
+
+/* GDesktopAppInfo para lanzar: el de la precarga si ya llegó; si no se lee ahora */
+static GDesktopAppInfo *prefetch_app_info(const char *file)
+{
+    PrefetchEntry *pe = prefetch.entries ? g_hash_table_lookup(prefetch.entries, file) : NULL;
+    if (pe && pe->info)
+        return g_object_ref(pe->info);
+    return g_desktop_app_info_new_from_filename(file);
+}
+
+/* Los .desktop cambiaron: lo que está en vuelo se descarta al llegar */
+static void prefetch_forget(void)
+{
+    if (!prefetch.entries) return;
+    prefetch_schedule(NULL);
+    g_hash_table_remove_all(prefetch.entries);
+    prefetch.generation++;
+}
+
+static void prefetch_ref(void)
+{
+    if (prefetch.users++ > 0) return;
+
+    prefetch.entries = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, prefetch_entry_free);
+    prefetch.pool = g_thread_pool_new(prefetch_worker, NULL, 1, FALSE, NULL);
+    g_atomic_int_set(&prefetch.cancelled, FALSE);
+}
+
+static void prefetch_unref(void)
+{
+    if (prefetch.users == 0 || --prefetch.users > 0) return;
+
+    prefetch_schedule(NULL);
+    // Lo encolado se suelta sin hacerse; sólo se espera el archivo en curso.
+    // Los resultados que lleguen después se descartan
+    g_atomic_int_set(&prefetch.cancelled, TRUE);
+    g_thread_pool_free(prefetch.pool, FALSE, TRUE);
+    prefetch.pool = NULL;
+    g_hash_table_destroy(prefetch.entries);
+    prefetch.entries = NULL;
+    prefetch.generation++;
+}
+/* ==== FIN PRECARGA AL LANZAR ==== */
+
+/* ==== PRECARGA EN REPOSO ==== */
+/* Opcional ("preload" en la configuración). Mientras la sesión está quieta,
+ * un hilo trae a la caché de páginas los ejecutables y bibliotecas de las
+ * apps más lanzadas (según la frecuencia de uso). Para no desalojar nada más
+ * importante sólo ocupa memoria libre (MemFree, menos una reserva) hasta el
+ * presupuesto configurado, salta lo que ya está en memoria, usa la prioridad
+ * de E/S "idle" y, si el kernel informa presión de memoria o de E/S, corta y
+ * espera cada vez más antes de volver a intentar. Abrir el menú o lanzar algo
+ * cuenta como actividad y corta una pasada en curso. */
+#define PRELOAD_DEFAULT_APPS 5
+#define PRELOAD_DEFAULT_BUDGET_MB 256
+#define PRELOAD_CHECK_S 30              // cada cuánto se mira si conviene
+#define PRELOAD_IDLE_S 90               // sin tocar el menú
+#define PRELOAD_INTERVAL_S 600          // entre pasadas
+#define PRELOAD_INTERVAL_MAX_S 3600     // tope de la espera con presión
+#define PRELOAD_RESERVE_MB 128          // memoria libre que nunca se toca
+#define PRELOAD_PRESSURE_MAX 1.0        // % "some avg10" de memoria o E/S
+#define PRELOAD_MIN_SCORE 0.5           // lanzamientos recientes (con decaimiento)
+
+typedef struct {
+    GPtrArray *files;                   // .desktop, de la app más usada a la menos
+    guint64 budget;
+    guint generation;
+    guint apps;                         // resultado
+    guint64 bytes;
+    gboolean pressure;
+} PreloadJob;
+
+static struct {
+    GThread *thread;
+    gint cancel;
+    guint generation;                   // descarta resultados de hilos ya esperados
+    gint64 last_activity;               // reloj monotónico
+    gint64 next_run;
+    guint interval;                     // s; se duplica con presión
+    gint users;                         // instancias con la precarga prendida
+} preload;
+
+static void preload_job_free(PreloadJob *job)
+{
+    g_ptr_array_free(job->files, TRUE);
+    g_free(job);
+}
+
+static gboolean preload_under_pressure(void)
+{
+    return prefetch_pressure("memory") > PRELOAD_PRESSURE_MAX ||
+           prefetch_pressure("io") > PRELOAD_PRESSURE_MAX ||
+           prefetch_memory_free() < (guint64)PRELOAD_RESERVE_MB << 20;
+}
+
+static gboolean preload_done(gpointer data)
+{
+    PreloadJob *job = data;
+
+    if (job->generation != preload.generation || preload.users == 0) {
+        preload_job_free(job);
+        return G_SOURCE_REMOVE;
+    }
+
+    g_thread_join(preload.thread);
+    preload.thread = NULL;
+
+    preload.interval = job->pressure ? MIN(preload.interval * 2, PRELOAD_INTERVAL_MAX_S)
+                                     : PRELOAD_INTERVAL_S;
+    preload.next_run = g_get_monotonic_time() + (gint64)preload.interval * G_USEC_PER_SEC;
+    g_debug("modernmenu: preloaded %u apps, %" G_GUINT64_FORMAT " KiB%s",
+            job->apps, job->bytes >> 10, job->pressure ? " (stopped: pressure)" : "");
+
+    preload_job_free(job);
+    return G_SOURCE_REMOVE;
+}
+
+static gpointer preload_thread(gpointer data)
 {
-    GtkWidget *btn = gtk_button_new();
-    gtk_button_set_relief(GTK_BUTTON(btn), GTK_RELIEF_NONE);
+    TRACE_SPAN("preload");
+    PreloadJob *job = data;
 
-    // ===== CREAR FmFileInfo EXACTAMENTE como lxpanel (líneas 407-414) =====
-    char *mpath = menu_cache_dir_make_path(MENU_CACHE_DIR(item));
-    FmPath *path = fm_path_new_relative(fm_path_get_apps_menu(), mpath + 13);
-    /* skip "/Applications" */
-    FmFileInfo *fi = fm_file_info_new_from_menu_cache_item(path, item);
-    g_free(mpath);
-    fm_path_unref(path);
+#ifdef SYS_ioprio_set
+    // Clase de E/S "idle" (3) para este hilo: sólo usa el disco si nadie más lo pide
+    syscall(SYS_ioprio_set, 1 /* IOPRIO_WHO_PROCESS */, 0, 3 << 13);
+#endif
+
+    guint64 free_bytes = prefetch_memory_free();
+    guint64 reserve = (guint64)PRELOAD_RESERVE_MB << 20;
+    guint64 left = MIN(job->budget, free_bytes > reserve ? free_bytes - reserve : 0);
+    GHashTable *seen = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    GPtrArray *files = g_ptr_array_new_with_free_func(g_free);
+
+    for (guint i = 0; i < job->files->len && !g_atomic_int_get(&preload.cancel); i++) {
+        if (preload_under_pressure()) {
+            job->pressure = TRUE;
+            break;
+        }
+
+        GDesktopAppInfo *info = g_desktop_app_info_new_from_filename(g_ptr_array_index(job->files, i));
+        const char *exec = info ? g_app_info_get_executable(G_APP_INFO(info)) : NULL;
+        gchar *path = !exec ? NULL : g_path_is_absolute(exec) ? g_strdup(exec) : g_find_program_in_path(exec);
+        if (info) g_object_unref(info);
+        if (!path) continue;
+
+        // Sólo lo que falta en memoria y no trajo ya otra app de la lista
+        g_ptr_array_set_size(files, 0);
+        prefetch_collect(path, files);
+        g_free(path);
+
+        guint64 missing = 0;
+        for (guint k = 0; k < files->len; k++) {
+            const char *file = g_ptr_array_index(files, k);
+            if (!g_hash_table_contains(seen, file))
+                missing += prefetch_missing_bytes(file);
+        }
+        if (missing > left) continue;  // puede entrar una más chica
+
+        for (guint k = 0; k < files->len; k++) {
+            gchar *file = g_ptr_array_index(files, k);
+            if (g_hash_table_contains(seen, file)) continue;
+            prefetch_readahead(file);
+            g_hash_table_add(seen, g_strdup(file));
+        }
+        left -= missing;
+        job->bytes += missing;
+        job->apps++;
+    }
+
+    g_ptr_array_free(files, TRUE);
+    g_hash_table_destroy(seen);
+    g_idle_add(preload_done, job);
+    return NULL;
+}
+
+/* El usuario está usando el menú: correr el reposo y cortar la pasada en curso */
+static void preload_touch(void)
+{
+    preload.last_activity = g_get_monotonic_time();
+    g_atomic_int_set(&preload.cancel, 1);
+}
+
+typedef struct {
+    AppEntry *entry;
+    gdouble score;
+} PreloadCandidate;
+
+static gint preload_candidate_compare(gconstpointer a, gconstpointer b)
+{
+    gdouble sa = ((const PreloadCandidate *)a)->score, sb = ((const PreloadCandidate *)b)->score;
+    return sa < sb ? 1 : sa > sb ? -1 : 0;
+}
+
+/* .desktop de las apps más lanzadas (como mucho m->preload_apps) */
+static GPtrArray *preload_collect_files(ModernMenu *m)
+{
+    GPtrArray *files = g_ptr_array_new_with_free_func(g_free);
+    GArray *ranked = g_array_new(FALSE, FALSE, sizeof(PreloadCandidate));
+    gint64 now = frecency_now();
+
+    for (guint i = 0; i < m->catalog->apps->len; i++) {
+        AppEntry *e = g_ptr_array_index(m->catalog->apps, i);
+        if (!e->file || !e->id || is_hidden(m, e->id)) continue;
 
-    // GUARDAR el FmFileInfo en el widget con el mismo quark que lxpanel
-    static GQuark SYS_MENU_ITEM_ID = 0;
-    if (SYS_MENU_ITEM_ID == 0)
-        SYS_MENU_ITEM_ID = g_quark_from_static_string("SysMenuItem");
+        PreloadCandidate c = { e, frecency_score(frecency.store, e->id, now) };
+        if (c.score >= PRELOAD_MIN_SCORE)
+            g_array_append_val(ranked, c);
+    }
+    g_array_sort(ranked, preload_candidate_compare);
+
+    for (guint i = 0; i < ranked->len && i < (guint)m->preload_apps; i++)
+        g_ptr_array_add(files, g_strdup(g_array_index(ranked, PreloadCandidate, i).entry->file));
+    g_array_free(ranked, TRUE);
+    return files;
+}
+
+static gboolean preload_check(gpointer user_data)
+{
+    ModernMenu *m = user_data;
+    gint64 now = g_get_monotonic_time();
+
+    if (preload.thread || !m->catalog || !frecency.store ||
+        now - preload.last_activity < (gint64)PRELOAD_IDLE_S * G_USEC_PER_SEC ||
+        now < preload.next_run)
+        return G_SOURCE_CONTINUE;
+
+    if (preload_under_pressure()) {
+        preload.interval = MIN(preload.interval * 2, PRELOAD_INTERVAL_MAX_S);
+        preload.next_run = now + (gint64)preload.interval * G_USEC_PER_SEC;
+        return G_SOURCE_CONTINUE;
+    }
+
+    GPtrArray *files = preload_collect_files(m);
+    if (files->len == 0) {
+        g_ptr_array_free(files, TRUE);
+        preload.next_run = now + (gint64)PRELOAD_INTERVAL_S * G_USEC_PER_SEC;
+        return G_SOURCE_CONTINUE;
+    }
+
+    PreloadJob *job = g_new0(PreloadJob, 1);
+    job->files = files;
+    job->budget = (guint64)MAX(m->preload_budget_mb, 0) << 20;
+    job->generation = preload.generation;
+
+    g_atomic_int_set(&preload.cancel, 0);
+    preload.thread = g_thread_new("modernmenu-preload", preload_thread, job);
+    return G_SOURCE_CONTINUE;
+}
+
+static void preload_ref(void)
+{
+    if (preload.users++ > 0) return;
 
-    g_object_set_qdata_full(G_OBJECT(btn), SYS_MENU_ITEM_ID, fi,
-                            (GDestroyNotify)fm_file_info_unref);
-    // ===== FIN =====
+    // Recién iniciada la sesión el disco está ocupado: esperar el primer reposo
+    preload.last_activity = g_get_monotonic_time();
+    preload.next_run = 0;
+    preload.interval = PRELOAD_INTERVAL_S;
+}
+
+/* Con el último usuario se corta la pasada y se espera al hilo */
+static void preload_unref(void)
+{
+    if (preload.users == 0 || --preload.users > 0) return;
+
+    if (preload.thread) {
+        g_atomic_int_set(&preload.cancel, 1);
+        g_thread_join(preload.thread);
+        preload.thread = NULL;
+    }
+    preload.generation++;
+}
+
+/* Prende o apaga la precarga de esta instancia según m->preload */
+static void preload_update(ModernMenu *m)
+{
+    if (m->preload && !m->preload_id) {
+        preload_ref();
+        m->preload_id = g_timeout_add_seconds(PRELOAD_CHECK_S, preload_check, m);
+    } else if (!m->preload && m->preload_id) {
+        g_source_remove(m->preload_id);
+        m->preload_id = 0;
+        preload_unref();
+    }
+}
+/* ==== FIN PRECARGA EN REPOSO ==== */
+
+static GtkWidget* create_app_button(AppEntry *e, ModernMenu *m, int rank)
+{
+    TRACE_SPAN("create_app_button");
+    GtkWidget *btn = gtk_button_new();
+    gtk_button_set_relief(GTK_BUTTON(btn), GTK_RELIEF_NONE);
 
-    // También guardar referencias necesarias
-    g_object_set_data(G_OBJECT(btn), "menu-item", item);
+    // Guardar referencias necesarias (el botón vive en el pool,
+    // así que mantiene su propia referencia a la entrada)
+    g_object_set_data_full(G_OBJECT(btn), "app-entry", app_entry_ref(e),
+                           (GDestroyNotify)app_entry_unref);
     g_object_set_data(G_OBJECT(btn), "modern-menu", m);
 
     // ===== DRAG AND DROP (igual que lxpanel) =====
-    gtk_drag_source_set(btn,
-                        GDK_BUTTON1_MASK,
-                        NULL, 0,
-                        GDK_ACTION_COPY);
-
+    // El único FmDndSrc se apunta a este botón al hacer click (ver
+    // on_app_button_press); acá sólo va el icono del arrastre
     g_signal_connect(btn, "drag-begin", G_CALLBACK(on_app_drag_begin), NULL);
     // ===== FIN DRAG AND DROP =====
 
@@ -518,17 +2541,14 @@ static GtkWidget* create_app_button(MenuCacheItem *item, ModernMenu *m)
     GtkWidget *vbox = gtk_vbox_new(FALSE, 4);
     gtk_container_add(GTK_CONTAINER(btn), vbox);
 
+    // Placeholder genérico; el icono real llega desde la caché o en segundo plano
     GtkWidget *img = gtk_image_new_from_icon_name("application-x-executable", GTK_ICON_SIZE_DIALOG);
-    GdkPixbuf *pb = get_app_icon(item, 48);
-    if (pb) {
-        gtk_image_set_from_pixbuf(GTK_IMAGE(img), pb);
-        gtk_image_set_pixel_size(GTK_IMAGE(img), 48);
-        g_object_unref(pb);
-    }
+    icon_loader_request(img, app_icon_name(e), 48, rank);
     gtk_misc_set_alignment(GTK_MISC(img), 0.5, 0.5);
     gtk_box_pack_start(GTK_BOX(vbox), img, FALSE, FALSE, 0);
+    g_object_set_data(G_OBJECT(btn), "app-image", img);
 
-    const char *name = menu_cache_item_get_name(item);
+    const char *name = e->name;
     GtkWidget *lbl = gtk_label_new(name ? name : "");
     gtk_label_set_max_width_chars(GTK_LABEL(lbl), 16);
     gtk_label_set_ellipsize(GTK_LABEL(lbl), PANGO_ELLIPSIZE_END);
@@ -537,97 +2557,421 @@ static GtkWidget* create_app_button(MenuCacheItem *item, ModernMenu *m)
 
     if (name) gtk_widget_set_tooltip_text(btn, name);
 
-    g_signal_connect(btn, "clicked", G_CALLBACK(launch_app_from_item), item);
+    g_signal_connect(btn, "clicked", G_CALLBACK(launch_app_from_item), e);
     g_signal_connect(btn, "button-press-event", G_CALLBACK(on_app_button_press), m);
+    g_signal_connect(btn, "enter-notify-event", G_CALLBACK(on_app_button_enter), e);
+    g_signal_connect(btn, "leave-notify-event", G_CALLBACK(on_app_button_leave), e);
 
     gtk_widget_set_size_request(btn, 110, 100);
     gtk_widget_show_all(btn);
 
     return btn;
 }
-// Filtro para favoritos
-static gboolean filter_favorites(MenuCacheItem *item, ModernMenu *m) {
-    const char *id = menu_cache_item_get_id(item);
-    return id && is_favorite(m, id);
+
+/* ==== POOL DE BOTONES Y GRILLA VIRTUALIZADA ==== */
+/* La grilla es un único GtkLayout respaldado por un modelo (m->grid_items).
+ * Sólo las filas que intersecan la parte visible del scroll (más una fila de
+ * margen) tienen botón; el resto es espacio vacío del layout. Los botones se
+ * toman de un pool indexado por ID de menu-cache, así que cambiar de vista o
+ * hacer scroll sólo agrega, quita o mueve los botones que cambiaron. El pool
+ * se limita con LRU a BUTTON_POOL_MAX botones fuera de pantalla. */
+#define GRID_CELL_W 110
+#define GRID_CELL_H 100
+#define GRID_SPACING 8
+#define GRID_OVERSCAN_ROWS 1
+#define GRID_WIDTH (APPS_PER_ROW * (GRID_CELL_W + GRID_SPACING) + GRID_SPACING)
+#define BUTTON_POOL_MAX 96
+
+static void app_button_release(gpointer data)
+{
+    gtk_widget_destroy(GTK_WIDGET(data));
+    g_object_unref(data);
 }
-static int add_apps_to_container(GSList *apps_list, ModernMenu *m,
-                                 GtkWidget *container,
-                                 gboolean (*filter_func)(MenuCacheItem*, ModernMenu*))
+
+static GtkWidget *app_button_pool_get(ModernMenu *m, AppEntry *e, int rank)
 {
-    int count = 0;
-    GtkWidget *current_hbox = NULL;
+    const char *id = e->id;
+    GtkWidget *btn = g_hash_table_lookup(m->button_pool, id);
 
-    for (GSList *l = apps_list; l; l = l->next) {
-        MenuCacheItem *item = MENU_CACHE_ITEM(l->data);
+    if (!btn) {
+        btn = create_app_button(e, m, rank);
+        g_object_ref_sink(btn);
+        g_hash_table_insert(m->button_pool, g_strdup(id), btn);
+    } else {
+        // Si la decodificación se canceló al cambiar de vista, volver a pedirla
+        GtkWidget *img = g_object_get_data(G_OBJECT(btn), "app-image");
+        if (img && gtk_image_get_storage_type(GTK_IMAGE(img)) != GTK_IMAGE_PIXBUF)
+            icon_loader_request(img, app_icon_name(e), 48, rank);
+    }
 
-        // Aplicar filtro si existe
-        if (filter_func && !filter_func(item, m)) {
-            continue;
-        }
+    g_object_set_data(G_OBJECT(btn), "pool-stamp", GUINT_TO_POINTER(++m->pool_clock));
+    return btn;
+}
 
-        // Verificar si está oculta
-        const char *id = menu_cache_item_get_id(item);
-        if (!id || is_hidden(m, id)) {
-            continue;
-        }
+static gint pool_stamp_compare(gconstpointer a, gconstpointer b)
+{
+    guint sa = GPOINTER_TO_UINT(g_object_get_data(G_OBJECT(*(GtkWidget **)a), "pool-stamp"));
+    guint sb = GPOINTER_TO_UINT(g_object_get_data(G_OBJECT(*(GtkWidget **)b), "pool-stamp"));
+    return sa < sb ? -1 : sa > sb;
+}
 
-        // Crear nueva fila si es necesario
-        if (count % APPS_PER_ROW == 0 || current_hbox == NULL) {
-            current_hbox = gtk_hbox_new(TRUE, 8);
-            gtk_box_pack_start(GTK_BOX(container), current_hbox, FALSE, FALSE, 4);
-            gtk_widget_show(current_hbox);
-        }
+/* Descarta los botones fuera de pantalla usados hace más tiempo */
+static void app_button_pool_trim(ModernMenu *m)
+{
+    guint size = g_hash_table_size(m->button_pool);
+    if (size <= BUTTON_POOL_MAX + BUTTON_POOL_MAX / 4) return;
+
+    GPtrArray *idle = g_ptr_array_new();
+    GHashTableIter it;
+    gpointer key, value;
+
+    g_hash_table_iter_init(&it, m->button_pool);
+    while (g_hash_table_iter_next(&it, &key, &value)) {
+        if (gtk_widget_get_parent(GTK_WIDGET(value)) == NULL &&
+            !g_object_get_data(G_OBJECT(value), "page-pins"))
+            g_ptr_array_add(idle, value);
+    }
+    g_ptr_array_sort(idle, pool_stamp_compare);
 
-        // Crear botón y añadir
-        GtkWidget *btn = create_app_button(item, m);
-        gtk_box_pack_start(GTK_BOX(current_hbox), btn, FALSE, FALSE, 0);
-        count++;
+    for (guint i = 0; i < idle->len && size > BUTTON_POOL_MAX; i++, size--) {
+        AppEntry *e = g_object_get_data(G_OBJECT(g_ptr_array_index(idle, i)), "app-entry");
+        g_hash_table_remove(m->button_pool, e->id);
     }
+    g_ptr_array_free(idle, TRUE);
+}
 
-    return count;
+/* Quita todos los botones de la grilla y vacía el pool y el modelo */
+static void app_button_pool_clear(ModernMenu *m)
+{
+    if (!m->button_pool) return;
+
+    category_pages_clear(m);  // sueltan los botones fijados
+
+    for (guint i = 0; i < m->grid_buttons->len; i++)
+        gtk_container_remove(GTK_CONTAINER(m->apps_grid), g_ptr_array_index(m->grid_buttons, i));
+    g_ptr_array_set_size(m->grid_buttons, 0);
+    g_ptr_array_set_size(m->grid_items, 0);
+    g_hash_table_remove_all(m->button_pool);
 }
 
+/* Coloca botones sólo en las filas visibles del layout */
+static void apps_grid_layout_visible(ModernMenu *m)
+{
+    GtkAdjustment *vadj = gtk_layout_get_vadjustment(GTK_LAYOUT(m->apps_grid));
+    const int row_h = GRID_CELL_H + GRID_SPACING;
+    guint n = m->grid_items->len;
+    guint n_rows = (n + APPS_PER_ROW - 1) / APPS_PER_ROW;
+
+    int top = vadj ? (int)gtk_adjustment_get_value(vadj) : 0;
+    int page = vadj ? (int)gtk_adjustment_get_page_size(vadj) : 0;
+    if (page <= 0) page = 500;  // aún sin asignar tamaño: asumir la ventana completa
+
+    int first_row = MAX(0, top / row_h - GRID_OVERSCAN_ROWS);
+    int last_row = MIN((int)n_rows, (top + page) / row_h + 1 + GRID_OVERSCAN_ROWS);
+    guint first = first_row * APPS_PER_ROW;
+    guint last = MIN(n, (guint)last_row * APPS_PER_ROW);
+    guint first_visible = MIN(n, (guint)(top / row_h) * APPS_PER_ROW);
+
+    GPtrArray *buttons = g_ptr_array_sized_new(last > first ? last - first : 0);
+    GHashTable *wanted = g_hash_table_new(NULL, NULL);
+
+    for (guint i = first; i < last; i++) {
+        // Prioridad de iconos: primero lo visible, después el margen
+        int rank = i >= first_visible ? (int)(i - first_visible) : (int)(n + first_visible - i);
+        GtkWidget *btn = app_button_pool_get(m, g_ptr_array_index(m->grid_items, i), rank);
+        g_ptr_array_add(buttons, btn);
+        g_hash_table_insert(wanted, btn, GUINT_TO_POINTER(i + 1));
+    }
+
+    // Quitar los que salieron de la vista (el pool conserva su referencia)
+    for (guint i = 0; i < m->grid_buttons->len; i++) {
+        GtkWidget *btn = g_ptr_array_index(m->grid_buttons, i);
+        if (!g_hash_table_contains(wanted, btn))
+            gtk_container_remove(GTK_CONTAINER(m->apps_grid), btn);
+    }
 
-static void populate_apps_for_dir(ModernMenu *m, MenuCacheDir *dir) {
-    if (!m || !m->apps_box) return;
-    m->current_dir = dir;
+    // Insertar los nuevos y mover sólo los que cambiaron de celda
+    for (guint j = 0; j < buttons->len; j++) {
+        GtkWidget *btn = g_ptr_array_index(buttons, j);
+        guint i = first + j;
+        int x = GRID_SPACING + (i % APPS_PER_ROW) * (GRID_CELL_W + GRID_SPACING);
+        int y = GRID_SPACING + (i / APPS_PER_ROW) * row_h;
+
+        if (gtk_widget_get_parent(btn) != m->apps_grid)
+            gtk_layout_put(GTK_LAYOUT(m->apps_grid), btn, x, y);
+        else if (GPOINTER_TO_UINT(g_object_get_data(G_OBJECT(btn), "grid-pos")) != i + 1)
+            gtk_layout_move(GTK_LAYOUT(m->apps_grid), btn, x, y);
+        g_object_set_data(G_OBJECT(btn), "grid-pos", GUINT_TO_POINTER(i + 1));
+    }
 
-    // Limpiar container
-    GList *children = gtk_container_get_children(GTK_CONTAINER(m->apps_box));
-    for (GList *l = children; l; l = l->next)
-        gtk_widget_destroy(GTK_WIDGET(l->data));
-    g_list_free(children);
+    g_hash_table_destroy(wanted);
+    g_ptr_array_free(m->grid_buttons, TRUE);
+    m->grid_buttons = buttons;
 
-    if (!dir) {
-        GtkWidget *lbl = gtk_label_new(_("No applications"));
-        gtk_misc_set_alignment(GTK_MISC(lbl), 0.5, 0.5);
-        gtk_box_pack_start(GTK_BOX(m->apps_box), lbl, FALSE, FALSE, 4);
-        gtk_widget_show(lbl);
-        return;
+    app_button_pool_trim(m);
+}
+
+static void on_apps_grid_scrolled(GtkAdjustment *adj, gpointer user_data)
+{
+    ModernMenu *m = user_data;
+    if (m->grid_page)
+        m->grid_page->scroll = gtk_adjustment_get_value(adj);
+    apps_grid_layout_visible(m);
+}
+
+static void on_apps_grid_size_allocate(GtkWidget *widget, GtkAllocation *alloc, gpointer user_data)
+{
+    (void)widget;
+    ModernMenu *m = user_data;
+
+    // Sólo hace falta recalcular si cambió el alto visible
+    if (alloc->height != m->grid_page_height) {
+        m->grid_page_height = alloc->height;
+        apps_grid_layout_visible(m);
     }
+}
 
-    GSList *list = menu_cache_dir_list_children(dir);
-    if (!list) {
-        GtkWidget *lbl = gtk_label_new(_("No applications in this category"));
-        gtk_misc_set_alignment(GTK_MISC(lbl), 0.5, 0.5);
-        gtk_box_pack_start(GTK_BOX(m->apps_box), lbl, FALSE, FALSE, 4);
-        gtk_widget_show(lbl);
-        return;
+/* Muestra entradas (AppEntry* en orden) en la grilla; si no hay ninguno,
+ * muestra empty_msg */
+/* Reemplaza el modelo de la grilla. Con reset_scroll en FALSE (recargas del
+ * catálogo) se conserva la posición y sólo cambian los botones afectados. */
+static void apps_grid_set(ModernMenu *m, GPtrArray *items, const char *empty_msg, gboolean reset_scroll)
+{
+    guint n = items ? items->len : 0;
+    guint n_rows = (n + APPS_PER_ROW - 1) / APPS_PER_ROW;
+
+    g_ptr_array_set_size(m->grid_items, 0);
+    for (guint i = 0; i < n; i++)
+        g_ptr_array_add(m->grid_items, app_entry_ref(g_ptr_array_index(items, i)));
+
+    gtk_layout_set_size(GTK_LAYOUT(m->apps_grid), GRID_WIDTH,
+                        GRID_SPACING + n_rows * (GRID_CELL_H + GRID_SPACING));
+
+    // Cada vista nueva empieza arriba
+    GtkAdjustment *vadj = gtk_layout_get_vadjustment(GTK_LAYOUT(m->apps_grid));
+    if (reset_scroll && vadj && gtk_adjustment_get_value(vadj) != 0) {
+        g_signal_handlers_block_by_func(vadj, G_CALLBACK(on_apps_grid_scrolled), m);
+        gtk_adjustment_set_value(vadj, 0);
+        g_signal_handlers_unblock_by_func(vadj, G_CALLBACK(on_apps_grid_scrolled), m);
+    }
+
+    apps_grid_layout_visible(m);
+
+    if (n == 0) {
+        gtk_label_set_text(GTK_LABEL(m->apps_message), empty_msg);
+        gtk_widget_show(m->apps_message);
+    } else {
+        gtk_widget_hide(m->apps_message);
+    }
+}
+
+static void apps_grid_show(ModernMenu *m, GPtrArray *items, const char *empty_msg)
+{
+    m->grid_page = NULL;  // favoritos, búsqueda o mensajes: no es una página guardada
+    apps_grid_set(m, items, empty_msg, TRUE);
+}
+
+/* Saca del pool (y de la grilla, si está puesto) el botón de una app */
+static void app_button_pool_forget(ModernMenu *m, const char *id)
+{
+    GtkWidget *btn = g_hash_table_lookup(m->button_pool, id);
+    if (!btn) return;
+
+    if (gtk_widget_get_parent(btn) == m->apps_grid)
+        gtk_container_remove(GTK_CONTAINER(m->apps_grid), btn);
+    g_ptr_array_remove(m->grid_buttons, btn);
+    g_hash_table_remove(m->button_pool, id);
+}
+
+/* Favoritos visibles en orden de catálogo; cuesta O(favoritos), no O(apps) */
+static GPtrArray *collect_favorite_apps(ModernMenu *m)
+{
+    GPtrArray *items = catalog_collect_ids(m->catalog, m->favorites, m->hidden_apps);
+    frecency_sort(items);
+    return items;
+}
+
+/* Devuelve las entradas visibles (sin ocultas) de apps */
+static GPtrArray *collect_visible_apps(GPtrArray *apps, ModernMenu *m)
+{
+    return catalog_filter_visible(apps, m->hidden_apps);
+}
+
+
+/* ==== CACHÉ DE PÁGINAS POR CATEGORÍA ==== */
+/* Cada categoría vista guarda su página: la lista de apps visibles ya
+ * filtrada, los botones de la primera pantalla (fijados, así el recorte del
+ * pool no los destruye) y la posición del scroll. Volver a una categoría
+ * sólo recoloca esos botones. Las páginas se descartan por LRU cuando su
+ * costo estimado pasa page_cache_kb (configurable), y se tiran todas si
+ * cambian el catálogo o las ocultas. Al pasar el puntero sobre una fila de
+ * categorías su página se arma en idle, antes del click. */
+#define PAGE_CACHE_DEFAULT_KB 2048
+#define PAGE_BUTTON_COST (48 * 48 * 4 + 3072)   // icono RGBA + widgets, aprox.
+
+static void category_page_free(gpointer data)
+{
+    CategoryPage *page = data;
+    for (guint i = 0; i < page->buttons->len; i++) {
+        GObject *btn = g_ptr_array_index(page->buttons, i);
+        guint pins = GPOINTER_TO_UINT(g_object_get_data(btn, "page-pins"));
+        g_object_set_data(btn, "page-pins", GUINT_TO_POINTER(pins - 1));
+    }
+    g_ptr_array_free(page->buttons, TRUE);
+    g_ptr_array_free(page->items, TRUE);
+    g_free(page->id);
+    g_free(page);
+}
+
+static void category_page_remove(ModernMenu *m, CategoryPage *page)
+{
+    if (m->grid_page == page)
+        m->grid_page = NULL;
+    m->page_cache_used -= page->cost;
+    g_hash_table_remove(m->pages, page->id);
+}
+
+/* Las apps visibles cambiaron: ninguna página sirve */
+static void category_pages_clear(ModernMenu *m)
+{
+    if (!m->pages) return;
+    m->grid_page = NULL;
+    m->page_cache_used = 0;
+    g_hash_table_remove_all(m->pages);
+}
+
+/* Descarta las páginas usadas hace más tiempo hasta entrar en el límite
+ * (nunca la que está a la vista ni keep) */
+static void category_pages_trim(ModernMenu *m, CategoryPage *keep)
+{
+    while (m->page_cache_used > m->page_cache_limit) {
+        CategoryPage *oldest = NULL;
+        GHashTableIter it;
+        gpointer value;
+
+        g_hash_table_iter_init(&it, m->pages);
+        while (g_hash_table_iter_next(&it, NULL, &value)) {
+            CategoryPage *page = value;
+            if (page == keep || page == m->grid_page) continue;
+            if (!oldest || page->stamp < oldest->stamp) oldest = page;
+        }
+        if (!oldest) break;
+        category_page_remove(m, oldest);
+    }
+}
+
+/* Página de dir: la guardada o una nueva (con los botones de la primera
+ * pantalla ya creados) */
+static CategoryPage *category_page_get(ModernMenu *m, CategoryEntry *dir)
+{
+    TRACE_SPAN("category_page_get");
+    CategoryPage *page = g_hash_table_lookup(m->pages, dir->id);
+    if (page) {
+        page->stamp = ++m->page_clock;
+        return page;
+    }
+
+    page = g_new0(CategoryPage, 1);
+    page->id = g_strdup(dir->id);
+    page->stamp = ++m->page_clock;
+
+    GPtrArray *visible = collect_visible_apps(dir->apps, m);
+    page->items = g_ptr_array_new_full(visible->len, (GDestroyNotify)app_entry_unref);
+    for (guint i = 0; i < visible->len; i++)
+        g_ptr_array_add(page->items, app_entry_ref(g_ptr_array_index(visible, i)));
+    g_ptr_array_free(visible, TRUE);
+
+    // Primera pantalla: las filas que entran en la vista más el margen
+    int height = m->grid_page_height > 0 ? m->grid_page_height : 500;
+    guint rows = height / (GRID_CELL_H + GRID_SPACING) + 1 + GRID_OVERSCAN_ROWS;
+    guint n = MIN(page->items->len, rows * APPS_PER_ROW);
+
+    page->buttons = g_ptr_array_new_full(n, g_object_unref);
+    for (guint i = 0; i < n; i++) {
+        GtkWidget *btn = app_button_pool_get(m, g_ptr_array_index(page->items, i), i);
+        guint pins = GPOINTER_TO_UINT(g_object_get_data(G_OBJECT(btn), "page-pins"));
+        g_object_set_data(G_OBJECT(btn), "page-pins", GUINT_TO_POINTER(pins + 1));
+        g_ptr_array_add(page->buttons, g_object_ref(btn));
     }
 
-    int count = add_apps_to_container(list, m, m->apps_box, NULL);
+    page->cost = n * PAGE_BUTTON_COST + page->items->len * sizeof(gpointer);
+    m->page_cache_used += page->cost;
+    g_hash_table_insert(m->pages, page->id, page);
+    category_pages_trim(m, page);
+    return page;
+}
+
+/* Muestra la página en la grilla, con el scroll donde había quedado */
+static void category_page_show(ModernMenu *m, CategoryPage *page, gboolean restore_scroll)
+{
+    m->grid_page = NULL;  // que volver el scroll a 0 no pise el de la página anterior
+    apps_grid_set(m, page->items, _("No applications in this category"), restore_scroll);
+    m->grid_page = page;
+
+    GtkAdjustment *vadj = gtk_layout_get_vadjustment(GTK_LAYOUT(m->apps_grid));
+    if (restore_scroll && vadj && page->scroll > 0)
+        gtk_adjustment_set_value(vadj, page->scroll);  // recoloca vía on_apps_grid_scrolled
+}
+
+static gboolean category_page_prefetch_idle(gpointer user_data)
+{
+    ModernMenu *m = user_data;
+    m->page_prefetch_id = 0;
+
+    CategoryEntry *dir = m->catalog && m->page_hover_id
+                       ? catalog_lookup_category(m->catalog, m->page_hover_id) : NULL;
+    if (dir && !g_hash_table_contains(m->pages, dir->id))
+        category_page_get(m, dir);
+    return G_SOURCE_REMOVE;
+}
+
+/* Al pasar sobre una fila de categorías, armar su página en idle */
+static gboolean on_categories_motion(GtkWidget *widget, GdkEventMotion *event, gpointer user_data)
+{
+    ModernMenu *m = user_data;
+    GtkTreePath *path = NULL;
+    if (!gtk_tree_view_get_path_at_pos(GTK_TREE_VIEW(widget), event->x, event->y,
+                                       &path, NULL, NULL, NULL))
+        return FALSE;
+
+    GtkTreeModel *model = gtk_tree_view_get_model(GTK_TREE_VIEW(widget));
+    GtkTreeIter iter;
+    gchar *id = NULL;
+    if (gtk_tree_model_get_iter(model, &iter, path))
+        gtk_tree_model_get(model, &iter, COL_DIR_ID, &id, -1);
+    gtk_tree_path_free(path);
+
+    if (id && g_strcmp0(id, m->page_hover_id) != 0 && !g_hash_table_contains(m->pages, id)) {
+        g_free(m->page_hover_id);
+        m->page_hover_id = id;
+        id = NULL;
+        if (!m->page_prefetch_id)
+            m->page_prefetch_id = g_idle_add_full(G_PRIORITY_LOW, category_page_prefetch_idle, m, NULL);
+    }
+    g_free(id);
+    return FALSE;
+}
+/* ==== FIN CACHÉ DE PÁGINAS POR CATEGORÍA ==== */
 
-    g_slist_foreach(list, (GFunc)menu_cache_item_unref, NULL);
-    g_slist_free(list);
+static void populate_apps_for_dir(ModernMenu *m, CategoryEntry *dir) {
+    TRACE_SPAN("populate_apps_for_dir");
+    if (!m || !m->apps_box) return;
+    if (dir != m->current_dir) {
+        g_free(m->current_dir_id);
+        m->current_dir_id = dir ? g_strdup(dir->id) : NULL;
+        m->current_dir = dir;
+    }
+    icon_loader_cancel();
 
-    if (count == 0) {
-        GtkWidget *lbl = gtk_label_new(_("No applications in this category"));
-        gtk_misc_set_alignment(GTK_MISC(lbl), 0.5, 0.5);
-        gtk_box_pack_start(GTK_BOX(m->apps_box), lbl, FALSE, FALSE, 4);
-        gtk_widget_show(lbl);
+    if (!dir) {
+        apps_grid_show(m, NULL, _("No applications"));
+        return;
     }
+
+    category_page_show(m, category_page_get(m, dir), TRUE);
 }
 static void show_favorites_category(GtkWidget *widget, gpointer user_data) {
+    TRACE_SPAN("show_favorites_category");
     ModernMenu *m = user_data;
     if (!m) return;
 
@@ -652,89 +2996,330 @@ static void show_favorites_category(GtkWidget *widget, gpointer user_data) {
     GtkTreeSelection *sel = gtk_tree_view_get_selection(GTK_TREE_VIEW(m->categories));
     gtk_tree_selection_unselect_all(sel);
 
-    // Limpiar container
-    GList *children = gtk_container_get_children(GTK_CONTAINER(m->apps_box));
-    for (GList *l = children; l; l = l->next)
-        gtk_widget_destroy(GTK_WIDGET(l->data));
-    g_list_free(children);
+    m->current_dir = NULL;
+    g_free(m->current_dir_id);
+    m->current_dir_id = NULL;
+    icon_loader_cancel();
+
+    if (!m->catalog_ready) {
+        // Sin menu-cache (ni instantánea) el catálogo no va a llegar nunca
+        apps_grid_show(m, NULL, m->menu_cache ? _("Loading applications…") : _("No applications"));
+        m->switching_category = FALSE;
+        return;
+    }
 
-    if (!m->favorites) {
+    if (g_hash_table_size(m->favorites) == 0) {
         // Mostrar mensaje "no hay favoritos"
-        GtkWidget *lbl = gtk_label_new(_("There's no favorite applications"));
-        gtk_misc_set_alignment(GTK_MISC(lbl), 0.5, 0.5);
-        gtk_box_pack_start(GTK_BOX(m->apps_box), lbl, FALSE, FALSE, 4);
-        gtk_widget_show(lbl);
+        apps_grid_show(m, NULL, _("There's no favorite applications"));
         m->switching_category = FALSE;
         return;
     }
 
-    // ¡USAR HELPER!
-    int count = add_apps_to_container(m->all_apps, m, m->apps_box, filter_favorites);
+    GPtrArray *items = collect_favorite_apps(m);
+    apps_grid_show(m, items, _("No favorite applications visible"));
+    g_ptr_array_free(items, TRUE);
+
+    m->switching_category = FALSE;
+}
+/* ==== BÚSQUEDA ASÍNCRONA ==== */
+/* Las pulsaciones dentro de un mismo frame se agrupan en una sola búsqueda,
+ * que corre en un hilo sobre una referencia inmutable del índice. Cada
+ * búsqueda lleva un número de generación; al volver al hilo principal sólo se
+ * aplica si sigue siendo la más reciente. */
+#define SEARCH_COALESCE_MS 16
+
+struct _SearchPipeline {
+    gint ref_count;
+    ModernMenu *m;          // NULL cuando el plugin ya fue destruido
+    GThreadPool *pool;
+    gint generation;
+    guint coalesce_id;
+};
+
+typedef struct {
+    SearchPipeline *pipeline;
+    SearchIndex *snapshot;
+    gchar *query;
+    gint generation;
+    GArray *hits;           // índices en snapshot, NULL si se descartó
+} SearchJob;
+
+static void search_pipeline_unref(SearchPipeline *sp)
+{
+    if (g_atomic_int_dec_and_test(&sp->ref_count))
+        g_free(sp);
+}
+
+static void search_job_free(SearchJob *job)
+{
+    search_index_unref(job->snapshot);
+    search_pipeline_unref(job->pipeline);
+    if (job->hits) g_array_free(job->hits, TRUE);
+    g_free(job->query);
+    g_free(job);
+}
+
+/* Muestra los resultados (índices de snapshot) sin las apps ocultas */
+static void search_apply_hits(ModernMenu *m, SearchIndex *snapshot, GArray *hits)
+{
+    TRACE_SPAN("search_apply_hits");
+    icon_loader_cancel();
+
+    GPtrArray *items = g_ptr_array_new();
+    for (guint r = 0; r < hits->len; r++) {
+        AppEntry *e = search_index_get_item(snapshot, g_array_index(hits, guint32, r));
+
+        if (!e->id || is_hidden(m, e->id))
+            continue;
+
+        g_ptr_array_add(items, e);
+    }
+
+    // El primer resultado es el que lanza Enter
+    prefetch_schedule(items->len ? g_ptr_array_index(items, 0) : NULL);
+
+    apps_grid_show(m, items, _("No matching applications found"));
+    g_ptr_array_free(items, TRUE);
+}
+
+static gboolean search_job_done(gpointer data)
+{
+    SearchJob *job = data;
+    ModernMenu *m = job->pipeline->m;
+
+    if (m && job->hits && job->generation == g_atomic_int_get(&job->pipeline->generation)) {
+        search_apply_hits(m, job->snapshot, job->hits);
+        trace_metric("keystroke-to-results", &m->trace_keystroke);
+    }
+
+    search_job_free(job);
+    return G_SOURCE_REMOVE;
+}
+
+static void search_worker(gpointer data, gpointer user_data)
+{
+    (void)user_data;
+    SearchJob *job = data;
 
-    if (count == 0) {
-        GtkWidget *lbl = gtk_label_new(_("No favorite applications visible"));
-        gtk_misc_set_alignment(GTK_MISC(lbl), 0.5, 0.5);
-        gtk_box_pack_start(GTK_BOX(m->apps_box), lbl, FALSE, FALSE, 4);
-        gtk_widget_show(lbl);
+    // Si ya se tipeó algo más, no vale la pena buscar
+    if (job->generation == g_atomic_int_get(&job->pipeline->generation)) {
+        TRACE_SPAN("search_index_rank");
+        job->hits = search_rank_with_frecency(job->snapshot, job->query);
     }
 
-    m->switching_category = FALSE;
+    g_idle_add(search_job_done, job);
+}
+
+/* Invalida las búsquedas en curso (nuevo texto, recarga del catálogo...) */
+static gint search_pipeline_cancel(SearchPipeline *sp)
+{
+    return g_atomic_int_add(&sp->generation, 1) + 1;
+}
+
+static gboolean search_dispatch(gpointer user_data)
+{
+    TRACE_SPAN("search_dispatch");
+    ModernMenu *m = user_data;
+    SearchPipeline *sp = m->search_pipeline;
+    sp->coalesce_id = 0;
+
+    const gchar *text = gtk_entry_get_text(GTK_ENTRY(m->search));
+    gint generation = search_pipeline_cancel(sp);
+
+    if (text == NULL || *text == '\0') {
+        if (m->current_dir)
+            populate_apps_for_dir(m, m->current_dir);
+        else
+            show_favorites_category(NULL, m);
+        trace_metric("keystroke-to-results", &m->trace_keystroke);
+        return G_SOURCE_REMOVE;
+    }
+    if (!m->search_index) {
+        apps_grid_show(m, NULL, m->catalog_ready || !m->menu_cache ? _("No matching applications found")
+                                                                   : _("Loading applications…"));
+        return G_SOURCE_REMOVE;
+    }
+
+    SearchJob *job = g_new0(SearchJob, 1);
+    g_atomic_int_inc(&sp->ref_count);
+    job->pipeline = sp;
+    job->snapshot = search_index_ref(m->search_index);
+    job->query = g_strdup(text);
+    job->generation = generation;
+
+    if (sp->pool) {
+        g_thread_pool_push(sp->pool, job, NULL);
+    } else {
+        // Sin hilos disponibles: buscar en el momento
+        job->hits = search_rank_with_frecency(job->snapshot, job->query);
+        search_job_done(job);
+    }
+    return G_SOURCE_REMOVE;
 }
+
 static void on_search_changed(GtkEditable *entry, gpointer user_data) {
+    TRACE_SPAN("on_search_changed");
+    (void)entry;
     ModernMenu *m = user_data;
-    if (!m || !m->apps_box) return;
+    if (!m || !m->apps_box || !m->search_pipeline) return;
+
+    trace_mark(&m->trace_keystroke);
+
+    // Agrupar las pulsaciones de un mismo frame en una sola búsqueda
+    if (!m->search_pipeline->coalesce_id)
+        m->search_pipeline->coalesce_id = g_timeout_add(SEARCH_COALESCE_MS, search_dispatch, m);
+}
+
+/* Enter en la búsqueda abre el mejor resultado. Se rankea en el momento
+ * para no depender de que el worker ya haya pintado la última consulta. */
+static void on_search_activate(GtkEntry *entry, gpointer user_data)
+{
+    ModernMenu *m = user_data;
+    const gchar *text = gtk_entry_get_text(entry);
+    if (!m || !m->search_index || !text || !*text) return;
+
+    GArray *hits = search_rank_with_frecency(m->search_index, text);
+    for (guint r = 0; r < hits->len; r++) {
+        AppEntry *e = search_index_get_item(m->search_index, g_array_index(hits, guint32, r));
+
+        if (e->id && !is_hidden(m, e->id)) {
+            launch_app_entry(m, e, gtk_widget_get_screen(GTK_WIDGET(entry)));
+            break;
+        }
+    }
+    g_array_free(hits, TRUE);
+}
+
+static SearchPipeline *search_pipeline_new(ModernMenu *m)
+{
+    SearchPipeline *sp = g_new0(SearchPipeline, 1);
+    sp->ref_count = 1;
+    sp->m = m;
+    sp->pool = g_thread_pool_new(search_worker, NULL, 1, FALSE, NULL);
+    return sp;
+}
 
-    const gchar *text = gtk_entry_get_text(GTK_ENTRY(entry));
-    gboolean empty = (text == NULL || *text == '\0');
+static void search_pipeline_destroy(SearchPipeline *sp)
+{
+    if (!sp) return;
+
+    sp->m = NULL;
+    search_pipeline_cancel(sp);
+    if (sp->coalesce_id)
+        g_source_remove(sp->coalesce_id);
+    // Los trabajos encolados se saltan y liberan en el bucle principal
+    if (sp->pool)
+        g_thread_pool_free(sp->pool, FALSE, TRUE);
+    sp->pool = NULL;
+    search_pipeline_unref(sp);
+}
 
-    // Limpiar container
-    GList *children = gtk_container_get_children(GTK_CONTAINER(m->apps_box));
-    for (GList *l = children; l; l = l->next)
-        gtk_widget_destroy(GTK_WIDGET(l->data));
-    g_list_free(children);
 
-    if (empty) {
+/* ==== APERTURA INSTANTÁNEA ==== */
+/* La ventana se arma y se realiza una sola vez, y ocultarla no cuesta nada:
+ * al abrir se muestra tal como quedó. La vista sólo se rehace si mientras
+ * estaba cerrada cambiaron favoritos, ocultas, el orden de uso o el catálogo
+ * (view_dirty); una búsqueda de la vez anterior se borra al volver a abrir.
+ * La posición se calcula una vez por geometría del panel y se invalida
+ * cuando el botón se reubica, se mueve la ventana del panel, cambia la
+ * pantalla o el tema. */
+static void view_refresh(ModernMenu *m)
+{
+    if (m->current_dir)
         populate_apps_for_dir(m, m->current_dir);
-        return;
+    else
+        show_favorites_category(NULL, m);
+}
+
+/* La vista actual quedó vieja: rehacerla ya si se ve, si no al abrir */
+static void view_invalidate(ModernMenu *m)
+{
+    if (m->window_shown)
+        view_refresh(m);
+    else
+        m->view_dirty = TRUE;
+}
+
+/* Deja la vista lista antes de mostrar la ventana */
+static void view_prepare(ModernMenu *m)
+{
+    const gchar *text = gtk_entry_get_text(GTK_ENTRY(m->search));
+    if (text && *text) {
+        // Vaciar sin disparar on_search_changed: la vista se rehace una vez acá
+        g_signal_handlers_block_by_func(m->search, G_CALLBACK(on_search_changed), m);
+        gtk_entry_set_text(GTK_ENTRY(m->search), "");
+        g_signal_handlers_unblock_by_func(m->search, G_CALLBACK(on_search_changed), m);
+        if (m->search_pipeline->coalesce_id) {
+            g_source_remove(m->search_pipeline->coalesce_id);
+            m->search_pipeline->coalesce_id = 0;
+        }
+        search_pipeline_cancel(m->search_pipeline);
+        m->view_dirty = TRUE;
     }
 
-    int count = 0;
-    GtkWidget *current_hbox = NULL;
-
-    for (GSList *l = m->all_apps; l; l = l->next) {
-        MenuCacheItem *item = MENU_CACHE_ITEM(l->data);
-        const char *name = menu_cache_item_get_name(item);
-        const char *id = menu_cache_item_get_id(item);
+    if (m->view_dirty) {
+        m->view_dirty = FALSE;
+        view_refresh(m);
+    }
+}
 
-        if (!name || !id || !strcasestr(name, text) || is_hidden(m, id))
-            continue;
+static void on_plugin_button_size_allocate(GtkWidget *widget, GtkAllocation *alloc, gpointer user_data)
+{
+    (void)widget; (void)alloc;
+    ModernMenu *m = user_data;
+    m->position_valid = FALSE;
+}
 
-        if (count % APPS_PER_ROW == 0 || current_hbox == NULL) {
-            current_hbox = gtk_hbox_new(TRUE, 8);
-            gtk_box_pack_start(GTK_BOX(m->apps_box), current_hbox, FALSE, FALSE, 4);
-            gtk_widget_show(current_hbox);
-        }
+/* Conectadas con g_signal_connect_object al botón: se van con él */
+static gboolean on_panel_configure(GtkWidget *widget, GdkEventConfigure *event, gpointer button)
+{
+    (void)widget; (void)event;
+    ModernMenu *m = lxpanel_plugin_get_data(button);
+    if (m) m->position_valid = FALSE;
+    return FALSE;
+}
 
-        GtkWidget *btn = create_app_button(item, m);
-        gtk_box_pack_start(GTK_BOX(current_hbox), btn, FALSE, FALSE, 0);
-        count++;
-    }
+static void on_screen_size_changed(GdkScreen *screen, gpointer button)
+{
+    (void)screen;
+    ModernMenu *m = lxpanel_plugin_get_data(button);
+    if (m) m->position_valid = FALSE;
+}
 
-    if (count == 0) {
-        GtkWidget *lbl = gtk_label_new(_("No matching applications found"));
-        gtk_misc_set_alignment(GTK_MISC(lbl), 0.5, 0.5);
-        gtk_box_pack_start(GTK_BOX(m->apps_box), lbl, FALSE, FALSE, 4);
-        gtk_widget_show(lbl);
-    }
+static void on_window_style_set(GtkWidget *widget, GtkStyle *previous, gpointer user_data)
+{
+    (void)widget; (void)previous;
+    ModernMenu *m = user_data;
+    m->position_valid = FALSE;
 }
 
+/* Empieza a seguir los cambios de geometría del panel y de la pantalla */
+static void position_track(ModernMenu *m)
+{
+    if (m->position_tracked) return;
+    m->position_tracked = TRUE;
+
+    GtkWidget *toplevel = gtk_widget_get_toplevel(m->plugin_button);
+    if (gtk_widget_is_toplevel(toplevel))
+        g_signal_connect_object(toplevel, "configure-event", G_CALLBACK(on_panel_configure),
+                                m->plugin_button, 0);
+    g_signal_connect_object(gtk_widget_get_screen(m->plugin_button), "size-changed",
+                            G_CALLBACK(on_screen_size_changed), m->plugin_button, 0);
+}
 
 static void position_window_near_button(ModernMenu *m)
 {
+    TRACE_SPAN("position_window_near_button");
     if (!m || !m->plugin_button || !m->window) return;
 
+    if (m->position_valid) {
+        gtk_window_move(GTK_WINDOW(m->window), m->window_x, m->window_y);
+        return;
+    }
+
     GdkWindow *w = gtk_widget_get_window(m->plugin_button);
     if (!w) return;
+    position_track(m);
 
     gint bx, by;
     gdk_window_get_origin(w, &bx, &by);
@@ -759,8 +3344,12 @@ static void position_window_near_button(ModernMenu *m)
     if (y < 0) y = 0;
     if (y + win_h > screen_height) y = screen_height - win_h;
 
+    m->window_x = x;
+    m->window_y = y;
+    m->position_valid = TRUE;
     gtk_window_move(GTK_WINDOW(m->window), x, y);
 }
+/* ==== FIN APERTURA INSTANTÁNEA ==== */
 static void hide_menu(ModernMenu *m)
 {
     if (!m || !m->window) return;
@@ -769,10 +3358,10 @@ static void hide_menu(ModernMenu *m)
         return; // evita cierre si hay menú contextual abierto
     }
 
+    // Nada más: la vista y la búsqueda se acomodan al volver a abrir
     if (m->window_shown) {
         gtk_widget_hide(m->window);
         m->window_shown = FALSE;
-        gtk_entry_set_text(GTK_ENTRY(m->search), "");
     }
 }
 
@@ -787,9 +3376,12 @@ static gboolean on_plugin_button_press(GtkWidget *widget, GdkEventButton *event,
         if (m->window_shown) {
             hide_menu(m);
         } else {
+            TRACE_SPAN("open_menu");
+            preload_touch();
+            trace_mark(&m->trace_click);
+            ensure_window(m);
+            view_prepare(m);
             position_window_near_button(m);
-            show_favorites_category(NULL, m);
-            gtk_widget_show_all(m->window);
             gtk_window_present(GTK_WINDOW(m->window));
             gtk_widget_grab_focus(m->search);
             m->window_shown = TRUE;
@@ -808,13 +3400,14 @@ static gboolean on_app_button_press(GtkWidget *widget, GdkEventButton *event, gp
         show_context_menu(widget, m, event);
         return TRUE;
     } else if (event->button == 1) { // Click izquierdo - preparar drag
-        // Desconectar handler anterior
-        g_signal_handlers_disconnect_matched(m->ds, G_SIGNAL_MATCH_FUNC,
-                                             0, 0, NULL, on_app_drag_data_get, NULL);
-
-        // Reasignar FmDndSrc al botón actual
-        fm_dnd_src_set_widget(m->ds, widget);
-        g_signal_connect(m->ds, "data-get", G_CALLBACK(on_app_drag_data_get), widget);
+        // Apuntar el FmDndSrc compartido al botón, sólo si cambió
+        if (m->drag_button != widget) {
+            if (m->drag_button)
+                g_object_remove_weak_pointer(G_OBJECT(m->drag_button), (gpointer *)&m->drag_button);
+            fm_dnd_src_set_widget(m->ds, widget);
+            m->drag_button = widget;
+            g_object_add_weak_pointer(G_OBJECT(widget), (gpointer *)&m->drag_button);
+        }
 
         return FALSE; // Permitir que continúe el evento
     }
@@ -825,51 +3418,51 @@ static gboolean on_app_button_press(GtkWidget *widget, GdkEventButton *event, gp
 /* Callback cuando comienza el drag */
 static void on_app_drag_begin(GtkWidget *widget, GdkDragContext *context, gpointer user_data)
 {
-    MenuCacheItem *item = g_object_get_data(G_OBJECT(widget), "menu-item");
-    if (!item) return;
+    AppEntry *e = g_object_get_data(G_OBJECT(widget), "app-entry");
+    if (!e) return;
 
     // Establecer icono para el drag
-    GdkPixbuf *pb = get_app_icon(item, 48);
+    GdkPixbuf *pb = get_app_icon(e, 48);
     if (pb) {
         gtk_drag_set_icon_pixbuf(context, pb, 0, 0);
         g_object_unref(pb);
     }
 }
-/* Callback para proveer los datos del drag */
-static void on_app_drag_data_get(FmDndSrc *ds, GtkWidget *btn)
+/* Callback para proveer los datos del drag (conectado una sola vez) */
+static void on_app_drag_data_get(FmDndSrc *ds, gpointer user_data)
 {
-    static GQuark SYS_MENU_ITEM_ID = 0;
-    if (SYS_MENU_ITEM_ID == 0)
-        SYS_MENU_ITEM_ID = g_quark_from_static_string("SysMenuItem");
+    ModernMenu *m = user_data;
+    if (!m->drag_button) return;
 
-    FmFileInfo *fi = g_object_get_qdata(G_OBJECT(btn), SYS_MENU_ITEM_ID);
+    // NULL si el botón viene de la instantánea y todavía no llegó el item vivo
+    AppEntry *e = g_object_get_data(G_OBJECT(m->drag_button), "app-entry");
+    FmFileInfo *fi = e ? app_entry_file_info(e) : NULL;
     if (!fi) return;
 
     fm_dnd_src_set_file(ds, fi);
 }
 
 /* Launch application */
-static void launch_app_from_item(GtkWidget *button, gpointer user_data)
+/* Lanza e en screen y cierra el menú de m (si hay) */
+static void launch_app_entry(ModernMenu *m, AppEntry *e, GdkScreen *screen)
 {
-    MenuCacheItem *item = (MenuCacheItem *) user_data;
-    ModernMenu *m = g_object_get_data(G_OBJECT(button), "modern-menu");
-    if (!item) {
+    TRACE_SPAN("launch_app_entry");
+    if (!e) {
         g_warning(_("No MenuCacheItem associated with the button"));
         return;
     }
 
-    const gchar *desktop_file = menu_cache_item_get_file_path(item);
+    const gchar *desktop_file = e->file;
     if (!desktop_file) {
         g_warning(_("Could not get .desktop file from the item"));
         return;
     }
 
-    GDesktopAppInfo *dinfo = g_desktop_app_info_new_from_filename(desktop_file);
+    GDesktopAppInfo *dinfo = prefetch_app_info(desktop_file);
     if (dinfo) {
         GError *error = NULL;
 
         // Crear contexto de lanzamiento para GTK+2
-        GdkScreen *screen = gtk_widget_get_screen(button);
         GdkAppLaunchContext *context = gdk_app_launch_context_new();
         gdk_app_launch_context_set_screen(context, screen);
         gdk_app_launch_context_set_timestamp(context, gtk_get_current_event_time());
@@ -877,7 +3470,12 @@ static void launch_app_from_item(GtkWidget *button, gpointer user_data)
         if (!g_app_info_launch(G_APP_INFO(dinfo), NULL, G_APP_LAUNCH_CONTEXT(context), &error)) {
             g_warning(_("Error launching '%s': %s"), desktop_file, error->message);
             g_clear_error(&error);
+        } else {
+            frecency_record(frecency.store, e->id, frecency_now());
+            if (m && !m->current_dir)
+                m->view_dirty = TRUE;  // cambió el orden de los favoritos
         }
+        preload_touch();
 
         g_object_unref(context);
         g_object_unref(dinfo);
@@ -890,26 +3488,283 @@ static void launch_app_from_item(GtkWidget *button, gpointer user_data)
     }
 }
 
+static void launch_app_from_item(GtkWidget *button, gpointer user_data)
+{
+    launch_app_entry(g_object_get_data(G_OBJECT(button), "modern-menu"),
+                     (AppEntry *)user_data, gtk_widget_get_screen(button));
+}
+
+/* ==== ACCIONES ASÍNCRONAS ==== */
+/* Las acciones del menú contextual (desinstalar, copiar al escritorio,
+ * avisar) no traban el panel: los procesos corren con GSubprocess y su salida
+ * se lee línea por línea de forma asíncrona, y los archivos se copian con GIO
+ * asíncrono. Cada línea llega al bucle principal como progreso y al final se
+ * avisa el resultado. Al destruirse la última instancia se deja de escuchar,
+ * pero los procesos siguen y su salida se sigue leyendo hasta que terminan:
+ * cerrar la tubería antes mataría con SIGPIPE a un gestor de paquetes a la
+ * mitad de su trabajo. */
+typedef void (*ActionProgressFunc)(const char *line, gpointer user_data);
+/* output es NULL si se dejó de escuchar (plugin destruido) */
+typedef void (*ActionDoneFunc)(gboolean ok, const char *output, gpointer user_data);
+
+typedef struct {
+    GSubprocess *proc;
+    GDataInputStream *out;          // stdout con stderr mezclado
+    GString *output;
+    ActionProgressFunc progress;    // NULL los dos si ya nadie escucha
+    ActionDoneFunc done;
+    gpointer user_data;
+} Action;
+
+static struct {
+    GCancellable *cancellable;      // copias de archivos
+    GList *running;                 // Action* con el proceso vivo
+    gint users;
+} actions;
+
+static void action_finish(Action *a, gboolean ok)
+{
+    actions.running = g_list_remove(actions.running, a);
+    if (a->done)
+        a->done(ok, a->output->str, a->user_data);
+
+    g_object_unref(a->out);
+    g_object_unref(a->proc);
+    g_string_free(a->output, TRUE);
+    g_free(a);
+}
+
+static void action_wait_done(GObject *source, GAsyncResult *res, gpointer data)
+{
+    (void)source;
+    Action *a = data;
+    gboolean ok = g_subprocess_wait_check_finish(a->proc, res, NULL);
+    action_finish(a, ok);
+}
+
+static void action_read_line(GObject *source, GAsyncResult *res, gpointer data)
+{
+    (void)source;
+    Action *a = data;
+    gsize len;
+    gchar *line = g_data_input_stream_read_line_finish(a->out, res, &len, NULL);
+
+    if (!line) {
+        // Fin de la salida: falta el código de salida
+        g_subprocess_wait_check_async(a->proc, NULL, action_wait_done, a);
+        return;
+    }
+
+    // Sin nadie escuchando sólo se vacía la tubería
+    if (!a->done && !a->progress) {
+        g_free(line);
+        g_data_input_stream_read_line_async(a->out, G_PRIORITY_DEFAULT, NULL,
+                                            action_read_line, a);
+        return;
+    }
+
+    g_string_append_len(a->output, line, len);
+    g_string_append_c(a->output, '\n');
+    if (a->progress && g_utf8_validate(line, len, NULL))
+        a->progress(line, a->user_data);
+    g_free(line);
+
+    g_data_input_stream_read_line_async(a->out, G_PRIORITY_DEFAULT, NULL,
+                                        action_read_line, a);
+}
+
+/* Corre argv sin shell. Con c_locale la salida queda en inglés para poder
+ * interpretarla. done se llama siempre una vez (en el acto si no se pudo
+ * lanzar el programa). */
+static void action_spawn(const char *const *argv, gboolean c_locale,
+                         ActionProgressFunc progress, ActionDoneFunc done, gpointer user_data)
+{
+    GSubprocessLauncher *launcher = g_subprocess_launcher_new(G_SUBPROCESS_FLAGS_STDOUT_PIPE |
+                                                              G_SUBPROCESS_FLAGS_STDERR_MERGE);
+    if (c_locale)
+        g_subprocess_launcher_setenv(launcher, "LC_ALL", "C", TRUE);
+
+    GError *error = NULL;
+    GSubprocess *proc = g_subprocess_launcher_spawnv(launcher, argv, &error);
+    g_object_unref(launcher);
+    flight_record('I', "action_spawn");
+
+    if (!proc) {
+        g_debug("modernmenu: could not run %s: %s", argv[0], error->message);
+        g_error_free(error);
+        if (done) done(FALSE, "", user_data);
+        return;
+    }
+
+    Action *a = g_new0(Action, 1);
+    a->proc = proc;
+    a->out = g_data_input_stream_new(g_subprocess_get_stdout_pipe(proc));
+    g_data_input_stream_set_newline_type(a->out, G_DATA_STREAM_NEWLINE_TYPE_ANY);
+    a->output = g_string_new("");
+    a->progress = progress;
+    a->done = done;
+    a->user_data = user_data;
+    actions.running = g_list_prepend(actions.running, a);
+
+    g_data_input_stream_read_line_async(a->out, G_PRIORITY_DEFAULT, NULL,
+                                        action_read_line, a);
+}
+
+/* Notificación de escritorio; si no hay notify-send no pasa nada */
+static void action_notify(const char *summary, const char *body)
+{
+    const char *argv[] = { "notify-send", summary, body, NULL };
+    action_spawn(argv, FALSE, NULL, NULL, NULL);
+}
+
+static void actions_ref(void)
+{
+    if (actions.users++ > 0) return;
+    actions.cancellable = g_cancellable_new();
+}
+
+static void actions_unref(void)
+{
+    if (actions.users == 0 || --actions.users > 0) return;
+
+    g_cancellable_cancel(actions.cancellable);
+    g_object_unref(actions.cancellable);
+    actions.cancellable = NULL;
+
+    // Los procesos siguen hasta terminar; sólo se avisa que nadie escucha
+    for (GList *l = actions.running; l; l = l->next) {
+        Action *a = l->data;
+        ActionDoneFunc done = a->done;
+        a->done = NULL;
+        a->progress = NULL;
+        if (done)
+            done(FALSE, NULL, a->user_data);
+    }
+}
+/* ==== FIN ACCIONES ASÍNCRONAS ==== */
+
+/* ==== ESCRITORIO ==== */
+/* "Agregar al escritorio" se ofrece sólo si el acceso no existe. Para no
+ * tocar el disco en cada click derecho, los nombres del escritorio se listan
+ * una vez de forma asíncrona y después los mantiene al día un GFileMonitor. */
+static struct {
+    gchar *dir;
+    GHashTable *names;              // archivos presentes
+    gboolean listed;                // names ya tiene el listado completo
+    GFileMonitor *monitor;
+    GCancellable *cancellable;
+    gint users;
+} desktop;
+
+static void on_desktop_changed(GFileMonitor *monitor, GFile *file, GFile *other,
+                               GFileMonitorEvent event, gpointer user_data)
+{
+    (void)monitor; (void)other; (void)user_data;
+    if (event == G_FILE_MONITOR_EVENT_CREATED) {
+        g_hash_table_add(desktop.names, g_file_get_basename(file));
+    } else if (event == G_FILE_MONITOR_EVENT_DELETED) {
+        gchar *name = g_file_get_basename(file);
+        g_hash_table_remove(desktop.names, name);
+        g_free(name);
+    }
+}
+
+static void desktop_next_files(GObject *source, GAsyncResult *res, gpointer data)
+{
+    (void)data;
+    GFileEnumerator *en = G_FILE_ENUMERATOR(source);
+    GError *error = NULL;
+    GList *infos = g_file_enumerator_next_files_finish(en, res, &error);
+
+    if (!infos) {
+        // Terminó, o falló / se canceló (y desktop ya puede estar vacío)
+        if (!error)
+            desktop.listed = TRUE;
+        g_clear_error(&error);
+        g_object_unref(en);
+        return;
+    }
+
+    for (GList *l = infos; l; l = l->next)
+        g_hash_table_add(desktop.names, g_strdup(g_file_info_get_name(l->data)));
+    g_list_free_full(infos, g_object_unref);
+
+    g_file_enumerator_next_files_async(en, 64, G_PRIORITY_LOW, desktop.cancellable,
+                                       desktop_next_files, NULL);
+}
+
+static void desktop_enumerated(GObject *source, GAsyncResult *res, gpointer data)
+{
+    (void)data;
+    GFileEnumerator *en = g_file_enumerate_children_finish(G_FILE(source), res, NULL);
+    if (!en) return;  // sin escritorio: se ofrece siempre y la copia avisa si ya existe
+    g_file_enumerator_next_files_async(en, 64, G_PRIORITY_LOW, desktop.cancellable,
+                                       desktop_next_files, NULL);
+}
+
+static void desktop_ref(void)
+{
+    if (desktop.users++ > 0) return;
+
+    const char *home = g_get_home_dir();
+    desktop.dir = g_build_filename(home, _("Desktop"), NULL);
+    if (!g_file_test(desktop.dir, G_FILE_TEST_IS_DIR)) {
+        g_free(desktop.dir);
+        desktop.dir = g_build_filename(home, "Desktop", NULL);
+    }
+
+    desktop.names = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    desktop.cancellable = g_cancellable_new();
+
+    GFile *dir = g_file_new_for_path(desktop.dir);
+    desktop.monitor = g_file_monitor_directory(dir, G_FILE_MONITOR_NONE, NULL, NULL);
+    if (desktop.monitor)
+        g_signal_connect(desktop.monitor, "changed", G_CALLBACK(on_desktop_changed), NULL);
+    g_file_enumerate_children_async(dir, G_FILE_ATTRIBUTE_STANDARD_NAME, G_FILE_QUERY_INFO_NONE,
+                                    G_PRIORITY_LOW, desktop.cancellable, desktop_enumerated, NULL);
+    g_object_unref(dir);
+}
+
+static void desktop_unref(void)
+{
+    if (desktop.users == 0 || --desktop.users > 0) return;
+
+    g_cancellable_cancel(desktop.cancellable);
+    g_object_unref(desktop.cancellable);
+    if (desktop.monitor) {
+        g_file_monitor_cancel(desktop.monitor);
+        g_object_unref(desktop.monitor);
+    }
+    g_hash_table_destroy(desktop.names);
+    g_free(desktop.dir);
+    memset(&desktop, 0, sizeof(desktop));
+}
+
+/* ¿Ya hay un archivo con ese nombre en el escritorio? (sin tocar el disco) */
+static gboolean desktop_has(const char *basename)
+{
+    return desktop.listed && g_hash_table_contains(desktop.names, basename);
+}
+/* ==== FIN ESCRITORIO ==== */
+
 /* Menu contextual */
 static void show_context_menu(GtkWidget *app_button, ModernMenu *m, GdkEventButton *event)
 {
     if (!app_button || !m) return;
     GtkWidget *menu = gtk_menu_new();
 
-    /* Obtener el id desde el MenuCacheItem asociado al botón */
-    MenuCacheItem *item = g_object_get_data(G_OBJECT(app_button), "menu-item");
+    /* Obtener el id desde la entrada asociada al botón */
+    AppEntry *entry = g_object_get_data(G_OBJECT(app_button), "app-entry");
     const char *app_id = NULL;
     gboolean is_fav = FALSE;
     gboolean is_hid = FALSE;
 
-    if (item)
-        app_id = menu_cache_item_get_id(item);
+    if (entry)
+        app_id = entry->id;
 
     if (app_id) {
-        if (g_slist_find_custom(m->favorites, app_id, (GCompareFunc)g_strcmp0))
-            is_fav = TRUE;
-        if (g_slist_find_custom(m->hidden_apps, app_id, (GCompareFunc)g_strcmp0))
-            is_hid = TRUE;
+        is_fav = is_favorite(m, app_id);
+        is_hid = is_hidden(m, app_id);
     }
 
     /* ===== Agregar/Quitar de Favoritos ===== */
@@ -930,19 +3785,11 @@ static void show_context_menu(GtkWidget *app_button, ModernMenu *m, GdkEventButt
 
 
     /* ===== Agregar al Escritorio ===== */
-    const char *desktop_file = item ? menu_cache_item_get_file_path(item) : NULL;
+    const char *desktop_file = entry ? entry->file : NULL;
     if (desktop_file) {
-        const char *home = g_get_home_dir();
-        gchar *desktop_dir = g_build_filename(home, _("Desktop"), NULL);
-        if (!g_file_test(desktop_dir, G_FILE_TEST_IS_DIR)) {
-            g_free(desktop_dir);
-            desktop_dir = g_build_filename(home, "Desktop", NULL);
-        }
-
         gchar *basename = g_path_get_basename(desktop_file);
-        gchar *dest_file = g_build_filename(desktop_dir, basename, NULL);
 
-        if (!g_file_test(dest_file, G_FILE_TEST_EXISTS)) {
+        if (!desktop_has(basename)) {
             GtkWidget *desktop_item = gtk_menu_item_new_with_label(_("Add to Desktop"));
             gtk_menu_shell_append(GTK_MENU_SHELL(menu), desktop_item);
             gtk_widget_show(desktop_item);
@@ -950,8 +3797,6 @@ static void show_context_menu(GtkWidget *app_button, ModernMenu *m, GdkEventButt
         }
 
         g_free(basename);
-        g_free(dest_file);
-        g_free(desktop_dir);
     }
 
     /* Separador */
@@ -991,96 +3836,463 @@ static void on_context_menu_done(GtkMenuShell *menu_shell, gpointer user_data)
         m->suppress_hide = FALSE;
 }
 
+typedef struct {
+    GFile *dest;
+    gchar *app_name;
+} DesktopCopy;
+
+static void desktop_copy_free(DesktopCopy *c)
+{
+    g_object_unref(c->dest);
+    g_free(c->app_name);
+    g_free(c);
+}
+
+static void on_desktop_chmod_done(GObject *source, GAsyncResult *res, gpointer data)
+{
+    DesktopCopy *c = data;
+    g_file_set_attributes_finish(G_FILE(source), res, NULL, NULL);
+    action_notify(_("Added to desktop"), c->app_name);
+    desktop_copy_free(c);
+}
+
+static void on_desktop_copy_done(GObject *source, GAsyncResult *res, gpointer data)
+{
+    DesktopCopy *c = data;
+    GError *error = NULL;
+
+    if (!g_file_copy_finish(G_FILE(source), res, &error)) {
+        if (g_error_matches(error, G_IO_ERROR, G_IO_ERROR_EXISTS))
+            g_message(_("The shortcut already exists on the desktop."));
+        else if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+            g_warning(_("Error copying to desktop: %s"), error->message);
+        g_error_free(error);
+        desktop_copy_free(c);
+        return;
+    }
+
+    // Ejecutable, para que el escritorio lo acepte como lanzador
+    GFileInfo *info = g_file_info_new();
+    g_file_info_set_attribute_uint32(info, G_FILE_ATTRIBUTE_UNIX_MODE, 0755);
+    g_file_set_attributes_async(c->dest, info, G_FILE_QUERY_INFO_NONE, G_PRIORITY_DEFAULT,
+                                NULL, on_desktop_chmod_done, c);
+    g_object_unref(info);
+}
+
 static void add_to_desktop(GtkMenuItem *menuitem, gpointer user_data)
 {
     GtkWidget *app_button = GTK_WIDGET(user_data);
     if (!app_button) return;
 
-    MenuCacheItem *item = g_object_get_data(G_OBJECT(app_button), "menu-item");
-    if (!item) return;
-
-    const char *desktop_file = menu_cache_item_get_file_path(item);
-    const char *app_name = menu_cache_item_get_name(item);
-    if (!desktop_file || !app_name) return;
+    AppEntry *entry = g_object_get_data(G_OBJECT(app_button), "app-entry");
+    if (!entry) return;
 
-    /* Ruta de destino */
-    const char *home = g_get_home_dir();
-    gchar *desktop_dir = g_build_filename(home, _("Desktop"), NULL);
-    if (!g_file_test(desktop_dir, G_FILE_TEST_IS_DIR)) {
-        g_free(desktop_dir);
-        desktop_dir = g_build_filename(home, "Desktop", NULL);
-    }
+    const char *desktop_file = entry->file;
+    const char *app_name = entry->name;
+    if (!desktop_file || !app_name || !desktop.dir) return;
 
+    /* Copiar sin pisar: si ya existe, la copia falla con G_IO_ERROR_EXISTS */
     gchar *basename = g_path_get_basename(desktop_file);
-    gchar *dest_file = g_build_filename(desktop_dir, basename, NULL);
+    gchar *dest_file = g_build_filename(desktop.dir, basename, NULL);
+    GFile *src = g_file_new_for_path(desktop_file);
 
-    /* Si ya existe, no hacer nada */
-    if (g_file_test(dest_file, G_FILE_TEST_EXISTS)) {
-        g_message(_("The shortcut already exists on the desktop."));
-        goto cleanup;
-    }
-
-    /* Copiar archivo */
-    GError *error = NULL;
-    if (!g_file_copy(
-        g_file_new_for_path(desktop_file),
-                     g_file_new_for_path(dest_file),
-                     G_FILE_COPY_NONE,
-                     NULL, NULL, NULL, &error))
-    {
-        g_warning(_("Error copying to desktop: %s"), error->message);
-        g_error_free(error);
-    } else {
-        g_chmod(dest_file, 0755);
-        /* Notificación opcional */
-        gchar *cmd = g_strdup_printf("notify-send '%s' '%s'",
-                                     _("Added to desktop"), app_name);
-        g_spawn_command_line_async(cmd, NULL);
-        g_free(cmd);
-    }
+    DesktopCopy *c = g_new0(DesktopCopy, 1);
+    c->dest = g_file_new_for_path(dest_file);
+    c->app_name = g_strdup(app_name);
+    g_file_copy_async(src, c->dest, G_FILE_COPY_NONE, G_PRIORITY_DEFAULT, actions.cancellable,
+                      NULL, NULL, on_desktop_copy_done, c);
 
-    cleanup:
-    g_free(basename);
+    g_object_unref(src);
     g_free(dest_file);
-    g_free(desktop_dir);
+    g_free(basename);
 }
 static void show_properties(GtkMenuItem *menuitem, gpointer user_data)
 {
     GtkWidget *app_button = GTK_WIDGET(user_data);
     if (!app_button) return;
 
-    // Obtener el MenuCacheItem desde el botón (como ya lo haces)
-    MenuCacheItem *item = g_object_get_data(G_OBJECT(app_button), "menu-item");
-    if (!item) return;
+    // Obtener la entrada desde el botón
+    AppEntry *entry = g_object_get_data(G_OBJECT(app_button), "app-entry");
+    if (!entry) return;
 
-    // Crear FmFileInfo a partir del MenuCacheItem (como hace LXPanel)
-    char *mpath = menu_cache_dir_make_path(MENU_CACHE_DIR(item));
-    FmPath *path = fm_path_new_relative(fm_path_get_apps_menu(), mpath + 13); // skip "/Applications"
-    FmFileInfo *fi = fm_file_info_new_from_menu_cache_item(path, item);
-
-    g_free(mpath);
-    fm_path_unref(path);
+    // FmFileInfo de la entrada (se arma acá si nunca se arrastró)
+    FmFileInfo *fi = app_entry_file_info(entry);
 
     if (!fi) {
         g_warning(_("Could not create FmFileInfo for the menu item"));
         return;
     }
 
-    // Crear lista de archivos (solo este archivo)
+    // Crear lista de archivos (solo este archivo); la lista toma su propia referencia
     FmFileInfoList *files = fm_file_info_list_new();
     fm_file_info_list_push_tail(files, fi);
 
-    // Mostrar diálogo de propiedades (igual que LXPanel)
-    fm_show_file_properties(NULL, files);
+    // Mostrar diálogo de propiedades (igual que LXPanel)
+    fm_show_file_properties(NULL, files);
+
+    // Liberar recursos; fi sigue en la entrada
+    fm_file_info_list_unref(files);
+}
+/* ==== DUEÑOS DE PAQUETES ==== */
+/* "Desinstalar" necesita saber qué paquete instaló la app. En lugar de correr
+ * dpkg -S / pacman -Qo (segundos en sistemas grandes, cada vez) se usa el
+ * índice de modern_menu_model.c, guardado en ~/.cache/modernmenu/packages.bin.
+ * Un hilo lo carga al iniciar o, si la base del gestor cambió desde que se
+ * guardó, lo vuelve a armar. Mientras no está listo (o si quedó viejo) se
+ * sigue preguntando al gestor como antes. */
+typedef struct {
+    PackageIndex *index;
+    guint generation;
+} PackageIndexResult;
+
+static struct {
+    PackageIndex *index;    // NULL mientras se arma o si no hay gestor
+    GThread *thread;
+    gint cancel;
+    guint generation;       // descarta resultados de hilos ya esperados
+    gboolean again;         // volver a armar al terminar (se desinstaló algo)
+    gint users;
+} packages;
+
+static gchar *package_index_path(void)
+{
+    return g_build_filename(g_get_user_cache_dir(), "modernmenu", "packages.bin", NULL);
+}
+
+static void package_owner_refresh(void);
+
+static gboolean package_index_ready(gpointer data)
+{
+    PackageIndexResult *result = data;
+
+    if (result->generation != packages.generation || packages.users == 0) {
+        package_index_free(result->index);
+        g_free(result);
+        return G_SOURCE_REMOVE;
+    }
+
+    g_thread_join(packages.thread);
+    packages.thread = NULL;
+    package_index_free(packages.index);
+    packages.index = result->index;
+    g_free(result);
+
+    if (packages.again) {
+        packages.again = FALSE;
+        package_owner_refresh();
+    }
+    return G_SOURCE_REMOVE;
+}
+
+static gpointer package_index_thread(gpointer data)
+{
+    TRACE_SPAN("package_index_load");
+    PackageIndexResult *result = g_new0(PackageIndexResult, 1);
+    result->generation = GPOINTER_TO_UINT(data);
+
+    PackageManager manager = package_manager_detect();
+    gchar *path = package_index_path();
+    result->index = package_index_load(path, manager);
+
+    if (!result->index && manager != PACKAGE_MANAGER_NONE) {
+        GError *error = NULL;
+        result->index = package_index_build(manager, &packages.cancel, &error);
+        if (result->index && !package_index_save(result->index, path, &error)) {
+            g_warning("modernmenu: could not save package index: %s", error->message);
+            g_clear_error(&error);
+        } else if (error) {
+            g_debug("modernmenu: package index not built: %s", error->message);
+            g_clear_error(&error);
+        }
+    }
+    g_free(path);
+
+    g_idle_add(package_index_ready, result);
+    return NULL;
+}
+
+/* Carga o arma el índice en segundo plano si hace falta */
+static void package_owner_refresh(void)
+{
+    if (packages.users == 0) return;
+    if (packages.thread) {
+        packages.again = TRUE;
+        return;
+    }
+    if (packages.index && package_index_is_current(packages.index))
+        return;
+
+    g_atomic_int_set(&packages.cancel, 0);
+    packages.thread = g_thread_new("modernmenu-packages", package_index_thread,
+                                   GUINT_TO_POINTER(packages.generation));
+}
+
+/* Dueño de alguna de las rutas según el índice; FALSE si no está listo o
+ * quedó viejo (y en ese caso se pide armarlo de nuevo) */
+static gboolean package_owner_lookup(const char *const *paths, PackageInfo *info)
+{
+    if (!packages.index) return FALSE;
+    if (!package_index_is_current(packages.index)) {
+        package_owner_refresh();
+        return FALSE;
+    }
+
+    for (int i = 0; paths[i]; i++)
+        if (package_index_owner(packages.index, paths[i], info))
+            return TRUE;
+    return FALSE;
+}
+
+static void package_owner_ref(void)
+{
+    packages.users++;
+}
+
+/* Con el último usuario se corta el armado y se espera al hilo */
+static void package_owner_unref(void)
+{
+    if (packages.users == 0 || --packages.users > 0) return;
+
+    if (packages.thread) {
+        g_atomic_int_set(&packages.cancel, 1);
+        g_thread_join(packages.thread);
+        packages.thread = NULL;
+    }
+    packages.generation++;
+    packages.again = FALSE;
+    package_index_free(packages.index);
+    packages.index = NULL;
+}
+
+/* Nombre del paquete en la salida de dpkg -S / pacman -Qo, o NULL */
+static gchar *package_owner_parse(const char *pkg_manager, const char *output)
+{
+    gchar *pkg_name = NULL;
+
+    if (g_strcmp0(pkg_manager, "dpkg") == 0) {
+        gchar **parts = g_strsplit(output, ":", 2);
+        if (parts[0]) pkg_name = g_strstrip(g_strdup(parts[0]));
+        g_strfreev(parts);
+    } else if (g_strcmp0(pkg_manager, "pacman") == 0) {
+        const gchar *owned_by = g_strstr_len(output, -1, "owned by");
+        if (owned_by) {
+            owned_by += 9;
+            gchar **parts = g_strsplit(owned_by, " ", 2);
+            if (parts[0]) pkg_name = g_strstrip(g_strdup(parts[0]));
+            g_strfreev(parts);
+        }
+    }
+    return pkg_name;
+}
+/* ==== FIN DUEÑOS DE PAQUETES ==== */
+
+/* ==== DESINSTALAR ==== */
+/* Todo el recorrido es asíncrono: dueño (índice o consulta al gestor),
+ * confirmación y desinstalación, con una ventana de progreso que muestra la
+ * última línea que imprime el gestor. Hay a lo sumo una en curso: dos a la
+ * vez chocarían con el bloqueo del gestor. */
+typedef struct {
+    const char *pkg_manager;        // "dpkg" o "pacman"
+    gchar *exec_path;
+    gchar *pkg_name;
+    gchar *version;
+    gint64 size;
+    GtkWidget *dialog;              // confirmación abierta
+    GtkWidget *window, *label, *bar;
+    guint pulse_id;
+} RemoveRequest;
+
+static RemoveRequest *remove_current;
+
+static void remove_request_free(RemoveRequest *req)
+{
+    if (remove_current == req)
+        remove_current = NULL;
+    if (req->pulse_id)
+        g_source_remove(req->pulse_id);
+    if (req->window)
+        gtk_widget_destroy(req->window);
+    g_free(req->exec_path);
+    g_free(req->pkg_name);
+    g_free(req->version);
+    g_free(req);
+}
+
+static gboolean remove_pulse(gpointer data)
+{
+    RemoveRequest *req = data;
+    gtk_progress_bar_pulse(GTK_PROGRESS_BAR(req->bar));
+    return TRUE;
+}
+
+static void remove_progress(const char *line, gpointer data)
+{
+    RemoveRequest *req = data;
+    if (*line)
+        gtk_label_set_text(GTK_LABEL(req->label), line);
+}
+
+static void remove_done(gboolean ok, const char *output, gpointer data)
+{
+    RemoveRequest *req = data;
+
+    if (ok) {
+        package_owner_refresh();  // la base del gestor cambió
+        action_notify(_("Package removed"), req->pkg_name);
+    } else if (output) {
+        show_error_dialog(_("Could not remove the package. Check permissions or authentication method."));
+    }
+    remove_request_free(req);
+}
+
+/* Ventana no modal: el panel sigue respondiendo mientras el gestor trabaja */
+static void remove_show_progress(RemoveRequest *req)
+{
+    req->window = gtk_window_new(GTK_WINDOW_TOPLEVEL);
+    gtk_window_set_title(GTK_WINDOW(req->window), _("Remove package"));
+    gtk_window_set_position(GTK_WINDOW(req->window), GTK_WIN_POS_CENTER);
+    gtk_window_set_deletable(GTK_WINDOW(req->window), FALSE);
+    gtk_container_set_border_width(GTK_CONTAINER(req->window), 12);
+
+    GtkWidget *box = gtk_vbox_new(FALSE, 8);
+    gchar *title = g_strdup_printf(_("Removing %s…"), req->pkg_name);
+    gtk_box_pack_start(GTK_BOX(box), gtk_label_new(title), FALSE, FALSE, 0);
+    g_free(title);
+
+    req->bar = gtk_progress_bar_new();
+    gtk_box_pack_start(GTK_BOX(box), req->bar, FALSE, FALSE, 0);
+
+    req->label = gtk_label_new("");
+    gtk_label_set_ellipsize(GTK_LABEL(req->label), PANGO_ELLIPSIZE_END);
+    gtk_widget_set_size_request(req->label, 360, -1);
+    gtk_box_pack_start(GTK_BOX(box), req->label, FALSE, FALSE, 0);
+
+    gtk_container_add(GTK_CONTAINER(req->window), box);
+    gtk_widget_show_all(req->window);
+    req->pulse_id = g_timeout_add(100, remove_pulse, req);
+}
+
+static gboolean program_exists(const char *name)
+{
+    gchar *path = g_find_program_in_path(name);
+    gboolean found = path != NULL;
+    g_free(path);
+    return found;
+}
+
+static void remove_run(RemoveRequest *req)
+{
+    /* Intentar eliminar con el gestor correspondiente */
+    const char *apt[] = { "apt", "remove", "-y", req->pkg_name, NULL };
+    const char *pacman[] = { "pacman", "-R", "--noconfirm", req->pkg_name, NULL };
+    const char *const *remove_argv = g_strcmp0(req->pkg_manager, "dpkg") == 0 ? apt : pacman;
+
+    const gchar *askpass = g_getenv("SUDO_ASKPASS");
+
+    const gchar *terminals[] = {"x-terminal-emulator", "lxterminal", "xterm", "mate-terminal", "konsole", "terminator", NULL};
+    const gchar *terminal_cmd = NULL;
+    for (int i = 0; terminals[i] != NULL; i++) {
+        if (program_exists(terminals[i])) {
+            terminal_cmd = terminals[i];
+            break;
+        }
+    }
+
+    const char *argv[8];
+    gchar *terminal_line = NULL;
+    int n = 0;
+    if (program_exists("pkexec")) {
+        argv[n++] = "pkexec";
+    } else if (askpass && *askpass) {
+        argv[n++] = "sudo";
+        argv[n++] = "-A";
+    } else if (terminal_cmd) {
+        // La terminal recibe una sola línea de comando
+        gchar *joined = g_strjoinv(" ", (gchar **)remove_argv);
+        terminal_line = g_strdup_printf("sudo %s", joined);
+        g_free(joined);
+        argv[n++] = terminal_cmd;
+        argv[n++] = "-e";
+        argv[n++] = terminal_line;
+    } else {
+        show_error_dialog(_("Could not find a method to request authentication (pkexec, sudo -A)."));
+        remove_request_free(req);
+        return;
+    }
+    if (!terminal_line)
+        for (int i = 0; remove_argv[i]; i++)
+            argv[n++] = remove_argv[i];
+    argv[n] = NULL;
+
+    remove_show_progress(req);
+    action_spawn(argv, FALSE, remove_progress, remove_done, req);
+    g_free(terminal_line);
+}
+
+static void on_remove_confirm_response(GtkDialog *dialog, gint response, gpointer data)
+{
+    RemoveRequest *req = data;
+    gtk_widget_destroy(GTK_WIDGET(dialog));
+    req->dialog = NULL;
+
+    if (response == GTK_RESPONSE_YES)
+        remove_run(req);
+    else
+        remove_request_free(req);
+}
+
+/* Confirmación antes de eliminar, con los datos del paquete */
+static void remove_confirm(RemoveRequest *req)
+{
+    if (!req->pkg_name || !*req->pkg_name) {
+        show_error_dialog(_("Could not determine which package this application belongs to."));
+        remove_request_free(req);
+        return;
+    }
+
+    GtkWidget *dialog = gtk_message_dialog_new(
+        NULL, 0,
+        GTK_MESSAGE_WARNING, GTK_BUTTONS_YES_NO,
+        _("Do you want to remove the package associated with this application?"));
+    gtk_window_set_title(GTK_WINDOW(dialog), _("Confirm removal"));
+
+    gchar *size_text = req->size >= 0 ? g_format_size(req->size) : g_strdup(_("unknown"));
+    gtk_message_dialog_format_secondary_text(GTK_MESSAGE_DIALOG(dialog),
+                                             _("Package: %s\nVersion: %s\nInstalled size: %s"),
+                                             req->pkg_name, req->version ? req->version : _("unknown"),
+                                             size_text);
+    g_free(size_text);
+
+    req->dialog = dialog;
+    g_signal_connect(dialog, "response", G_CALLBACK(on_remove_confirm_response), req);
+    gtk_widget_show(dialog);
+}
 
-    // Liberar recursos
-    fm_file_info_list_unref(files);
-    // NOTA: fi se libera automáticamente al liberar la lista
+static void remove_owner_query_done(gboolean ok, const char *output, gpointer data)
+{
+    RemoveRequest *req = data;
+    if (!output) {  // plugin destruido
+        remove_request_free(req);
+        return;
+    }
+    if (ok)
+        req->pkg_name = package_owner_parse(req->pkg_manager, output);
+    remove_confirm(req);
 }
+
 static void on_remove_package(GtkWidget *widget, gpointer user_data)
 {
+    TRACE_SPAN("on_remove_package");
     (void)user_data; // No usamos user_data ahora
 
+    // Ya hay una en curso: traer al frente su confirmación o su progreso
+    if (remove_current) {
+        GtkWidget *shown = remove_current->dialog ? remove_current->dialog : remove_current->window;
+        if (shown)
+            gtk_window_present(GTK_WINDOW(shown));
+        return;
+    }
+
     // Obtener la ruta desde el widget
     const char *desktop_file = g_object_get_data(G_OBJECT(widget), "desktop-path");
     if (!desktop_file) {
@@ -1103,125 +4315,51 @@ static void on_remove_package(GtkWidget *widget, gpointer user_data)
         gchar *found = g_find_program_in_path(exec);
         exec_path = found ? found : g_strdup(exec);
     }
+    g_free(exec);
 
     /* Detectar gestor de paquetes */
     const gchar *pkg_manager = NULL;
-    if (g_find_program_in_path("pacman")) {
+    if (program_exists("pacman")) {
         pkg_manager = "pacman";
-    } else if (g_find_program_in_path("dpkg")) {
+    } else if (program_exists("dpkg")) {
         pkg_manager = "dpkg";
     }
 
     if (!pkg_manager) {
         show_error_dialog(_("No compatible package manager detected (dpkg or pacman)."));
-        g_free(exec);
-        g_free(exec_path);
-        return;
-    }
-
-    /* Confirmación antes de eliminar */
-    GtkWidget *dialog = gtk_message_dialog_new(
-        NULL, GTK_DIALOG_MODAL,
-        GTK_MESSAGE_WARNING, GTK_BUTTONS_YES_NO,
-        _("Do you want to remove the package associated with this application?"));
-    gtk_window_set_title(GTK_WINDOW(dialog), _("Confirm removal"));
-    gint response = gtk_dialog_run(GTK_DIALOG(dialog));
-    gtk_widget_destroy(dialog);
-    if (response != GTK_RESPONSE_YES) {
-        g_free(exec);
-        g_free(exec_path);
-        return;
-    }
-
-    /* Determinar a qué paquete pertenece */
-    gchar *cmd_query = NULL;
-    if (g_strcmp0(pkg_manager, "pacman") == 0)
-        cmd_query = g_strdup_printf("/bin/sh -c \"LANG=C pacman -Qo '%s' 2>&1\"", exec_path);
-    else
-        cmd_query = g_strdup_printf("/bin/sh -c \"LANG=C dpkg -S '%s' 2>&1\"", exec_path);
-
-    gchar *output = NULL;
-    gint status = -1;
-    g_spawn_command_line_sync(cmd_query, &output, NULL, &status, NULL);
-    g_free(cmd_query);
-
-    /* Extraer nombre del paquete */
-    gchar *pkg_name = NULL;
-    if (output && status == 0) {
-        if (g_strcmp0(pkg_manager, "dpkg") == 0) {
-            gchar **parts = g_strsplit(output, ":", 2);
-            if (parts[0]) pkg_name = g_strstrip(g_strdup(parts[0]));
-            g_strfreev(parts);
-        } else if (g_strcmp0(pkg_manager, "pacman") == 0) {
-            gchar *owned_by = g_strstr_len(output, -1, "owned by");
-            if (owned_by) {
-                owned_by += 9;
-                gchar **parts = g_strsplit(owned_by, " ", 2);
-                if (parts[0]) pkg_name = g_strstrip(g_strdup(parts[0]));
-                g_strfreev(parts);
-            }
-        }
-    }
-    g_free(output);
-
-    if (!pkg_name || !*pkg_name) {
-        show_error_dialog(_("Could not determine which package this application belongs to."));
-        g_free(exec);
         g_free(exec_path);
-        g_free(pkg_name);
         return;
     }
 
-    /* Intentar eliminar con el gestor correspondiente */
-    gchar *remove_cmd = NULL;
-    if (g_strcmp0(pkg_manager, "dpkg") == 0)
-        remove_cmd = g_strdup_printf("apt remove -y %s", pkg_name);
-    else
-        remove_cmd = g_strdup_printf("pacman -R --noconfirm %s", pkg_name);
-
-    const gboolean has_pkexec = g_find_program_in_path("pkexec") != NULL;
-    const gchar *askpass = g_getenv("SUDO_ASKPASS");
+    RemoveRequest *req = g_new0(RemoveRequest, 1);
+    remove_current = req;
+    req->pkg_manager = pkg_manager;
+    req->exec_path = exec_path;
+    req->size = -1;
 
-    const gchar *terminals[] = {"x-terminal-emulator", "lxterminal", "xterm", "mate-terminal", "konsole", "terminator", NULL};
-    const gchar *terminal_cmd = NULL;
-    for (int i = 0; terminals[i] != NULL; i++) {
-        if (g_find_program_in_path(terminals[i]) != NULL) {
-            terminal_cmd = terminals[i];
-            break;
-        }
-    }
+    /* Determinar a qué paquete pertenece: el .desktop, el ejecutable o el
+     * destino del enlace, en el índice local; si no, preguntar al gestor */
+    gchar *real_path = realpath(exec_path, NULL);
+    const char *owner_paths[] = { desktop_file, exec_path, real_path, NULL };
+    PackageInfo info = { NULL, NULL, -1 };
+    gboolean found = package_owner_lookup(owner_paths, &info);
+    free(real_path);
 
-    gchar *cmd_remove = NULL;
-    if (has_pkexec) {
-        cmd_remove = g_strdup_printf("/bin/sh -c \"pkexec %s 2>&1\"", remove_cmd);
-    } else if (askpass && *askpass) {
-        cmd_remove = g_strdup_printf("/bin/sh -c \"sudo -A %s 2>&1\"", remove_cmd);
-    } else if (terminal_cmd) {
-        cmd_remove = g_strdup_printf("%s -e 'sudo %s'", terminal_cmd, remove_cmd);
+    if (found) {
+        req->pkg_name = g_strdup(info.name);
+        req->version = g_strdup(info.version);
+        req->size = info.size;
+        remove_confirm(req);
+    } else if (g_strcmp0(pkg_manager, "pacman") == 0) {
+        const char *argv[] = { "pacman", "-Qo", exec_path, NULL };
+        action_spawn(argv, TRUE, NULL, remove_owner_query_done, req);
     } else {
-        show_error_dialog(_("Could not find a method to request authentication (pkexec, sudo -A)."));
-        g_free(remove_cmd);
-        g_free(exec);
-        g_free(exec_path);
-        g_free(pkg_name);
-        return;
-    }
-
-    gchar *output_remove = NULL;
-    gint status_remove = -1;
-    g_spawn_command_line_sync(cmd_remove, &output_remove, NULL, &status_remove, NULL);
-
-    if (status_remove != 0) {
-        show_error_dialog(_("Could not remove the package. Check permissions or authentication method."));
+        const char *argv[] = { "dpkg", "-S", exec_path, NULL };
+        action_spawn(argv, TRUE, NULL, remove_owner_query_done, req);
     }
-
-    g_free(output_remove);
-    g_free(cmd_remove);
-    g_free(remove_cmd);
-    g_free(exec);
-    g_free(exec_path);
-    g_free(pkg_name);
 }
+/* ==== FIN DESINSTALAR ==== */
+
 static void on_category_selected(GtkTreeSelection *sel, gpointer user_data)
 {
     ModernMenu *m = user_data;
@@ -1231,9 +4369,10 @@ static void on_category_selected(GtkTreeSelection *sel, gpointer user_data)
     GtkTreeModel *model;
 
     if (gtk_tree_selection_get_selected(sel, &model, &iter)) {
-        MenuCacheDir *dir = NULL;
-        gtk_tree_model_get(model, &iter, COL_DIR_PTR, &dir, -1);
-        populate_apps_for_dir(m, dir);
+        gchar *id = NULL;
+        gtk_tree_model_get(model, &iter, COL_DIR_ID, &id, -1);
+        populate_apps_for_dir(m, catalog_lookup_category(m->catalog, id));
+        g_free(id);
     }
 
     // Si no estamos en modo "Favoritos", desactivamos el toggle
@@ -1242,6 +4381,16 @@ static void on_category_selected(GtkTreeSelection *sel, gpointer user_data)
 }
 
 /* Cierre automático al perder el foco */
+/* Primer dibujado de la ventana tras el click: cierra click-to-first-paint */
+static gboolean on_window_expose_trace(GtkWidget *widget, GdkEventExpose *event, gpointer user_data)
+{
+    (void)widget;
+    (void)event;
+    ModernMenu *m = user_data;
+    trace_metric("click-to-first-paint", &m->trace_click);
+    return FALSE;
+}
+
 static gboolean on_window_focus_out(GtkWidget *widget, GdkEventFocus *event, gpointer user_data)
 {
     (void)widget;
@@ -1294,8 +4443,9 @@ static void show_error_dialog(const gchar *message)
         message
     );
     gtk_window_set_title(GTK_WINDOW(dialog), _("Error"));
-    gtk_dialog_run(GTK_DIALOG(dialog));
-    gtk_widget_destroy(dialog);
+    // Sin gtk_dialog_run: se cierra solo al responder
+    g_signal_connect(dialog, "response", G_CALLBACK(gtk_widget_destroy), NULL);
+    gtk_widget_show(dialog);
 }
 static void unhide_app(GtkButton *button, gpointer user_data)
 {
@@ -1307,31 +4457,25 @@ static void unhide_app(GtkButton *button, gpointer user_data)
         return;
     }
 
-    // Buscar en la lista
-    for (GSList *l = m->hidden_apps; l; l = l->next) {
-        if (g_strcmp0((const char *)l->data, app_id) == 0) {
-            g_free(l->data);
+    if (g_hash_table_remove(m->hidden_apps, app_id)) {
+        save_hidden_apps(m);
+        category_pages_clear(m);
 
-            // Remover de la lista
-            m->hidden_apps = g_slist_delete_link(m->hidden_apps, l);
-            save_hidden_apps(m);
-
-            // Eliminar visualmente la fila del diálogo
-            GtkWidget *hbox = gtk_widget_get_parent(GTK_WIDGET(button));
-            if (hbox) {
-                gtk_widget_destroy(hbox);
-            }
-            g_print(_("unhide_app: Completed successfully\n"));
-            break;
+        // Eliminar visualmente la fila del diálogo
+        GtkWidget *hbox = gtk_widget_get_parent(GTK_WIDGET(button));
+        if (hbox) {
+            gtk_widget_destroy(hbox);
         }
+        g_print(_("unhide_app: Completed successfully\n"));
     }
 }
 /* Callback para abrir el diálogo de apps ocultas desde la configuración */
 static void on_manage_hidden_button_clicked(GtkButton *button, gpointer user_data)
 {
     ModernMenu *m = (ModernMenu *)user_data;
+    modernmenu_load_user_data(m);
 
-    if (!m->hidden_apps) {
+    if (g_hash_table_size(m->hidden_apps) == 0) {
         GtkWidget *dialog = gtk_message_dialog_new(NULL,
                                                    GTK_DIALOG_MODAL,
                                                    GTK_MESSAGE_INFO,
@@ -1362,19 +4506,10 @@ static void on_manage_hidden_button_clicked(GtkButton *button, gpointer user_dat
     gtk_scrolled_window_add_with_viewport(GTK_SCROLLED_WINDOW(scroll), vbox);
 
     // Buscar info de cada app oculta
-    for (GSList *l = m->hidden_apps; l; l = l->next) {
+    GList *hidden_ids = id_set_sorted(m->hidden_apps);
+    for (GList *l = hidden_ids; l; l = l->next) {
         const char *hidden_id = (const char *)l->data;
-
-        // Buscar el MenuCacheItem correspondiente
-        MenuCacheItem *found_item = NULL;
-        for (GSList *al = m->all_apps; al; al = al->next) {
-            MenuCacheItem *item = MENU_CACHE_ITEM(al->data);
-            const char *item_id = menu_cache_item_get_id(item);
-            if (item_id && g_strcmp0(item_id, hidden_id) == 0) {
-                found_item = item;
-                break;
-            }
-        }
+        AppEntry *found_item = lookup_app(m, hidden_id);
 
         GtkWidget *hbox = gtk_hbox_new(FALSE, 10);
         gtk_box_pack_start(GTK_BOX(vbox), hbox, FALSE, FALSE, 2);
@@ -1391,7 +4526,7 @@ static void on_manage_hidden_button_clicked(GtkButton *button, gpointer user_dat
         gtk_box_pack_start(GTK_BOX(hbox), img, FALSE, FALSE, 5);
 
         // Nombre
-        const char *name = found_item ? menu_cache_item_get_name(found_item) : hidden_id;
+        const char *name = found_item && found_item->name ? found_item->name : hidden_id;
         GtkWidget *label = gtk_label_new(name);
         gtk_misc_set_alignment(GTK_MISC(label), 0.0, 0.5);
         gtk_box_pack_start(GTK_BOX(hbox), label, TRUE, TRUE, 5);
@@ -1402,61 +4537,39 @@ static void on_manage_hidden_button_clicked(GtkButton *button, gpointer user_dat
         g_signal_connect(btn, "clicked", G_CALLBACK(unhide_app), m);
         gtk_box_pack_start(GTK_BOX(hbox), btn, FALSE, FALSE, 5);
     }
+    g_list_free(hidden_ids);
 
     gtk_widget_show_all(dialog);
+    flight_record('I', "gtk_dialog_run: hidden applications");
     gtk_dialog_run(GTK_DIALOG(dialog));  // <-- ESTA LÍNEA FALTABA
     gtk_widget_destroy(dialog);
 
-    // Refrescar la vista si el menú está abierto
-    if (m->window_shown) {
-        if (m->current_dir) {
-            populate_apps_for_dir(m, m->current_dir);
-        } else {
-            show_favorites_category(NULL, m);
-        }
-    }
+    // Refrescar la vista (si el menú está cerrado, al abrirlo)
+    view_invalidate(m);
 }
 
 /* ===== 5.6 FUNCIONES DEL PLUGIN (CORE) ===== */
-
-GtkWidget *modernmenu_constructor(LXPanel *panel, config_setting_t *settings)
+/* ==== CARGA DIFERIDA ==== */
+/* El constructor sólo arma el botón del panel y pide el árbol a menu-cache
+ * sin bloquear. Favoritos y ocultos se leen en idle, el catálogo se arma con
+ * el primer aviso de menu-cache, y la ventana se construye en idle de baja
+ * prioridad cuando el catálogo está listo (o en el primer click, lo que
+ * ocurra antes). Si se abre el menú antes de tener el catálogo, muestra
+ * "Loading applications…" y se completa sola cuando llega; si menu-cache no
+ * encontró applications.menu no llega nunca y se muestra "No applications". */
+
+/* Lee favoritos y ocultos una sola vez */
+static void modernmenu_load_user_data(ModernMenu *m)
 {
-    /* ==== CREACIÓN Y CONFIGURACIÓN INICIAL ==== */
-    #ifdef ENABLE_NLS
-    setlocale(LC_ALL, "");
-    bindtextdomain("modernmenu", "/usr/share/locale");
-    bind_textdomain_codeset("modernmenu", "UTF-8");
-    textdomain("modernmenu");
-    #endif
-
-    ModernMenu *m = g_new0(ModernMenu, 1);
-    m->panel = panel;
-    m->window_shown = FALSE;
-    m->current_dir = NULL;
-    m->settings = settings;
-    m->ds = fm_dnd_src_new(NULL);
-
-    // Color del hover
-    GdkColor tint_color = {0, 0, 36 * 0xffff / 0xff, 96 * 0xffff / 0xff};
-
-    /* ==== LECTURA DEL ICONO CONFIGURADO ==== */
-    const char *icon_str = NULL;
-    if (settings && config_setting_lookup_string(settings, "icon", &icon_str) && icon_str && *icon_str) {
-        m->icon_path = g_strdup(icon_str);
-    } else {
-        m->icon_path = g_strdup("start-here");
-    }
-
-    /* ==== CREAR BOTÓN DEL MENÚ (SIMPLIFICADO) ==== */
-    // lxpanel_button_new_for_icon devuelve un GtkEventBox
-    m->plugin_button = lxpanel_button_new_for_icon(m->panel, m->icon_path, &tint_color, NULL);
-
-    // Conectar señal de button-press-event (porque es un EventBox)
-    g_signal_connect(m->plugin_button, "button-press-event",
-                     G_CALLBACK(on_plugin_button_press), m);
-
-    gtk_widget_set_tooltip_text(m->plugin_button, _("Applications Menu"));
+    if (m->user_data_loaded) return;
+    m->user_data_loaded = TRUE;
+    load_favorites(m);
+    load_hidden_apps(m);
+}
 
+static void build_popup_window(ModernMenu *m)
+{
+    TRACE_SPAN("build_popup_window");
     /* ==== CREAR LA VENTANA POPUP DEL MENÚ ==== */
     m->window = gtk_window_new(GTK_WINDOW_TOPLEVEL);
     gtk_window_set_decorated(GTK_WINDOW(m->window), FALSE);
@@ -1475,12 +4588,6 @@ GtkWidget *modernmenu_constructor(LXPanel *panel, config_setting_t *settings)
     GtkWidget *content = gtk_hbox_new(FALSE, 8);
     gtk_box_pack_start(GTK_BOX(main_box), content, TRUE, TRUE, 0);
 
-    /* ==== CARGA DE FAVORITOS ==== */
-    load_favorites(m);
-
-    /* ==== CARGA DE OCULTOS ==== */
-    load_hidden_apps(m);
-
     /* ==== PANEL DE CATEGORÍAS ==== */
     GtkWidget *cat_scroll = gtk_scrolled_window_new(NULL, NULL);
     gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(cat_scroll),
@@ -1502,7 +4609,7 @@ GtkWidget *modernmenu_constructor(LXPanel *panel, config_setting_t *settings)
     gtk_widget_show(btn_fav);
 
     /* ==== MODELO Y VISTA DE CATEGORÍAS ==== */
-    m->cat_store = gtk_list_store_new(N_COLS, G_TYPE_STRING, G_TYPE_POINTER);
+    m->cat_store = gtk_list_store_new(N_COLS, G_TYPE_STRING, G_TYPE_STRING);
     m->categories = gtk_tree_view_new_with_model(GTK_TREE_MODEL(m->cat_store));
     gtk_tree_view_set_headers_visible(GTK_TREE_VIEW(m->categories), FALSE);
 
@@ -1514,6 +4621,7 @@ GtkWidget *modernmenu_constructor(LXPanel *panel, config_setting_t *settings)
     GtkTreeSelection *sel = gtk_tree_view_get_selection(GTK_TREE_VIEW(m->categories));
     gtk_tree_selection_set_mode(sel, GTK_SELECTION_SINGLE);
     g_signal_connect(sel, "changed", G_CALLBACK(on_category_selected), m);
+    g_signal_connect(m->categories, "motion-notify-event", G_CALLBACK(on_categories_motion), m);
 
     gtk_box_pack_start(GTK_BOX(cat_box), m->categories, TRUE, TRUE, 0);
     gtk_widget_show(m->categories);
@@ -1521,13 +4629,30 @@ GtkWidget *modernmenu_constructor(LXPanel *panel, config_setting_t *settings)
     gtk_box_pack_start(GTK_BOX(content), cat_scroll, FALSE, FALSE, 0);
 
     /* ==== PANEL DE APLICACIONES ==== */
+    m->apps_box = gtk_vbox_new(FALSE, 4);
+    gtk_box_pack_start(GTK_BOX(content), m->apps_box, TRUE, TRUE, 0);
+
+    m->apps_message = gtk_label_new("");
+    gtk_misc_set_alignment(GTK_MISC(m->apps_message), 0.5, 0.5);
+    gtk_widget_set_no_show_all(m->apps_message, TRUE);
+    gtk_box_pack_start(GTK_BOX(m->apps_box), m->apps_message, FALSE, FALSE, 4);
+
     m->apps_scroll = gtk_scrolled_window_new(NULL, NULL);
     gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(m->apps_scroll),
                                    GTK_POLICY_NEVER, GTK_POLICY_AUTOMATIC);
+    gtk_box_pack_start(GTK_BOX(m->apps_box), m->apps_scroll, TRUE, TRUE, 0);
 
-    m->apps_box = gtk_vbox_new(FALSE, 4);
-    gtk_scrolled_window_add_with_viewport(GTK_SCROLLED_WINDOW(m->apps_scroll), m->apps_box);
-    gtk_box_pack_start(GTK_BOX(content), m->apps_scroll, TRUE, TRUE, 0);
+    m->apps_grid = gtk_layout_new(NULL, NULL);
+    gtk_widget_set_size_request(m->apps_grid, GRID_WIDTH, -1);
+    gtk_container_add(GTK_CONTAINER(m->apps_scroll), m->apps_grid);
+    g_signal_connect(gtk_layout_get_vadjustment(GTK_LAYOUT(m->apps_grid)), "value-changed",
+                     G_CALLBACK(on_apps_grid_scrolled), m);
+    g_signal_connect(m->apps_grid, "size-allocate", G_CALLBACK(on_apps_grid_size_allocate), m);
+
+    m->button_pool = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, app_button_release);
+    m->grid_buttons = g_ptr_array_new();
+    m->grid_items = g_ptr_array_new_with_free_func((GDestroyNotify)app_entry_unref);
+    m->pages = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, category_page_free);
 
     /* ==== BARRA INFERIOR: SALIR + BUSCAR ==== */
     GtkWidget *bottom_bar = gtk_hbox_new(FALSE, 6);
@@ -1548,21 +4673,160 @@ GtkWidget *modernmenu_constructor(LXPanel *panel, config_setting_t *settings)
     m->search = gtk_entry_new();
     gtk_box_pack_start(GTK_BOX(bottom_bar), m->search, TRUE, TRUE, 0);
 
-    /* ==== CARGA DE MENÚS Y DATOS ==== */
-    m->menu_cache = menu_cache_lookup_sync("applications.menu");
-    if (m->menu_cache) {
-        m->reload_notify = menu_cache_add_reload_notify(m->menu_cache,
-                                                        on_menu_cache_reload_real, m);
-        load_categories(m);
-    }
-
-    build_all_apps_list(m);
-    show_favorites_category(NULL, m);
-
     /* ==== CONEXIONES DE SEÑALES ==== */
+    m->search_pipeline = search_pipeline_new(m);
     g_signal_connect(m->search, "changed", G_CALLBACK(on_search_changed), m);
+    g_signal_connect(m->search, "activate", G_CALLBACK(on_search_activate), m);
     g_signal_connect(m->window, "key-press-event", G_CALLBACK(on_window_key_press), m);
     g_signal_connect(m->window, "focus-out-event", G_CALLBACK(on_window_focus_out), m);
+    if (trace.enabled)
+        g_signal_connect_after(m->window, "expose-event", G_CALLBACK(on_window_expose_trace), m);
+
+    g_signal_connect(m->window, "style-set", G_CALLBACK(on_window_style_set), m);
+
+    /* ==== PRIMERA VISTA ==== */
+    if (m->catalog_ready)
+        load_categories(m);
+    show_favorites_category(NULL, m);
+
+    // Mostrar los hijos y realizar una sola vez; abrir sólo mapea la ventana
+    gtk_widget_show_all(main_box);
+    gtk_widget_realize(m->window);
+}
+
+static void ensure_window(ModernMenu *m)
+{
+    if (m->window) return;
+    if (m->window_idle_id) {
+        g_source_remove(m->window_idle_id);
+        m->window_idle_id = 0;
+    }
+    modernmenu_load_user_data(m);
+    build_popup_window(m);
+}
+
+static gboolean modernmenu_build_window_idle(gpointer user_data)
+{
+    ModernMenu *m = user_data;
+    m->window_idle_id = 0;
+    ensure_window(m);
+    return G_SOURCE_REMOVE;
+}
+
+/* TRUE si menu-cache ya tiene el árbol en memoria */
+static gboolean menu_cache_is_loaded(MenuCache *cache)
+{
+    #if MENU_CACHE_CHECK_VERSION(0,4,0)
+    MenuCacheDir *root = menu_cache_dup_root_dir(cache);
+    if (root) menu_cache_item_unref(MENU_CACHE_ITEM(root));
+    #else
+    MenuCacheDir *root = menu_cache_get_root_dir(cache);
+    #endif
+    return root != NULL;
+}
+
+static gboolean modernmenu_idle_init(gpointer user_data)
+{
+    ModernMenu *m = user_data;
+    m->init_idle_id = 0;
+
+    modernmenu_load_user_data(m);
+    package_owner_refresh();
+
+    // Si otro plugin ya cargó el árbol, no va a llegar ningún aviso
+    if (!m->catalog_live && m->menu_cache && menu_cache_is_loaded(m->menu_cache)) {
+        reload_apply(m);
+        return G_SOURCE_REMOVE;
+    }
+
+    // Mientras menu-cached arranca, usar la copia de la sesión anterior
+    if (!m->catalog_ready && catalog_snapshot_load(m)) {
+        m->catalog_ready = TRUE;
+        m->window_idle_id = g_idle_add_full(G_PRIORITY_LOW, modernmenu_build_window_idle, m, NULL);
+    }
+    return G_SOURCE_REMOVE;
+}
+
+
+GtkWidget *modernmenu_constructor(LXPanel *panel, config_setting_t *settings)
+{
+    /* ==== CREACIÓN Y CONFIGURACIÓN INICIAL ==== */
+    #ifdef ENABLE_NLS
+    setlocale(LC_ALL, "");
+    bindtextdomain("modernmenu", "/usr/share/locale");
+    bind_textdomain_codeset("modernmenu", "UTF-8");
+    textdomain("modernmenu");
+    #endif
+
+    trace_init(settings);
+    watchdog_ref(settings);
+    TRACE_SPAN("modernmenu_constructor");
+
+    ModernMenu *m = g_new0(ModernMenu, 1);
+    m->panel = panel;
+    m->window_shown = FALSE;
+    m->current_dir = NULL;
+    m->settings = settings;
+    m->ds = fm_dnd_src_new(NULL);
+    g_signal_connect(m->ds, "data-get", G_CALLBACK(on_app_drag_data_get), m);
+    icon_cache_ref();
+    persist_ref();
+    frecency_ref();
+    package_owner_ref();
+    actions_ref();
+    desktop_ref();
+    prefetch_ref();
+
+    // Color del hover
+    GdkColor tint_color = {0, 0, 36 * 0xffff / 0xff, 96 * 0xffff / 0xff};
+
+    /* ==== LECTURA DEL ICONO CONFIGURADO ==== */
+    const char *icon_str = NULL;
+    if (settings && config_setting_lookup_string(settings, "icon", &icon_str) && icon_str && *icon_str) {
+        m->icon_path = g_strdup(icon_str);
+    } else {
+        m->icon_path = g_strdup("start-here");
+    }
+
+    /* ==== PRECARGA EN REPOSO (OPCIONAL) ==== */
+    int preload_enabled = 0;
+    m->preload_apps = PRELOAD_DEFAULT_APPS;
+    m->preload_budget_mb = PRELOAD_DEFAULT_BUDGET_MB;
+    if (settings) {
+        config_setting_lookup_int(settings, "preload", &preload_enabled);
+        config_setting_lookup_int(settings, "preload_apps", &m->preload_apps);
+        config_setting_lookup_int(settings, "preload_budget_mb", &m->preload_budget_mb);
+    }
+    m->preload = preload_enabled != 0;
+    preload_update(m);
+
+    /* ==== CACHÉ DE PÁGINAS DE CATEGORÍAS ==== */
+    int page_cache_kb = PAGE_CACHE_DEFAULT_KB;
+    if (settings)
+        config_setting_lookup_int(settings, "page_cache_kb", &page_cache_kb);
+    m->page_cache_limit = (gsize)MAX(page_cache_kb, 0) * 1024;
+
+    /* ==== CREAR BOTÓN DEL MENÚ (SIMPLIFICADO) ==== */
+    // lxpanel_button_new_for_icon devuelve un GtkEventBox
+    m->plugin_button = lxpanel_button_new_for_icon(m->panel, m->icon_path, &tint_color, NULL);
+
+    g_signal_connect(m->plugin_button, "size-allocate", G_CALLBACK(on_plugin_button_size_allocate), m);
+
+    // Conectar señal de button-press-event (porque es un EventBox)
+    g_signal_connect(m->plugin_button, "button-press-event",
+                     G_CALLBACK(on_plugin_button_press), m);
+
+    gtk_widget_set_tooltip_text(m->plugin_button, _("Applications Menu"));
+
+    /* ==== CARGA DE MENÚS Y DATOS (DIFERIDA) ==== */
+    // El árbol llega por el aviso de recarga; la ventana se arma después
+    m->menu_cache = menu_cache_lookup("applications.menu");
+    if (m->menu_cache)
+        m->reload_notify = menu_cache_add_reload_notify(m->menu_cache,
+                                                        on_menu_cache_reload_real, m);
+    else
+        g_warning("modernmenu: could not open applications.menu");
+    m->init_idle_id = g_idle_add(modernmenu_idle_init, m);
 
     /* ==== FINALIZACIÓN ==== */
     lxpanel_plugin_set_data(m->plugin_button, m, modern_menu_destructor);
@@ -1573,39 +4837,76 @@ static void modern_menu_destructor(gpointer user_data)
     ModernMenu *m = (ModernMenu *)user_data;
     if (!m) return;
 
+    trace_flush();
+    watchdog_unref();
+
     /* En el destructor del plugin, agrega: */
+    if (m->drag_button)
+        g_object_remove_weak_pointer(G_OBJECT(m->drag_button), (gpointer *)&m->drag_button);
     if (m->ds) {
         g_object_unref(m->ds);
     }
 
+    search_pipeline_destroy(m->search_pipeline);
+
     if (m->reload_notify && m->menu_cache)
         menu_cache_remove_reload_notify(m->menu_cache, m->reload_notify);
+    if (m->reload_id)
+        g_source_remove(m->reload_id);
+    if (m->init_idle_id)
+        g_source_remove(m->init_idle_id);
+    if (m->window_idle_id)
+        g_source_remove(m->window_idle_id);
+    m->preload = FALSE;
+    preload_update(m);
 
     if (m->menu_cache)
         menu_cache_unref(m->menu_cache);
 
     if (m->cat_store)
         g_object_unref(m->cat_store);
+    g_free(m->current_dir_id);
 
-    if (m->all_apps) {
-        g_slist_free_full(m->all_apps, (GDestroyNotify)menu_cache_item_unref);
-    }
+    catalog_snapshot_flush(m);
+    catalog_free(m->catalog);
+    search_index_unref(m->search_index);
 
     if (m->hidden_apps) {
-        g_slist_free_full(m->hidden_apps, g_free);
+        g_hash_table_destroy(m->hidden_apps);
         m->hidden_apps = NULL;
     }
 
     if (m->favorites) {
-        g_slist_free_full(m->favorites, g_free);
+        g_hash_table_destroy(m->favorites);
     }
 
     g_free(m->favorites_path);
     g_free(m->icon_path);
 
+    if (m->page_prefetch_id)
+        g_source_remove(m->page_prefetch_id);
+    g_free(m->page_hover_id);
+    app_button_pool_clear(m);
+    if (m->pages)
+        g_hash_table_destroy(m->pages);
+    if (m->button_pool)
+        g_hash_table_destroy(m->button_pool);
+    if (m->grid_buttons)
+        g_ptr_array_free(m->grid_buttons, TRUE);
+    if (m->grid_items)
+        g_ptr_array_free(m->grid_items, TRUE);
+
     if (m->window)
         gtk_widget_destroy(m->window);
 
+    icon_cache_unref();
+    persist_unref();
+    frecency_unref();
+    package_owner_unref();
+    actions_unref();
+    desktop_unref();
+    prefetch_unref();
+
     g_free(m);
 }
 static GtkWidget *modernmenu_config(LXPanel *panel, GtkWidget *p)
@@ -1616,6 +4917,8 @@ static GtkWidget *modernmenu_config(LXPanel *panel, GtkWidget *p)
     GtkWidget *dlg = lxpanel_generic_config_dlg(_("Modern Menu"), panel,
                                                 modernmenu_apply_config, p,
                                                 _("Icon"), &m->icon_path, CONF_TYPE_FILE_ENTRY,
+                                                _("Preload frequently used applications when idle"),
+                                                &m->preload, CONF_TYPE_BOOL,
                                                 NULL);
 
     // Agregar un botón personalizado para gestionar apps ocultas
@@ -1650,6 +4953,8 @@ static gboolean modernmenu_apply_config(gpointer user_data)
 
     // Guardar ruta del icono en la configuración
     config_group_set_string(m->settings, "icon", m->icon_path);
+    config_group_set_int(m->settings, "preload", m->preload);
+    preload_update(m);
 
     // Actualizar el ícono (el EventBox se actualiza automáticamente)
     if (m->icon_path && m->plugin_button) {
@@ -1658,13 +4963,114 @@ static gboolean modernmenu_apply_config(gpointer user_data)
 
     return FALSE;
 }
+/* Vuelve a mostrar la vista actual con el catálogo nuevo, sin volver arriba */
+static void reload_refresh_view(ModernMenu *m, GHashTable *touched)
+{
+    const gchar *text = gtk_entry_get_text(GTK_ENTRY(m->search));
+    if (text && *text) {
+        search_dispatch(m);
+        return;
+    }
+
+    if (m->current_dir_id && !m->current_dir) {
+        // La categoría abierta ya no existe
+        show_favorites_category(NULL, m);
+        return;
+    }
+
+    GPtrArray *items;
+    const char *empty_msg;
+
+    if (m->current_dir) {
+        category_page_show(m, category_page_get(m, m->current_dir), FALSE);
+        return;
+    } else {
+        // En favoritos sólo importa si cambió alguno de ellos
+        gboolean affected = FALSE;
+        GHashTableIter it;
+        gpointer id;
+        g_hash_table_iter_init(&it, touched);
+        while (!affected && g_hash_table_iter_next(&it, &id, NULL))
+            affected = is_favorite(m, id);
+        if (!affected) return;
+
+        items = collect_favorite_apps(m);
+        empty_msg = g_hash_table_size(m->favorites) ? _("No favorite applications visible")
+                                                    : _("There's no favorite applications");
+    }
+
+    apps_grid_set(m, items, empty_msg, FALSE);
+    g_ptr_array_free(items, TRUE);
+}
+
+static gboolean reload_apply(gpointer user_data)
+{
+    TRACE_SPAN("reload_apply");
+    ModernMenu *m = user_data;
+    gboolean first = !m->catalog_ready;
+    m->reload_id = 0;
+    m->catalog_ready = TRUE;
+
+    GHashTable *touched = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    build_all_apps_list(m, touched);
+    if (g_hash_table_size(touched)) {
+        prefetch_forget();  // las apps de la caché pueden haber cambiado
+        category_pages_clear(m);
+    }
+
+    g_debug("modernmenu: catalog reload, %u apps added/changed/removed",
+            g_hash_table_size(touched));
+
+    if (!m->window) {
+        // Armar la ventana sin apuro; un click antes la arma en el momento
+        if (first && !m->window_idle_id)
+            m->window_idle_id = g_idle_add_full(G_PRIORITY_LOW, modernmenu_build_window_idle, m, NULL);
+        g_hash_table_destroy(touched);
+        return G_SOURCE_REMOVE;
+    }
+
+    if (first) {
+        // La ventana se armó antes de tener catálogo: reemplazar "Loading…"
+        const gchar *text = gtk_entry_get_text(GTK_ENTRY(m->search));
+        if (text && *text && m->window_shown)
+            search_dispatch(m);
+        else
+            view_invalidate(m);
+        g_hash_table_destroy(touched);
+        return G_SOURCE_REMOVE;
+    }
+
+    // Sólo los botones de apps tocadas quedan con datos viejos
+    GHashTableIter it;
+    gpointer id;
+    g_hash_table_iter_init(&it, touched);
+    while (g_hash_table_iter_next(&it, &id, NULL))
+        app_button_pool_forget(m, id);
+
+    // Con la ventana oculta no se arma nada que nadie va a ver
+    if (m->window_shown)
+        reload_refresh_view(m, touched);
+    else if (g_hash_table_size(touched))
+        m->view_dirty = TRUE;
+    g_hash_table_destroy(touched);
+    return G_SOURCE_REMOVE;
+}
+
 static void on_menu_cache_reload_real(MenuCache *cache, gpointer user_data)
 {
     (void)cache;
     ModernMenu *m = user_data;
     if (!m) return;
-    load_categories(m);
-    build_all_apps_list(m);
+
+    if (m->reload_id)
+        g_source_remove(m->reload_id);
+    m->reload_id = 0;
+
+    // La primera carga viva no espera; las siguientes se agrupan en una sola pasada
+    if (!m->catalog_live)
+        reload_apply(m);
+    else
+        m->reload_id = g_timeout_add(RELOAD_DEBOUNCE_MS, reload_apply, m);
 }
 
 /* ===== 6 DEFINICIÓN DEL PLUGIN ===== */
@@ -0,0 +1,2063 @@
+/*
+ * Modern Menu Plugin for LXPanel
+ * Modelo sin GTK: catálogo, favoritos/ocultas y búsqueda
+ */
+#define _GNU_SOURCE
+
+#include "modern_menu_model.h"
+
+#include <glib/gstdio.h>
+#include <string.h>
+#include <elf.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <glob.h>
+#include <link.h>
+#include <math.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* ==== CONJUNTOS DE IDS (FAVORITOS Y OCULTAS) ==== */
+GHashTable *id_set_new(void)
+{
+    return g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+}
+
+/* Agrega al conjunto los ids del archivo (si existe) */
+void id_set_load(GHashTable *set, const char *path)
+{
+    gchar *content = NULL;
+    if (!path || !g_file_get_contents(path, &content, NULL, NULL))
+        return;
+
+    gchar **lines = g_strsplit(content, "\n", -1);
+    for (int i = 0; lines[i]; i++) {
+        gchar *line = g_strstrip(lines[i]);
+        if (*line && *line != '#')
+            g_hash_table_add(set, g_strdup(line));
+    }
+    g_strfreev(lines);
+    g_free(content);
+}
+
+/* Contenido del archivo: ids ordenados (para que sea estable), con una línea
+ * de comentario opcional al principio */
+gchar *id_set_serialize(GHashTable *set, const char *header, gsize *length)
+{
+    GString *data = g_string_new("");
+    if (header)
+        g_string_append_printf(data, "# %s\n", header);
+
+    GList *ids = id_set_sorted(set);
+    for (GList *l = ids; l; l = l->next)
+        g_string_append_printf(data, "%s\n", (char *)l->data);
+    g_list_free(ids);
+
+    if (length)
+        *length = data->len;
+    return g_string_free(data, FALSE);
+}
+
+/* Reemplaza el archivo de una vez (temporal + rename); crea el directorio si
+ * falta. No toca GHashTable alguna, así que se puede llamar desde un hilo. */
+gboolean id_set_write(const char *path, const char *data, gsize length, GError **error)
+{
+    gchar *dir = g_path_get_dirname(path);
+    g_mkdir_with_parents(dir, 0700);
+    g_free(dir);
+
+    return g_file_set_contents(path, data, length, error);
+}
+
+gboolean id_set_save(GHashTable *set, const char *path, const char *header, GError **error)
+{
+    gsize length;
+    gchar *data = id_set_serialize(set, header, &length);
+    gboolean ok = id_set_write(path, data, length, error);
+    g_free(data);
+    return ok;
+}
+
+/* Ids de un conjunto ordenados. Las cadenas siguen siendo del conjunto. */
+GList *id_set_sorted(GHashTable *set)
+{
+    return set ? g_list_sort(g_hash_table_get_keys(set), (GCompareFunc)g_strcmp0) : NULL;
+}
+
+/* ==== FRECUENCIA DE USO ==== */
+/* Tabla de tamaño fijo (FRECENCY_SLOTS) mapeada con MAP_SHARED: registrar un
+ * lanzamiento escribe 16 bytes en el mapa y el kernel los lleva al disco, sin
+ * reescribir el archivo. Cada app ocupa un slot por el hash de 64 bits de su
+ * id, dentro de un grupo de FRECENCY_BUCKET slots contiguos; si el grupo está
+ * lleno se reemplaza el de menor puntaje, así la memoria queda acotada para
+ * siempre.
+ *
+ * El puntaje decae a la mitad cada FRECENCY_HALF_LIFE segundos. Para no tener
+ * que envejecer toda la tabla se guarda rank = log2(puntaje) + t / vida media
+ * (t del último lanzamiento): el puntaje a la hora now es
+ * 2^(rank - now / vida media), y sumar un lanzamiento es O(1).
+ *
+ * Las lecturas desde otros hilos (búsqueda) pueden ver un slot a medio
+ * escribir; en el peor caso una app queda un momento mal ordenada. */
+#define FRECENCY_MAGIC "MMFRECY"
+#define FRECENCY_VERSION 1
+#define FRECENCY_BYTE_ORDER 0x01020304
+#define FRECENCY_BUCKET 8
+
+typedef struct {
+    char magic[8];
+    guint32 version;
+    guint32 byte_order;
+    guint32 n_slots;
+    guint32 half_life;
+} FrecencyHeader;
+
+typedef struct {
+    guint64 hash;                   // 0 = libre
+    gdouble rank;
+} FrecencySlot;
+
+struct _FrecencyStore {
+    FrecencyHeader *header;         // inicio del mapa
+    FrecencySlot *slots;
+    gsize size;
+};
+
+static guint64 frecency_hash(const char *id)
+{
+    guint64 h = 0xcbf29ce484222325ull;  // FNV-1a
+    for (const guchar *p = (const guchar *)id; *p; p++)
+        h = (h ^ *p) * 0x100000001b3ull;
+    return h ? h : 1;
+}
+
+static gdouble frecency_time(gint64 now)
+{
+    return (gdouble)now / FRECENCY_HALF_LIFE;
+}
+
+/* Abre (o crea) la tabla. Un archivo de otro formato se reinicia vacío. */
+FrecencyStore *frecency_open(const char *path, GError **error)
+{
+    gsize size = sizeof(FrecencyHeader) + FRECENCY_SLOTS * sizeof(FrecencySlot);
+
+    gchar *dir = g_path_get_dirname(path);
+    g_mkdir_with_parents(dir, 0700);
+    g_free(dir);
+
+    int fd = g_open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0 ||
+        ((gsize)st.st_size != size && (ftruncate(fd, 0) != 0 || ftruncate(fd, size) != 0))) {
+        int saved = errno;
+        g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(saved),
+                    "%s: %s", path, g_strerror(saved));
+        if (fd >= 0) close(fd);
+        return NULL;
+    }
+
+    void *base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    int saved = errno;
+    close(fd);
+    if (base == MAP_FAILED) {
+        g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(saved),
+                    "%s: %s", path, g_strerror(saved));
+        return NULL;
+    }
+
+    FrecencyStore *f = g_new0(FrecencyStore, 1);
+    f->header = base;
+    f->slots = (FrecencySlot *)((gchar *)base + sizeof(FrecencyHeader));
+    f->size = size;
+
+    FrecencyHeader *h = f->header;
+    if (memcmp(h->magic, FRECENCY_MAGIC, sizeof(h->magic)) != 0 ||
+        h->version != FRECENCY_VERSION || h->byte_order != FRECENCY_BYTE_ORDER ||
+        h->n_slots != FRECENCY_SLOTS || h->half_life != FRECENCY_HALF_LIFE) {
+        memset(base, 0, size);
+        memcpy(h->magic, FRECENCY_MAGIC, sizeof(h->magic));
+        h->version = FRECENCY_VERSION;
+        h->byte_order = FRECENCY_BYTE_ORDER;
+        h->n_slots = FRECENCY_SLOTS;
+        h->half_life = FRECENCY_HALF_LIFE;
+    }
+    return f;
+}
+
+void frecency_close(FrecencyStore *f)
+{
+    if (!f) return;
+    msync(f->header, f->size, MS_ASYNC);
+    munmap(f->header, f->size);
+    g_free(f);
+}
+
+static FrecencySlot *frecency_bucket(FrecencyStore *f, guint64 hash)
+{
+    return &f->slots[hash & (FRECENCY_SLOTS - 1) & ~(guint64)(FRECENCY_BUCKET - 1)];
+}
+
+static FrecencySlot *frecency_find(FrecencyStore *f, guint64 hash)
+{
+    FrecencySlot *bucket = frecency_bucket(f, hash);
+    for (guint k = 0; k < FRECENCY_BUCKET; k++)
+        if (bucket[k].hash == hash)
+            return &bucket[k];
+    return NULL;
+}
+
+/* Suma un lanzamiento de id a la hora now (segundos). Escribe el slot sin
+ * sincronizar: la búsqueda lo lee a la vez desde su hilo y puede ver hash y
+ * rank viejos, nuevos o mezclados (un double a medio escribir en i386). Se
+ * acepta porque sólo afecta el bono de una app y frecency_boost lo acota
+ * (y descarta NaN); ningún puntero sale de la tabla. */
+void frecency_record(FrecencyStore *f, const char *id, gint64 now)
+{
+    if (!f || !id) return;
+
+    guint64 hash = frecency_hash(id);
+    gdouble t = frecency_time(now);
+    FrecencySlot *slot = frecency_find(f, hash);
+
+    if (slot) {
+        // log2(2^(rank - t) + 1) + t, sin desbordar con años de uso
+        slot->rank = t + log2(1.0 + exp2(slot->rank - t));
+        return;
+    }
+
+    // Slot libre del grupo o, si no hay, el de menor puntaje
+    FrecencySlot *bucket = frecency_bucket(f, hash);
+    slot = &bucket[0];
+    for (guint k = 0; k < FRECENCY_BUCKET && slot->hash; k++)
+        if (!bucket[k].hash || bucket[k].rank < slot->rank)
+            slot = &bucket[k];
+
+    slot->rank = t;  // puntaje 1 ahora
+    slot->hash = hash;
+}
+
+/* Puntaje de id a la hora now: lanzamientos con decaimiento, 0 si no hay */
+gdouble frecency_score(FrecencyStore *f, const char *id, gint64 now)
+{
+    if (!f || !id) return 0;
+
+    FrecencySlot *slot = frecency_find(f, frecency_hash(id));
+    return slot ? exp2(slot->rank - frecency_time(now)) : 0;
+}
+
+/* ==== ENTRADAS DEL CATÁLOGO ==== */
+/* La UI no trabaja directo con MenuCacheItem sino con AppEntry: id, nombre,
+ * icono, Exec y ruta del .desktop, respaldados por el item vivo de
+ * menu-cache, por el mapa de la instantánea en disco o por un bloque propio.
+ * Así la grilla, la búsqueda y los favoritos no notan de dónde vino. Las
+ * categorías de primer nivel son CategoryEntry con sus apps directas. */
+
+/* Entrada con copia propia de las cadenas, en un solo bloque */
+AppEntry *app_entry_new(const char *id, const char *name, const char *icon,
+                        const char *exec, const char *file)
+{
+    const char *src[4] = { id, name, icon, exec };
+    gsize size = 0;
+    for (int k = 0; k < 4; k++)
+        size += src[k] ? strlen(src[k]) + 1 : 0;
+
+    gchar *block = g_malloc(size ? size : 1);
+    const gchar *dst[4] = { NULL, NULL, NULL, NULL };
+    gchar *p = block;
+    for (int k = 0; k < 4; k++) {
+        if (!src[k]) continue;
+        gsize len = strlen(src[k]) + 1;
+        memcpy(p, src[k], len);
+        dst[k] = p;
+        p += len;
+    }
+    return app_entry_new_backed(dst[0], dst[1], dst[2], dst[3], file, block, g_free, FALSE);
+}
+
+/* Entrada cuyas cadenas pertenecen a backing (se libera con la entrada) */
+AppEntry *app_entry_new_backed(const char *id, const char *name, const char *icon,
+                               const char *exec, const char *file,
+                               gpointer backing, GDestroyNotify backing_free, gboolean live)
+{
+    AppEntry *e = g_new0(AppEntry, 1);
+    e->ref_count = 1;
+    e->id = id;
+    e->name = name;
+    e->icon = icon;
+    e->exec = exec;
+    e->file = g_strdup(file);
+    e->backing = backing;
+    e->backing_free = backing_free;
+    e->live = live;
+    return e;
+}
+
+/* Pasa la entrada a otro respaldo con el mismo contenido (p. ej. de la
+ * instantánea al item vivo equivalente). Descarta file_info. */
+void app_entry_set_backing(AppEntry *e, const char *id, const char *name, const char *icon,
+                           const char *exec, gpointer backing, GDestroyNotify backing_free,
+                           gboolean live)
+{
+    if (e->backing == backing) return;
+
+    gpointer old = e->backing;
+    GDestroyNotify old_free = e->backing_free;
+
+    e->id = id;
+    e->name = name;
+    e->icon = icon;
+    e->exec = exec;
+    e->backing = backing;
+    e->backing_free = backing_free;
+    e->live = live;
+    if (old && old_free) old_free(old);
+
+    if (e->file_info && e->file_info_free)
+        e->file_info_free(e->file_info);
+    e->file_info = NULL;
+}
+
+/* TRUE si los campos que se muestran o se ejecutan son los mismos */
+gboolean app_entry_matches(AppEntry *e, const char *name, const char *icon,
+                           const char *exec, const char *file)
+{
+    return g_strcmp0(e->name, name) == 0 && g_strcmp0(e->icon, icon) == 0 &&
+           g_strcmp0(e->exec, exec) == 0 && g_strcmp0(e->file, file) == 0;
+}
+
+AppEntry *app_entry_ref(AppEntry *e)
+{
+    g_atomic_int_inc(&e->ref_count);
+    return e;
+}
+
+void app_entry_unref(AppEntry *e)
+{
+    if (!e || !g_atomic_int_dec_and_test(&e->ref_count)) return;
+    if (e->file_info && e->file_info_free) e->file_info_free(e->file_info);
+    if (e->backing && e->backing_free) e->backing_free(e->backing);
+    g_free(e->file);
+    g_free(e);
+}
+
+CategoryEntry *category_entry_new(const char *id, const char *name)
+{
+    CategoryEntry *c = g_new0(CategoryEntry, 1);
+    c->id = g_strdup(id);
+    c->name = g_strdup(name ? name : "");
+    c->apps = g_ptr_array_new_with_free_func((GDestroyNotify)app_entry_unref);
+    return c;
+}
+
+void category_entry_free(CategoryEntry *c)
+{
+    g_ptr_array_free(c->apps, TRUE);
+    g_free(c->id);
+    g_free(c->name);
+    g_free(c);
+}
+
+/* ==== CATÁLOGO ==== */
+Catalog *catalog_new(void)
+{
+    Catalog *c = g_new0(Catalog, 1);
+    c->apps = g_ptr_array_new_with_free_func((GDestroyNotify)app_entry_unref);
+    c->apps_by_id = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    c->categories = g_ptr_array_new_with_free_func((GDestroyNotify)category_entry_free);
+    c->categories_by_id = g_hash_table_new(g_str_hash, g_str_equal);
+    return c;
+}
+
+void catalog_free(Catalog *c)
+{
+    if (!c) return;
+    // Las claves de categories_by_id son de las categorías: soltar el mapa antes
+    g_hash_table_destroy(c->categories_by_id);
+    g_ptr_array_free(c->categories, TRUE);
+    g_hash_table_destroy(c->apps_by_id);
+    g_ptr_array_free(c->apps, TRUE);
+    g_free(c);
+}
+
+/* Entrada con ese id, o NULL */
+AppEntry *catalog_lookup(Catalog *c, const char *id)
+{
+    if (!c || !id) return NULL;
+    guint pos = GPOINTER_TO_UINT(g_hash_table_lookup(c->apps_by_id, id));
+    return pos ? g_ptr_array_index(c->apps, pos - 1) : NULL;
+}
+
+CategoryEntry *catalog_lookup_category(Catalog *c, const char *id)
+{
+    return c && id ? g_hash_table_lookup(c->categories_by_id, id) : NULL;
+}
+
+/* Agrega e (toma su referencia) salvo que el id ya esté, y devuelve la
+ * entrada que quedó en el catálogo, sin referencia nueva. Las apps que
+ * aparecen en varias carpetas quedan una sola vez. */
+AppEntry *catalog_add_app(Catalog *c, AppEntry *e)
+{
+    AppEntry *existing = catalog_lookup(c, e->id);
+    if (existing || !e->id) {
+        app_entry_unref(e);
+        return existing;
+    }
+    g_ptr_array_add(c->apps, e);
+    g_hash_table_insert(c->apps_by_id, g_strdup(e->id), GUINT_TO_POINTER(c->apps->len));
+    return e;
+}
+
+/* Nueva categoría al final, o NULL si el id ya estaba */
+CategoryEntry *catalog_add_category(Catalog *c, const char *id, const char *name)
+{
+    if (!id || g_hash_table_contains(c->categories_by_id, id)) return NULL;
+
+    CategoryEntry *cat = category_entry_new(id, name);
+    g_ptr_array_add(c->categories, cat);
+    g_hash_table_insert(c->categories_by_id, cat->id, cat);
+    return cat;
+}
+
+/* Agrega a touched (copias) los ids de old_catalog que ya no están en c */
+void catalog_diff_removed(Catalog *old_catalog, Catalog *c, GHashTable *touched)
+{
+    if (!old_catalog) return;
+    for (guint i = 0; i < old_catalog->apps->len; i++) {
+        AppEntry *e = g_ptr_array_index(old_catalog->apps, i);
+        if (!g_hash_table_contains(c->apps_by_id, e->id))
+            g_hash_table_add(touched, g_strdup(e->id));
+    }
+}
+
+/* Entradas de apps (sin referencia nueva) cuyo id no está en hidden */
+GPtrArray *catalog_filter_visible(GPtrArray *apps, GHashTable *hidden)
+{
+    GPtrArray *items = g_ptr_array_sized_new(apps->len);
+
+    for (guint i = 0; i < apps->len; i++) {
+        AppEntry *e = g_ptr_array_index(apps, i);
+        if (!e->id || (hidden && g_hash_table_contains(hidden, e->id)))
+            continue;
+        g_ptr_array_add(items, e);
+    }
+    return items;
+}
+
+static gint compare_catalog_pos(gconstpointer a, gconstpointer b)
+{
+    guint pa = GPOINTER_TO_UINT(*(gpointer *)a), pb = GPOINTER_TO_UINT(*(gpointer *)b);
+    return pa < pb ? -1 : pa > pb;
+}
+
+/* Entradas de los ids del conjunto que existen y no están ocultos, en orden
+ * de catálogo; cuesta O(ids), no O(apps). Para los favoritos. */
+GPtrArray *catalog_collect_ids(Catalog *c, GHashTable *ids, GHashTable *hidden)
+{
+    GPtrArray *positions = g_ptr_array_new();
+    GHashTableIter iter;
+    gpointer id;
+
+    if (!c || !ids) return positions;
+
+    g_hash_table_iter_init(&iter, ids);
+    while (g_hash_table_iter_next(&iter, &id, NULL)) {
+        gpointer pos = g_hash_table_lookup(c->apps_by_id, id);
+        if (pos && !(hidden && g_hash_table_contains(hidden, id)))
+            g_ptr_array_add(positions, pos);
+    }
+    g_ptr_array_sort(positions, compare_catalog_pos);
+
+    for (guint i = 0; i < positions->len; i++)
+        positions->pdata[i] = g_ptr_array_index(c->apps, GPOINTER_TO_UINT(positions->pdata[i]) - 1);
+    return positions;
+}
+
+/* ==== ÍNDICE DE BÚSQUEDA ==== */
+/* Índice de trigramas sobre los nombres normalizados (NFD sin marcas
+ * diacríticas y con case folding), así "calc" encuentra "Cálculo". Además de
+ * los trigramas se indexan los prefijos de 1 y 2 bytes de cada palabra para
+ * las consultas cortas. Una consulta se divide en palabras (AND): las de 3 o
+ * más bytes se buscan como subcadena, las más cortas como prefijo de palabra.
+ * Las listas de posiciones son arreglos ordenados de índices de apps. */
+struct _SearchIndex {
+    gint ref_count;         // las búsquedas en segundo plano usan una referencia
+    GPtrArray *items;       // dato del llamador por índice
+    GPtrArray *folded;      // gchar* nombre normalizado por índice
+    GPtrArray *keys;        // gchar* copia de la clave por índice (o NULL)
+    GArray *masks;          // guint64 por índice: bytes presentes en el nombre
+    GHashTable *postings;   // clave de gram -> GArray de guint32 ascendentes
+    GHashTable *by_key;     // clave del llamador -> índice + 1
+    guint n_dead;           // entradas borradas (item NULL), aún en las listas
+    GBoxedCopyFunc item_copy;
+    GDestroyNotify item_free;
+};
+
+#define GRAM_PREFIX1(a)     (0x01000000u | (guint8)(a))
+#define GRAM_PREFIX2(a, b)  (0x02000000u | ((guint8)(a) << 8) | (guint8)(b))
+#define GRAM_TRIGRAM(a, b, c) (((guint32)(guint8)(a) << 16) | ((guint8)(b) << 8) | (guint8)(c))
+
+/* Minúsculas, sin acentos ni otras marcas combinantes */
+static gchar *search_fold(const char *text)
+{
+    gchar *nfd = g_utf8_normalize(text ? text : "", -1, G_NORMALIZE_NFD);
+    if (!nfd) return g_strdup("");  // UTF-8 inválido
+
+    GString *stripped = g_string_sized_new(strlen(nfd));
+    for (const gchar *p = nfd; *p; p = g_utf8_next_char(p)) {
+        gunichar c = g_utf8_get_char(p);
+        GUnicodeType type = g_unichar_type(c);
+        if (type == G_UNICODE_NON_SPACING_MARK ||
+            type == G_UNICODE_SPACING_MARK ||
+            type == G_UNICODE_ENCLOSING_MARK)
+            continue;
+        g_string_append_unichar(stripped, c);
+    }
+
+    gchar *folded = g_utf8_casefold(stripped->str, stripped->len);
+    g_string_free(stripped, TRUE);
+    g_free(nfd);
+    return folded;
+}
+
+static gboolean search_is_word_char(const gchar *p)
+{
+    return g_unichar_isalnum(g_utf8_get_char(p));
+}
+
+/* Divide un texto normalizado en palabras (separadas por no alfanuméricos) */
+static GPtrArray *search_split_words(const gchar *folded)
+{
+    GPtrArray *words = g_ptr_array_new_with_free_func(g_free);
+    const gchar *start = NULL;
+
+    for (const gchar *p = folded; ; p = g_utf8_next_char(p)) {
+        gboolean word = *p && search_is_word_char(p);
+        if (word && !start)
+            start = p;
+        else if (!word && start) {
+            g_ptr_array_add(words, g_strndup(start, p - start));
+            start = NULL;
+        }
+        if (!*p) break;
+    }
+    return words;
+}
+
+static gboolean search_word_prefix_match(const gchar *hay, const gchar *word)
+{
+    for (const gchar *p = strstr(hay, word); p; p = strstr(p + 1, word)) {
+        if (p == hay || !search_is_word_char(g_utf8_find_prev_char(hay, p)))
+            return TRUE;
+    }
+    return FALSE;
+}
+
+/* Filtro tipo bloom de los bytes de un texto, para descartar rápido */
+static guint64 search_byte_mask(const gchar *text)
+{
+    guint64 mask = 0;
+    for (const guchar *p = (const guchar *)text; *p; p++)
+        mask |= G_GUINT64_CONSTANT(1) << (*p & 63);
+    return mask;
+}
+
+static void search_posting_add(SearchIndex *idx, guint32 gram, guint32 i)
+{
+    GArray *list = g_hash_table_lookup(idx->postings, GUINT_TO_POINTER(gram));
+    if (!list) {
+        list = g_array_new(FALSE, FALSE, sizeof(guint32));
+        g_hash_table_insert(idx->postings, GUINT_TO_POINTER(gram), list);
+    }
+    // Un mismo gram puede repetirse en el nombre; los índices llegan en orden
+    if (list->len == 0 || g_array_index(list, guint32, list->len - 1) != i)
+        g_array_append_val(list, i);
+}
+
+static void search_posting_free(gpointer data)
+{
+    g_array_free(data, TRUE);
+}
+
+SearchIndex *search_index_new(GBoxedCopyFunc item_copy, GDestroyNotify item_free)
+{
+    SearchIndex *idx = g_new0(SearchIndex, 1);
+    idx->ref_count = 1;
+    idx->items = g_ptr_array_new();
+    idx->folded = g_ptr_array_new_with_free_func(g_free);
+    idx->keys = g_ptr_array_new_with_free_func(g_free);
+    idx->masks = g_array_new(FALSE, FALSE, sizeof(guint64));
+    idx->postings = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, search_posting_free);
+    idx->by_key = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    idx->item_copy = item_copy;
+    idx->item_free = item_free;
+    return idx;
+}
+
+SearchIndex *search_index_ref(SearchIndex *idx)
+{
+    g_atomic_int_inc(&idx->ref_count);
+    return idx;
+}
+
+/* La última referencia debe soltarse en el hilo principal (libera los items) */
+void search_index_unref(SearchIndex *idx)
+{
+    if (!idx || !g_atomic_int_dec_and_test(&idx->ref_count)) return;
+    for (guint i = 0; i < idx->items->len; i++) {
+        gpointer item = g_ptr_array_index(idx->items, i);
+        if (item && idx->item_free) idx->item_free(item);
+    }
+    g_ptr_array_free(idx->items, TRUE);
+    g_ptr_array_free(idx->folded, TRUE);
+    g_ptr_array_free(idx->keys, TRUE);
+    g_array_free(idx->masks, TRUE);
+    g_hash_table_destroy(idx->postings);
+    g_hash_table_destroy(idx->by_key);
+    g_free(idx);
+}
+
+/* Copia independiente, para modificar un índice que una búsqueda sigue usando */
+SearchIndex *search_index_copy(SearchIndex *idx)
+{
+    SearchIndex *copy = search_index_new(idx->item_copy, idx->item_free);
+    GHashTableIter it;
+    gpointer key, value;
+
+    for (guint i = 0; i < idx->items->len; i++) {
+        gpointer item = g_ptr_array_index(idx->items, i);
+        g_ptr_array_add(copy->items, item && idx->item_copy ? idx->item_copy(item) : item);
+        g_ptr_array_add(copy->folded, g_strdup(g_ptr_array_index(idx->folded, i)));
+        g_ptr_array_add(copy->keys, g_strdup(g_ptr_array_index(idx->keys, i)));
+    }
+    g_array_append_vals(copy->masks, idx->masks->data, idx->masks->len);
+
+    g_hash_table_iter_init(&it, idx->postings);
+    while (g_hash_table_iter_next(&it, &key, &value)) {
+        GArray *list = value;
+        GArray *dup = g_array_sized_new(FALSE, FALSE, sizeof(guint32), list->len);
+        g_array_append_vals(dup, list->data, list->len);
+        g_hash_table_insert(copy->postings, key, dup);
+    }
+
+    g_hash_table_iter_init(&it, idx->by_key);
+    while (g_hash_table_iter_next(&it, &key, &value))
+        g_hash_table_insert(copy->by_key, g_strdup(key), value);
+
+    copy->n_dead = idx->n_dead;
+    return copy;
+}
+
+/* Item en la posición i, o NULL si esa entrada se borró */
+gpointer search_index_get_item(SearchIndex *idx, guint i)
+{
+    return g_ptr_array_index(idx->items, i);
+}
+
+/* Borra la entrada de una clave. Queda como lápida en las listas de
+ * posiciones; las consultas la saltean. */
+void search_index_remove(SearchIndex *idx, const char *key)
+{
+    guint pos = GPOINTER_TO_UINT(g_hash_table_lookup(idx->by_key, key));
+    if (!pos) return;
+
+    gpointer item = g_ptr_array_index(idx->items, pos - 1);
+    if (item && idx->item_free) idx->item_free(item);
+    g_ptr_array_index(idx->items, pos - 1) = NULL;
+    g_array_index(idx->masks, guint64, pos - 1) = 0;
+    g_hash_table_remove(idx->by_key, key);
+    idx->n_dead++;
+}
+
+/* Agrega un nombre al índice y devuelve su posición. Si la clave ya estaba,
+ * la entrada anterior se borra. key puede ser NULL. */
+guint search_index_add(SearchIndex *idx, const char *key, const char *name, gpointer item)
+{
+    guint32 i = idx->items->len;
+    gchar *folded = search_fold(name);
+    gsize len = strlen(folded);
+
+    guint64 mask = search_byte_mask(folded);
+
+    if (key) {
+        search_index_remove(idx, key);
+        g_hash_table_insert(idx->by_key, g_strdup(key), GUINT_TO_POINTER(i + 1));
+    }
+    g_ptr_array_add(idx->items, item);
+    g_ptr_array_add(idx->folded, folded);
+    g_ptr_array_add(idx->keys, g_strdup(key));
+    g_array_append_val(idx->masks, mask);
+
+    for (gsize k = 0; k + 2 < len; k++)
+        search_posting_add(idx, GRAM_TRIGRAM(folded[k], folded[k + 1], folded[k + 2]), i);
+
+    for (const gchar *p = folded; *p; p = g_utf8_next_char(p)) {
+        if (!search_is_word_char(p) || (p != folded && search_is_word_char(g_utf8_find_prev_char(folded, p))))
+            continue;
+        search_posting_add(idx, GRAM_PREFIX1(p[0]), i);
+        if (p[1])
+            search_posting_add(idx, GRAM_PREFIX2(p[0], p[1]), i);
+    }
+
+    return i;
+}
+
+static GArray *search_posting_intersect(GArray *a, GArray *b)
+{
+    GArray *out = g_array_sized_new(FALSE, FALSE, sizeof(guint32), MIN(a->len, b->len));
+    guint i = 0, j = 0;
+
+    while (i < a->len && j < b->len) {
+        guint32 x = g_array_index(a, guint32, i), y = g_array_index(b, guint32, j);
+        if (x == y) {
+            g_array_append_val(out, x);
+            i++, j++;
+        } else if (x < y) {
+            i++;
+        } else {
+            j++;
+        }
+    }
+    return out;
+}
+
+/* Candidatos para una palabra de la consulta (sin verificar) */
+static GArray *search_word_candidates(SearchIndex *idx, const gchar *word)
+{
+    gsize len = strlen(word);
+    GArray *result = NULL;
+
+    if (len < 3) {
+        guint32 gram = len == 1 ? GRAM_PREFIX1(word[0]) : GRAM_PREFIX2(word[0], word[1]);
+        GArray *list = g_hash_table_lookup(idx->postings, GUINT_TO_POINTER(gram));
+        result = g_array_sized_new(FALSE, FALSE, sizeof(guint32), list ? list->len : 0);
+        if (list)
+            g_array_append_vals(result, list->data, list->len);
+        return result;
+    }
+
+    for (gsize k = 0; k + 2 < len; k++) {
+        GArray *list = g_hash_table_lookup(idx->postings,
+                                           GUINT_TO_POINTER(GRAM_TRIGRAM(word[k], word[k + 1], word[k + 2])));
+        if (!list) {
+            if (result) g_array_free(result, TRUE);
+            return g_array_new(FALSE, FALSE, sizeof(guint32));
+        }
+        if (!result) {
+            result = g_array_sized_new(FALSE, FALSE, sizeof(guint32), list->len);
+            g_array_append_vals(result, list->data, list->len);
+        } else {
+            GArray *next = search_posting_intersect(result, list);
+            g_array_free(result, TRUE);
+            result = next;
+        }
+        if (result->len == 0) break;
+    }
+    return result;
+}
+
+/* Índices (ascendentes) de los nombres que contienen todas las palabras */
+GArray *search_index_query(SearchIndex *idx, const char *query)
+{
+    gchar *folded_query = search_fold(query);
+    GPtrArray *words = search_split_words(folded_query);
+    GArray *result = NULL;
+    g_free(folded_query);
+
+    if (words->len == 0) {
+        result = g_array_sized_new(FALSE, FALSE, sizeof(guint32), idx->items->len);
+        for (guint32 i = 0; i < idx->items->len; i++)
+            if (g_ptr_array_index(idx->items, i))
+                g_array_append_val(result, i);
+        g_ptr_array_free(words, TRUE);
+        return result;
+    }
+
+    for (guint w = 0; w < words->len; w++) {
+        GArray *cand = search_word_candidates(idx, g_ptr_array_index(words, w));
+        if (!result) {
+            result = cand;
+        } else {
+            GArray *next = search_posting_intersect(result, cand);
+            g_array_free(result, TRUE);
+            g_array_free(cand, TRUE);
+            result = next;
+        }
+        if (result->len == 0) break;
+    }
+
+    // Los trigramas sólo descartan: verificar cada candidato
+    guint kept = 0;
+    for (guint r = 0; r < result->len; r++) {
+        guint32 i = g_array_index(result, guint32, r);
+        const gchar *name = g_ptr_array_index(idx->folded, i);
+        gboolean ok = g_ptr_array_index(idx->items, i) != NULL;
+
+        for (guint w = 0; w < words->len && ok; w++) {
+            const gchar *word = g_ptr_array_index(words, w);
+            ok = strlen(word) < 3 ? search_word_prefix_match(name, word) : strstr(name, word) != NULL;
+        }
+        if (ok)
+            g_array_index(result, guint32, kept++) = i;
+    }
+    g_array_set_size(result, kept);
+
+    g_ptr_array_free(words, TRUE);
+    return result;
+}
+
+/* ==== RANKING DIFUSO ==== */
+/* Puntúa coincidencias por subsecuencia (cada palabra de la consulta debe
+ * empezar en un inicio de palabra del nombre), con bonos por prefijo, inicio
+ * de palabra y tramos contiguos, y penalización por huecos. Antes de puntuar
+ * se descarta con la máscara de bytes y con una búsqueda de subsecuencia
+ * vectorizada (SSE2/AVX2, con versión escalar para i386). Los mejores
+ * SEARCH_MAX_RESULTS se mantienen en un heap acotado, así el costo es lineal
+ * en el tamaño del catálogo. Las coincidencias exactas del índice de
+ * trigramas siempre quedan por delante de las difusas. */
+#define FUZZY_MATCH 16
+#define FUZZY_BONUS_PREFIX 24
+#define FUZZY_BONUS_BOUNDARY 10
+#define FUZZY_BONUS_CONSECUTIVE 6
+#define FUZZY_GAP_PENALTY 2
+#define FUZZY_GAP_MAX 8
+#define FUZZY_EXACT_BONUS 1000
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define FUZZY_HAVE_AVX2 1
+#endif
+
+static gssize fuzzy_find_byte_scalar(const guchar *hay, gsize len, gsize from, guchar c)
+{
+    for (gsize i = from; i < len; i++)
+        if (hay[i] == c) return i;
+    return -1;
+}
+
+#if defined(__SSE2__)
+static gssize fuzzy_find_byte_sse2(const guchar *hay, gsize len, gsize from, guchar c)
+{
+    const __m128i needle = _mm_set1_epi8((char)c);
+    gsize i = from;
+
+    // Sólo bloques completos: nunca leer más allá del final del texto
+    for (; i + 16 <= len; i += 16) {
+        int bits = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(hay + i)), needle));
+        if (bits) return i + __builtin_ctz(bits);
+    }
+    return fuzzy_find_byte_scalar(hay, len, i, c);
+}
+#endif
+
+#ifdef FUZZY_HAVE_AVX2
+__attribute__((target("avx2")))
+static gssize fuzzy_find_byte_avx2(const guchar *hay, gsize len, gsize from, guchar c)
+{
+    const __m256i needle = _mm256_set1_epi8((char)c);
+    gsize i = from;
+
+    for (; i + 32 <= len; i += 32) {
+        unsigned bits = (unsigned)_mm256_movemask_epi8(
+            _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(hay + i)), needle));
+        if (bits) return i + __builtin_ctz(bits);
+    }
+    return fuzzy_find_byte_sse2(hay, len, i, c);
+}
+#endif
+
+typedef gssize (*FuzzyFindFunc)(const guchar *, gsize, gsize, guchar);
+
+static FuzzyFindFunc fuzzy_find_byte_impl(void)
+{
+    static FuzzyFindFunc impl = NULL;
+    FuzzyFindFunc f = g_atomic_pointer_get(&impl);
+
+    if (!f) {
+#ifdef FUZZY_HAVE_AVX2
+        f = __builtin_cpu_supports("avx2") ? fuzzy_find_byte_avx2 : fuzzy_find_byte_sse2;
+#elif defined(__SSE2__)
+        f = fuzzy_find_byte_sse2;
+#else
+        f = fuzzy_find_byte_scalar;
+#endif
+        g_atomic_pointer_set(&impl, f);
+    }
+    return f;
+}
+
+static gboolean fuzzy_is_boundary(const guchar *hay, gsize pos)
+{
+    // Bytes >= 0x80 (UTF-8) cuentan como parte de la palabra
+    return pos == 0 || (hay[pos - 1] < 0x80 && !g_ascii_isalnum(hay[pos - 1]));
+}
+
+/* Puntaje de una palabra (normalizada) dentro de un nombre, o -1 */
+static gint fuzzy_score_word(FuzzyFindFunc find, const guchar *hay, gsize len,
+                             const guchar *word, gsize wlen)
+{
+    gint best = -1;
+    gssize s = find(hay, len, 0, word[0]);
+
+    for (; s >= 0; s = find(hay, len, s + 1, word[0])) {
+        if (!fuzzy_is_boundary(hay, s))
+            continue;
+
+        gint score = FUZZY_MATCH + FUZZY_BONUS_BOUNDARY + (s == 0 ? FUZZY_BONUS_PREFIX : 0);
+        gsize pos = s + 1;
+        gint run = 1;
+        gsize j = 1;
+
+        for (; j < wlen; j++) {
+            gssize p = find(hay, len, pos, word[j]);
+            if (p < 0) break;
+            if ((gsize)p == pos) {
+                score += FUZZY_MATCH + FUZZY_BONUS_CONSECUTIVE * run++;
+            } else {
+                score += FUZZY_MATCH - MIN((gint)(p - pos), FUZZY_GAP_MAX) * FUZZY_GAP_PENALTY;
+                if (fuzzy_is_boundary(hay, p))
+                    score += FUZZY_BONUS_BOUNDARY;
+                run = 1;
+            }
+            pos = p + 1;
+        }
+        // Si falta un carácter desde aquí, tampoco aparece desde un inicio posterior
+        if (j < wlen)
+            break;
+        best = MAX(best, score);
+    }
+    return best;
+}
+
+typedef struct {
+    gint score;
+    guint32 index;
+} RankedHit;
+
+/* TRUE si a es peor que b (menor puntaje o, a igual puntaje, más adelante) */
+static gboolean ranked_worse(const RankedHit *a, const RankedHit *b)
+{
+    return a->score < b->score || (a->score == b->score && a->index > b->index);
+}
+
+/* Heap de mínimos acotado a max elementos: la raíz es el peor conservado */
+static void ranked_heap_push(GArray *heap, guint max, RankedHit hit)
+{
+    RankedHit *h = (RankedHit *)heap->data;
+    gsize i;
+
+    if (heap->len < max) {
+        g_array_append_val(heap, hit);
+        h = (RankedHit *)heap->data;
+        for (i = heap->len - 1; i > 0 && ranked_worse(&hit, &h[(i - 1) / 2]); i = (i - 1) / 2)
+            h[i] = h[(i - 1) / 2];
+        h[i] = hit;
+        return;
+    }
+
+    if (max == 0 || !ranked_worse(&h[0], &hit))
+        return;
+
+    for (i = 0; ; ) {
+        gsize c = 2 * i + 1;
+        if (c >= heap->len) break;
+        if (c + 1 < heap->len && ranked_worse(&h[c + 1], &h[c])) c++;
+        if (!ranked_worse(&h[c], &hit)) break;
+        h[i] = h[c];
+        i = c;
+    }
+    h[i] = hit;
+}
+
+static gint ranked_compare_desc(gconstpointer a, gconstpointer b)
+{
+    return ranked_worse(a, b) ? 1 : ranked_worse(b, a) ? -1 : 0;
+}
+
+/* Hasta max índices ordenados del mejor al peor resultado. Si hay boost, su
+ * valor para la clave se suma al puntaje de cada coincidencia. Recibe la
+ * copia de la clave que guarda el índice y no el item: desde un hilo de
+ * búsqueda el item puede estar cambiando en el hilo principal. */
+GArray *search_index_rank_boosted(SearchIndex *idx, const char *query, guint max,
+                                  SearchBoostFunc boost, gpointer user_data)
+{
+    gchar *folded_query = search_fold(query);
+    GPtrArray *words = search_split_words(folded_query);
+    guint n = idx->items->len;
+    GArray *result = g_array_new(FALSE, FALSE, sizeof(guint32));
+    g_free(folded_query);
+
+    if (words->len == 0) {
+        g_ptr_array_free(words, TRUE);
+        return result;
+    }
+
+    // Las coincidencias exactas (subcadena / prefijo de palabra) van primero
+    guint8 *exact = g_malloc0(n ? n : 1);
+    GArray *exact_hits = search_index_query(idx, query);
+    for (guint r = 0; r < exact_hits->len; r++)
+        exact[g_array_index(exact_hits, guint32, r)] = 1;
+    g_array_free(exact_hits, TRUE);
+
+    guint64 query_mask = 0;
+    for (guint w = 0; w < words->len; w++)
+        query_mask |= search_byte_mask(g_ptr_array_index(words, w));
+
+    FuzzyFindFunc find = fuzzy_find_byte_impl();
+    GArray *heap = g_array_sized_new(FALSE, FALSE, sizeof(RankedHit), MIN(n, max));
+
+    for (guint32 i = 0; i < n; i++) {
+        if ((query_mask & ~g_array_index(idx->masks, guint64, i)) != 0)
+            continue;
+
+        const guchar *name = g_ptr_array_index(idx->folded, i);
+        gsize len = strlen((const char *)name);
+        gint total = exact[i] ? FUZZY_EXACT_BONUS : 0;
+
+        for (guint w = 0; w < words->len && total >= 0; w++) {
+            const guchar *word = g_ptr_array_index(words, w);
+            gint score = fuzzy_score_word(find, name, len, word, strlen((const char *)word));
+            total = score < 0 ? -1 : total + score;
+        }
+        // Un exacto puede no puntuar como subsecuencia anclada (p. ej. "alc" en "calc")
+        if (total < 0 && exact[i])
+            total = FUZZY_EXACT_BONUS;
+        if (total < 0)
+            continue;
+
+        const char *key = g_ptr_array_index(idx->keys, i);
+        if (boost && key)
+            total += boost(key, user_data);
+
+        RankedHit hit = { total - (gint)(len / 4), i };  // a igualdad, nombres cortos
+        ranked_heap_push(heap, max, hit);
+    }
+
+    g_array_sort(heap, ranked_compare_desc);
+    for (guint r = 0; r < heap->len; r++)
+        g_array_append_val(result, g_array_index(heap, RankedHit, r).index);
+
+    g_array_free(heap, TRUE);
+    g_free(exact);
+    g_ptr_array_free(words, TRUE);
+    return result;
+}
+
+GArray *search_index_rank(SearchIndex *idx, const char *query, guint max)
+{
+    return search_index_rank_boosted(idx, query, max, NULL, NULL);
+}
+
+/* Bono de ranking por uso: crece con el logaritmo del puntaje y se topa en
+ * FRECENCY_BOOST_MAX (del orden de un bono de prefijo), así decide entre
+ * coincidencias parecidas pero nunca pasa una difusa por delante de una exacta */
+#define FRECENCY_BOOST_SCALE 12
+#define FRECENCY_BOOST_MAX 40
+
+gint frecency_boost(FrecencyStore *f, const char *id, gint64 now)
+{
+    gdouble score = frecency_score(f, id, now);
+    if (!(score > 0)) return 0;  // también NaN de un slot leído a medio escribir
+    return (gint)MIN(FRECENCY_BOOST_MAX, FRECENCY_BOOST_SCALE * log2(1.0 + score) + 0.5);
+}
+
+/* ==== ÍNDICE DEL CATÁLOGO ==== */
+static SearchIndex *catalog_search_index_build(Catalog *c)
+{
+    SearchIndex *idx = search_index_new((GBoxedCopyFunc)app_entry_ref,
+                                        (GDestroyNotify)app_entry_unref);
+    for (guint i = 0; i < c->apps->len; i++) {
+        AppEntry *e = g_ptr_array_index(c->apps, i);
+        search_index_add(idx, e->id, e->name, app_entry_ref(e));
+    }
+    return idx;
+}
+
+/* Pone el índice al día con el catálogo tocando sólo los ids de touched
+ * (agregados, cambiados o quitados); sin índice o sin touched lo arma de
+ * cero. Toma la referencia de idx y devuelve el índice a usar: si una
+ * búsqueda en curso lo comparte, se modifica una copia. */
+SearchIndex *catalog_search_index_update(SearchIndex *idx, Catalog *c, GHashTable *touched)
+{
+    if (!idx || !touched || g_hash_table_size(touched) > c->apps->len / 2) {
+        search_index_unref(idx);
+        return catalog_search_index_build(c);
+    }
+    if (g_hash_table_size(touched) == 0) return idx;
+
+    if (g_atomic_int_get(&idx->ref_count) > 1) {
+        SearchIndex *copy = search_index_copy(idx);
+        search_index_unref(idx);
+        idx = copy;
+    }
+
+    GHashTableIter it;
+    gpointer id;
+    g_hash_table_iter_init(&it, touched);
+    while (g_hash_table_iter_next(&it, &id, NULL)) {
+        AppEntry *e = catalog_lookup(c, id);
+        if (e)
+            search_index_add(idx, id, e->name, app_entry_ref(e));
+        else
+            search_index_remove(idx, id);
+    }
+
+    // Demasiadas lápidas: compactar
+    if (idx->n_dead > idx->items->len / 2) {
+        search_index_unref(idx);
+        return catalog_search_index_build(c);
+    }
+    return idx;
+}
+
+/* ==== INSTANTÁNEA DEL CATÁLOGO ==== */
+/* Copia binaria del catálogo para mapear en memoria: cabecera, tablas de
+ * apps, categorías y miembros, y un bloque de cadenas terminadas en NUL al
+ * final. Las entradas leídas apuntan directo al mapa. El archivo guarda el
+ * idioma con el que se generó y se descarta si no coincide, o si la
+ * versión, el orden de bytes o algún desplazamiento no son válidos. */
+#define CATALOG_MAGIC "MMCATLG"
+#define CATALOG_VERSION 1
+#define CATALOG_BYTE_ORDER 0x01020304
+
+typedef struct {
+    char magic[8];
+    guint32 version;
+    guint32 byte_order;
+    guint32 n_apps;
+    guint32 n_categories;
+    guint32 n_members;
+    guint32 locale;         // desplazamiento en el bloque de cadenas
+    guint32 strings_size;
+    guint32 reserved;
+} CatalogHeader;
+
+typedef struct {
+    guint32 id, name, icon, exec, file;  // desplazamientos; 0 = sin valor
+} CatalogApp;
+
+typedef struct {
+    guint32 id, name;
+    guint32 first_member, n_members;     // rango en la tabla de miembros
+} CatalogCategory;
+
+/* Cadena del bloque, o NULL si el desplazamiento es 0 o inválido */
+static const gchar *catalog_string(const gchar *strings, guint32 size, guint32 offset)
+{
+    return offset && offset < size ? strings + offset : NULL;
+}
+
+/* Catálogo leído de la instantánea, o NULL si no hay o no vale */
+Catalog *catalog_snapshot_read(const char *path, const char *locale)
+{
+    GMappedFile *map = g_mapped_file_new(path, FALSE, NULL);
+    if (!map) return NULL;
+
+    gsize len = g_mapped_file_get_length(map);
+    const gchar *base = g_mapped_file_get_contents(map);
+    const CatalogHeader *h = (const CatalogHeader *)base;
+    guint64 strings_at = 0;
+
+    // En 64 bits: en i386 la suma en gsize puede dar la vuelta y coincidir con len
+    if (len >= sizeof(CatalogHeader) &&
+        memcmp(h->magic, CATALOG_MAGIC, sizeof(h->magic)) == 0 &&
+        h->version == CATALOG_VERSION && h->byte_order == CATALOG_BYTE_ORDER) {
+        strings_at = sizeof(CatalogHeader) + (guint64)h->n_apps * sizeof(CatalogApp) +
+                     (guint64)h->n_categories * sizeof(CatalogCategory) +
+                     (guint64)h->n_members * sizeof(guint32);
+    }
+    // El bloque de cadenas va al final y termina en NUL
+    if (!strings_at || strings_at + h->strings_size != (guint64)len || h->strings_size == 0 ||
+        base[len - 1] != '\0') {
+        g_debug("modernmenu: discarding invalid catalog snapshot");
+        g_mapped_file_unref(map);
+        return NULL;
+    }
+
+    const gchar *strings = base + strings_at;
+    if (g_strcmp0(catalog_string(strings, h->strings_size, h->locale), locale) != 0) {
+        g_mapped_file_unref(map);
+        return NULL;
+    }
+
+    const CatalogApp *app_recs = (const CatalogApp *)(base + sizeof(CatalogHeader));
+    const CatalogCategory *cat_recs = (const CatalogCategory *)(app_recs + h->n_apps);
+    const guint32 *members = (const guint32 *)(cat_recs + h->n_categories);
+
+    Catalog *c = catalog_new();
+    GPtrArray *by_index = g_ptr_array_sized_new(h->n_apps);  // índice del archivo -> entrada o NULL
+
+    for (guint32 i = 0; i < h->n_apps; i++) {
+        const CatalogApp *r = &app_recs[i];
+        AppEntry *e = app_entry_new_backed(catalog_string(strings, h->strings_size, r->id),
+                                           catalog_string(strings, h->strings_size, r->name),
+                                           catalog_string(strings, h->strings_size, r->icon),
+                                           catalog_string(strings, h->strings_size, r->exec),
+                                           catalog_string(strings, h->strings_size, r->file),
+                                           g_mapped_file_ref(map),
+                                           (GDestroyNotify)g_mapped_file_unref, FALSE);
+        AppEntry *kept = catalog_add_app(c, e);
+        g_ptr_array_add(by_index, kept == e ? e : NULL);
+    }
+
+    for (guint32 i = 0; i < h->n_categories; i++) {
+        const CatalogCategory *r = &cat_recs[i];
+        if (r->first_member > h->n_members || r->n_members > h->n_members - r->first_member)
+            continue;
+
+        CategoryEntry *cat = catalog_add_category(c, catalog_string(strings, h->strings_size, r->id),
+                                                  catalog_string(strings, h->strings_size, r->name));
+        if (!cat) continue;
+        for (guint32 k = 0; k < r->n_members; k++) {
+            guint32 idx = members[r->first_member + k];
+            AppEntry *e = idx < by_index->len ? g_ptr_array_index(by_index, idx) : NULL;
+            if (e) g_ptr_array_add(cat->apps, app_entry_ref(e));
+        }
+    }
+
+    g_ptr_array_free(by_index, TRUE);
+    g_mapped_file_unref(map);  // las entradas conservan el mapa
+    return c;
+}
+
+/* Agrega una cadena al bloque y devuelve su desplazamiento (0 para NULL) */
+static guint32 catalog_add_string(GString *strings, const char *s)
+{
+    if (!s) return 0;
+    guint32 offset = strings->len;
+    g_string_append_len(strings, s, strlen(s) + 1);
+    return offset;
+}
+
+/* Escribe el catálogo a path (a un temporal y renombrando: los mapas
+ * abiertos de la versión anterior no se tocan) */
+gboolean catalog_snapshot_write(Catalog *c, const char *path, const char *locale, GError **error)
+{
+    GString *strings = g_string_new("");
+    g_string_append_c(strings, '\0');  // el desplazamiento 0 significa "sin valor"
+
+    GArray *apps = g_array_sized_new(FALSE, TRUE, sizeof(CatalogApp), c->apps->len);
+    GHashTable *index_of = g_hash_table_new(NULL, NULL);
+    for (guint i = 0; i < c->apps->len; i++) {
+        AppEntry *e = g_ptr_array_index(c->apps, i);
+        CatalogApp r = {
+            catalog_add_string(strings, e->id), catalog_add_string(strings, e->name),
+            catalog_add_string(strings, e->icon), catalog_add_string(strings, e->exec),
+            catalog_add_string(strings, e->file)
+        };
+        g_array_append_val(apps, r);
+        g_hash_table_insert(index_of, e, GUINT_TO_POINTER(i + 1));
+    }
+
+    GArray *cats = g_array_new(FALSE, TRUE, sizeof(CatalogCategory));
+    GArray *members = g_array_new(FALSE, FALSE, sizeof(guint32));
+    for (guint i = 0; i < c->categories->len; i++) {
+        CategoryEntry *cat = g_ptr_array_index(c->categories, i);
+        CatalogCategory r = {
+            catalog_add_string(strings, cat->id), catalog_add_string(strings, cat->name),
+            members->len, 0
+        };
+        for (guint k = 0; k < cat->apps->len; k++) {
+            guint pos = GPOINTER_TO_UINT(g_hash_table_lookup(index_of, g_ptr_array_index(cat->apps, k)));
+            if (!pos) continue;
+            guint32 idx = pos - 1;
+            g_array_append_val(members, idx);
+            r.n_members++;
+        }
+        g_array_append_val(cats, r);
+    }
+
+    CatalogHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, CATALOG_MAGIC, sizeof(h.magic));
+    h.version = CATALOG_VERSION;
+    h.byte_order = CATALOG_BYTE_ORDER;
+    h.n_apps = apps->len;
+    h.n_categories = cats->len;
+    h.n_members = members->len;
+    h.locale = catalog_add_string(strings, locale);
+    h.strings_size = strings->len;
+
+    GString *buf = g_string_sized_new(sizeof(h) + apps->len * sizeof(CatalogApp) + strings->len);
+    g_string_append_len(buf, (const gchar *)&h, sizeof(h));
+    g_string_append_len(buf, apps->data, apps->len * sizeof(CatalogApp));
+    g_string_append_len(buf, cats->data, cats->len * sizeof(CatalogCategory));
+    g_string_append_len(buf, members->data, members->len * sizeof(guint32));
+    g_string_append_len(buf, strings->str, strings->len);
+
+    gchar *dir = g_path_get_dirname(path);
+    g_mkdir_with_parents(dir, 0700);
+    g_free(dir);
+
+    gboolean ok = g_file_set_contents(path, buf->str, buf->len, error);
+
+    g_string_free(buf, TRUE);
+    g_array_free(members, TRUE);
+    g_array_free(cats, TRUE);
+    g_hash_table_destroy(index_of);
+    g_array_free(apps, TRUE);
+    g_string_free(strings, TRUE);
+    return ok;
+}
+
+/* ==== ÍNDICE DE PAQUETES ==== */
+/* Qué paquete instaló cada archivo, armado con los datos locales del gestor
+ * (las listas de /var/lib/dpkg/info y el estado de dpkg, o la base local de
+ * pacman) en lugar de preguntar con dpkg -S / pacman -Qo. Sólo se guardan
+ * las rutas que interesan para desinstalar apps: ejecutables (directorios
+ * bin, sbin y games) y archivos .desktop; así el índice pesa unos cientos de
+ * KiB aunque el sistema tenga cientos de miles de archivos.
+ *
+ * Formato, pensado para mapear y consultar sin armar nada: cabecera, tabla
+ * de paquetes, tabla de archivos ordenada por ruta (búsqueda binaria) y un
+ * bloque de cadenas al final. La cabecera guarda un sello con las fechas de
+ * modificación de la base del gestor; si no coincide, el índice está viejo. */
+#define PACKAGE_INDEX_MAGIC "MMPKGIX"
+#define PACKAGE_INDEX_VERSION 1
+#define PACKAGE_INDEX_BYTE_ORDER 0x01020304
+
+#define DPKG_INFO_DIR "/var/lib/dpkg/info"
+#define DPKG_STATUS "/var/lib/dpkg/status"
+#define PACMAN_LOCAL_DIR "/var/lib/pacman/local"
+
+typedef struct {
+    char magic[8];
+    guint32 version;
+    guint32 byte_order;
+    guint32 manager;
+    guint32 n_packages;
+    guint32 n_files;
+    guint32 strings_size;
+    guint64 stamp;
+} PackageIndexHeader;
+
+typedef struct {
+    guint32 name, version;  // desplazamientos; 0 = sin valor
+    gint64 size;            // bytes instalados, -1 si no se sabe
+} PackageRecord;
+
+typedef struct {
+    guint32 path;
+    guint32 package;        // posición en la tabla de paquetes
+} PackageFile;
+
+struct _PackageIndex {
+    GBytes *data;           // archivo mapeado o armado en memoria
+    const PackageIndexHeader *header;
+    const PackageRecord *packages;
+    const PackageFile *files;
+    const gchar *strings;
+};
+
+/* El que esté instalado; pacman primero, como el resto del plugin */
+PackageManager package_manager_detect(void)
+{
+    if (g_file_test(PACMAN_LOCAL_DIR, G_FILE_TEST_IS_DIR))
+        return PACKAGE_MANAGER_PACMAN;
+    if (g_file_test(DPKG_STATUS, G_FILE_TEST_EXISTS) && g_file_test(DPKG_INFO_DIR, G_FILE_TEST_IS_DIR))
+        return PACKAGE_MANAGER_DPKG;
+    return PACKAGE_MANAGER_NONE;
+}
+
+static guint64 package_stamp_mix(guint64 stamp, const char *path)
+{
+    GStatBuf st;
+    if (g_stat(path, &st) != 0)
+        return stamp;
+    guint64 t = (guint64)st.st_mtim.tv_sec * G_GUINT64_CONSTANT(1000000000) + st.st_mtim.tv_nsec;
+    return (stamp ^ t ^ ((guint64)st.st_size << 20)) * 0x100000001b3ull;
+}
+
+/* Sello de la base del gestor: cambia al instalar, quitar o actualizar.
+ * dpkg reescribe el estado y renombra las listas (cambia el directorio);
+ * pacman crea y borra un directorio por paquete. */
+guint64 package_index_current_stamp(PackageManager manager)
+{
+    guint64 stamp = 0xcbf29ce484222325ull;
+    switch (manager) {
+    case PACKAGE_MANAGER_DPKG:
+        stamp = package_stamp_mix(stamp, DPKG_STATUS);
+        stamp = package_stamp_mix(stamp, DPKG_INFO_DIR);
+        break;
+    case PACKAGE_MANAGER_PACMAN:
+        stamp = package_stamp_mix(stamp, PACMAN_LOCAL_DIR);
+        break;
+    default:
+        return 0;
+    }
+    return stamp ? stamp : 1;
+}
+
+static gboolean package_path_wanted(const char *path)
+{
+    gsize len = strlen(path);
+    if (len == 0 || path[len - 1] == '/')
+        return FALSE;  // directorio (pacman los lista con '/')
+    return g_str_has_suffix(path, ".desktop") ||
+           strstr(path, "/bin/") || strstr(path, "/sbin/") || strstr(path, "/games/");
+}
+
+/* ---- Armado ---- */
+typedef struct {
+    GString *strings;
+    GArray *packages;       // PackageRecord
+    GArray *files;          // PackageFile, en orden de lectura
+} PackageBuilder;
+
+static guint32 package_builder_string(PackageBuilder *b, const char *s, gssize len)
+{
+    if (!s) return 0;
+    guint32 offset = b->strings->len;
+    g_string_append_len(b->strings, s, len < 0 ? (gssize)strlen(s) : len);
+    g_string_append_c(b->strings, '\0');
+    return offset;
+}
+
+static guint32 package_builder_add(PackageBuilder *b, const char *name, const char *version, gint64 size)
+{
+    PackageRecord r = {
+        package_builder_string(b, name, -1), package_builder_string(b, version, -1), size
+    };
+    g_array_append_val(b->packages, r);
+    return b->packages->len - 1;
+}
+
+/* Agrega cada línea de list (una ruta, con prefix delante) que interese;
+ * termina en la primera línea vacía */
+static void package_builder_files(PackageBuilder *b, guint32 package, const char *prefix,
+                                  const char *list)
+{
+    for (const char *line = list; *line; ) {
+        const char *end = strchrnul(line, '\n');
+        if (end == line) break;
+
+        gchar *relative = g_strndup(line, end - line);
+        gchar *path = g_strconcat(prefix, relative, NULL);
+        if (package_path_wanted(path)) {
+            PackageFile f = { package_builder_string(b, path, -1), package };
+            g_array_append_val(b->files, f);
+        }
+        g_free(path);
+        g_free(relative);
+
+        line = *end ? end + 1 : end;
+    }
+}
+
+typedef struct {
+    gchar *version;
+    gint64 size;
+} DpkgStatus;
+
+static DpkgStatus *dpkg_status_new(const char *version, gint64 size)
+{
+    DpkgStatus *s = g_new0(DpkgStatus, 1);
+    s->version = g_strdup(version);
+    s->size = size;
+    return s;
+}
+
+static void dpkg_status_free(gpointer data)
+{
+    DpkgStatus *s = data;
+    g_free(s->version);
+    g_free(s);
+}
+
+/* "paquete" y "paquete:arquitectura" -> versión y tamaño de los instalados */
+static GHashTable *dpkg_read_status(void)
+{
+    GHashTable *status = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, dpkg_status_free);
+    gchar *content = NULL;
+    if (!g_file_get_contents(DPKG_STATUS, &content, NULL, NULL))
+        return status;
+
+    gchar **stanzas = g_strsplit(content, "\n\n", -1);
+    for (int i = 0; stanzas[i]; i++) {
+        gchar *package = NULL, *arch = NULL, *version = NULL;
+        gboolean installed = FALSE;
+        gint64 size = -1;
+
+        gchar **lines = g_strsplit(stanzas[i], "\n", -1);
+        for (int k = 0; lines[k]; k++) {
+            gchar *value = strchr(lines[k], ':');
+            if (lines[k][0] == ' ' || !value) continue;  // continuación de un campo largo
+            *value++ = '\0';
+            value = g_strstrip(value);
+
+            if (strcmp(lines[k], "Package") == 0) package = g_strdup(value);
+            else if (strcmp(lines[k], "Architecture") == 0) arch = g_strdup(value);
+            else if (strcmp(lines[k], "Version") == 0) version = g_strdup(value);
+            else if (strcmp(lines[k], "Installed-Size") == 0) size = g_ascii_strtoll(value, NULL, 10) * 1024;
+            else if (strcmp(lines[k], "Status") == 0) installed = g_str_has_suffix(value, " installed");
+        }
+        g_strfreev(lines);
+
+        // Las listas de paquetes multi-arquitectura se llaman "paquete:arquitectura"
+        if (package && installed) {
+            if (arch)
+                g_hash_table_replace(status, g_strdup_printf("%s:%s", package, arch),
+                                     dpkg_status_new(version, size));
+            if (!g_hash_table_contains(status, package))
+                g_hash_table_insert(status, g_strdup(package), dpkg_status_new(version, size));
+        }
+        g_free(package);
+        g_free(arch);
+        g_free(version);
+    }
+    g_strfreev(stanzas);
+    g_free(content);
+    return status;
+}
+
+static gboolean dpkg_build(PackageBuilder *b, volatile gint *cancel, GError **error)
+{
+    GDir *dir = g_dir_open(DPKG_INFO_DIR, 0, error);
+    if (!dir) return FALSE;
+
+    GHashTable *status = dpkg_read_status();
+    const char *name;
+    while ((name = g_dir_read_name(dir))) {
+        if (cancel && g_atomic_int_get(cancel)) break;
+        if (!g_str_has_suffix(name, ".list")) continue;
+
+        // "paquete.list" o "paquete:arquitectura.list"; ese nombre sirve para apt
+        gchar *package = g_strndup(name, strlen(name) - strlen(".list"));
+        DpkgStatus *s = g_hash_table_lookup(status, package);
+        gchar *path = g_build_filename(DPKG_INFO_DIR, name, NULL);
+        gchar *content = NULL;
+
+        if (g_file_get_contents(path, &content, NULL, NULL)) {
+            guint32 p = package_builder_add(b, package, s ? s->version : NULL, s ? s->size : -1);
+            package_builder_files(b, p, "", content);
+        }
+        g_free(content);
+        g_free(path);
+        g_free(package);
+    }
+    g_dir_close(dir);
+    g_hash_table_destroy(status);
+    return TRUE;
+}
+
+/* Valor de una sección "%CLAVE%" de un archivo desc de pacman */
+static gchar *pacman_desc_value(const char *desc, const char *key)
+{
+    gchar *header = g_strdup_printf("%%%s%%\n", key);
+    const char *at = strstr(desc, header);
+    gchar *value = NULL;
+    if (at) {
+        at += strlen(header);
+        value = g_strndup(at, strcspn(at, "\n"));
+    }
+    g_free(header);
+    return value;
+}
+
+static gboolean pacman_build(PackageBuilder *b, volatile gint *cancel, GError **error)
+{
+    GDir *dir = g_dir_open(PACMAN_LOCAL_DIR, 0, error);
+    if (!dir) return FALSE;
+
+    const char *name;
+    while ((name = g_dir_read_name(dir))) {
+        if (cancel && g_atomic_int_get(cancel)) break;
+
+        gchar *desc_path = g_build_filename(PACMAN_LOCAL_DIR, name, "desc", NULL);
+        gchar *files_path = g_build_filename(PACMAN_LOCAL_DIR, name, "files", NULL);
+        gchar *desc = NULL, *files = NULL;
+
+        if (g_file_get_contents(desc_path, &desc, NULL, NULL) &&
+            g_file_get_contents(files_path, &files, NULL, NULL)) {
+            gchar *package = pacman_desc_value(desc, "NAME");
+            gchar *version = pacman_desc_value(desc, "VERSION");
+            gchar *size = pacman_desc_value(desc, "SIZE");
+            const char *list = strstr(files, "%FILES%\n");
+
+            if (package && list) {
+                guint32 p = package_builder_add(b, package, version,
+                                                size ? g_ascii_strtoll(size, NULL, 10) : -1);
+                // Rutas relativas a la raíz
+                package_builder_files(b, p, "/", list + strlen("%FILES%\n"));
+            }
+            g_free(package);
+            g_free(version);
+            g_free(size);
+        }
+        g_free(desc);
+        g_free(files);
+        g_free(desc_path);
+        g_free(files_path);
+    }
+    g_dir_close(dir);
+    return TRUE;
+}
+
+static gint package_file_compare(gconstpointer a, gconstpointer b, gpointer strings)
+{
+    const PackageFile *x = a, *y = b;
+    gint c = strcmp((const gchar *)strings + x->path, (const gchar *)strings + y->path);
+    // A igual ruta, el primero leído
+    return c ? c : (x->package > y->package) - (x->package < y->package);
+}
+
+static PackageIndex *package_index_from_bytes(GBytes *data);
+
+/* Arma el índice leyendo la base del gestor. Tarda (segundos en sistemas
+ * grandes): llamar desde un hilo. Si cancel se pone en 1, corta y devuelve
+ * NULL. */
+PackageIndex *package_index_build(PackageManager manager, volatile gint *cancel, GError **error)
+{
+    guint64 stamp = package_index_current_stamp(manager);
+    PackageBuilder b = {
+        g_string_new(""),   // desplazamiento 0 = sin valor
+        g_array_new(FALSE, FALSE, sizeof(PackageRecord)),
+        g_array_new(FALSE, FALSE, sizeof(PackageFile)),
+    };
+    g_string_append_c(b.strings, '\0');
+
+    gboolean ok = manager == PACKAGE_MANAGER_DPKG ? dpkg_build(&b, cancel, error) :
+                  manager == PACKAGE_MANAGER_PACMAN ? pacman_build(&b, cancel, error) : FALSE;
+    if (!ok && error && !*error)
+        g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_NOENT, "no supported package manager");
+    if (cancel && g_atomic_int_get(cancel))
+        ok = FALSE;
+
+    PackageIndex *idx = NULL;
+    if (ok) {
+        g_array_sort_with_data(b.files, package_file_compare, b.strings->str);
+
+        // Rutas repetidas: queda la primera
+        guint kept = 0;
+        for (guint i = 0; i < b.files->len; i++) {
+            PackageFile *f = &g_array_index(b.files, PackageFile, i);
+            if (kept && strcmp(b.strings->str + f->path,
+                               b.strings->str + g_array_index(b.files, PackageFile, kept - 1).path) == 0)
+                continue;
+            g_array_index(b.files, PackageFile, kept++) = *f;
+        }
+        g_array_set_size(b.files, kept);
+
+        PackageIndexHeader h = { PACKAGE_INDEX_MAGIC, PACKAGE_INDEX_VERSION, PACKAGE_INDEX_BYTE_ORDER,
+                                 manager, b.packages->len, b.files->len, b.strings->len, stamp };
+        GByteArray *out = g_byte_array_sized_new(sizeof(h) + b.packages->len * sizeof(PackageRecord) +
+                                                 b.files->len * sizeof(PackageFile) + b.strings->len);
+        g_byte_array_append(out, (const guint8 *)&h, sizeof(h));
+        g_byte_array_append(out, (const guint8 *)b.packages->data, b.packages->len * sizeof(PackageRecord));
+        g_byte_array_append(out, (const guint8 *)b.files->data, b.files->len * sizeof(PackageFile));
+        g_byte_array_append(out, (const guint8 *)b.strings->str, b.strings->len);
+        idx = package_index_from_bytes(g_byte_array_free_to_bytes(out));
+    }
+
+    g_string_free(b.strings, TRUE);
+    g_array_free(b.packages, TRUE);
+    g_array_free(b.files, TRUE);
+    return idx;
+}
+
+/* ---- Lectura y consulta ---- */
+/* Toma data. NULL si la cabecera o los tamaños no son válidos. */
+static PackageIndex *package_index_from_bytes(GBytes *data)
+{
+    gsize len;
+    const gchar *base = g_bytes_get_data(data, &len);
+    const PackageIndexHeader *h = (const PackageIndexHeader *)base;
+
+    if (len < sizeof(PackageIndexHeader) ||
+        memcmp(h->magic, PACKAGE_INDEX_MAGIC, sizeof(h->magic)) != 0 ||
+        h->version != PACKAGE_INDEX_VERSION || h->byte_order != PACKAGE_INDEX_BYTE_ORDER ||
+        h->strings_size == 0 ||
+        // En 64 bits, como en catalog_snapshot_read: en i386 gsize da la vuelta
+        sizeof(PackageIndexHeader) + (guint64)h->n_packages * sizeof(PackageRecord) +
+        (guint64)h->n_files * sizeof(PackageFile) + h->strings_size != (guint64)len ||
+        base[len - 1] != '\0') {
+        g_bytes_unref(data);
+        return NULL;
+    }
+
+    PackageIndex *idx = g_new0(PackageIndex, 1);
+    idx->data = data;
+    idx->header = h;
+    idx->packages = (const PackageRecord *)(base + sizeof(PackageIndexHeader));
+    idx->files = (const PackageFile *)(idx->packages + h->n_packages);
+    idx->strings = (const gchar *)(idx->files + h->n_files);
+    return idx;
+}
+
+/* Índice guardado en path, si es de manager y su sello sigue vigente */
+PackageIndex *package_index_load(const char *path, PackageManager manager)
+{
+    GMappedFile *map = g_mapped_file_new(path, FALSE, NULL);
+    if (!map) return NULL;
+
+    PackageIndex *idx = package_index_from_bytes(g_mapped_file_get_bytes(map));
+    g_mapped_file_unref(map);  // los bytes conservan el mapa
+
+    if (idx && (idx->header->manager != (guint32)manager ||
+                idx->header->stamp != package_index_current_stamp(manager))) {
+        package_index_free(idx);
+        idx = NULL;
+    }
+    return idx;
+}
+
+gboolean package_index_save(PackageIndex *idx, const char *path, GError **error)
+{
+    gchar *dir = g_path_get_dirname(path);
+    g_mkdir_with_parents(dir, 0700);
+    g_free(dir);
+
+    gsize len;
+    const gchar *data = g_bytes_get_data(idx->data, &len);
+    return g_file_set_contents(path, data, len, error);
+}
+
+void package_index_free(PackageIndex *idx)
+{
+    if (!idx) return;
+    g_bytes_unref(idx->data);
+    g_free(idx);
+}
+
+PackageManager package_index_manager(PackageIndex *idx)
+{
+    return idx->header->manager;
+}
+
+/* ¿El índice sigue describiendo lo instalado? (unos stat) */
+gboolean package_index_is_current(PackageIndex *idx)
+{
+    return idx->header->stamp == package_index_current_stamp(idx->header->manager);
+}
+
+static const gchar *package_index_string(PackageIndex *idx, guint32 offset)
+{
+    return offset && offset < idx->header->strings_size ? idx->strings + offset : NULL;
+}
+
+/* Paquete dueño de path (búsqueda binaria). Las cadenas de info son del índice. */
+gboolean package_index_owner(PackageIndex *idx, const char *path, PackageInfo *info)
+{
+    if (!idx || !path) return FALSE;
+
+    guint lo = 0, hi = idx->header->n_files;
+    while (lo < hi) {
+        guint mid = lo + (hi - lo) / 2;
+        const gchar *p = package_index_string(idx, idx->files[mid].path);
+        gint c = strcmp(p ? p : "", path);
+        if (c == 0) {
+            guint32 k = idx->files[mid].package;
+            if (k >= idx->header->n_packages) return FALSE;
+            info->name = package_index_string(idx, idx->packages[k].name);
+            info->version = package_index_string(idx, idx->packages[k].version);
+            info->size = idx->packages[k].size;
+            return info->name != NULL;
+        }
+        if (c < 0) lo = mid + 1;
+        else hi = mid;
+    }
+    return FALSE;
+}
+
+/* ==== PRECARGA DE EJECUTABLES ==== */
+/* Lista los archivos que va a leer el kernel al lanzar un programa: el
+ * ejecutable, su intérprete (#! o el cargador dinámico) y las bibliotecas de
+ * DT_NEEDED, resueltas como lo hace ld.so (RPATH/RUNPATH con $ORIGIN, luego
+ * ld.so.conf y los directorios de siempre). Sólo ELF de la misma clase que
+ * el plugin; para los demás queda el ejecutable solo. prefetch_readahead
+ * pide esas páginas al kernel sin esperar a que lleguen. */
+static void prefetch_conf_dirs(const char *path, GPtrArray *dirs, int depth)
+{
+    gchar *content = NULL;
+    if (depth > 2 || !g_file_get_contents(path, &content, NULL, NULL))
+        return;
+
+    gchar **lines = g_strsplit(content, "\n", -1);
+    for (int i = 0; lines[i]; i++) {
+        gchar *hash = strchr(lines[i], '#');
+        if (hash) *hash = '\0';
+        gchar *line = g_strstrip(lines[i]);
+
+        if (g_str_has_prefix(line, "include") && g_ascii_isspace(line[7])) {
+            glob_t g;
+            if (glob(g_strstrip(line + 8), 0, NULL, &g) == 0) {
+                for (size_t k = 0; k < g.gl_pathc; k++)
+                    prefetch_conf_dirs(g.gl_pathv[k], dirs, depth + 1);
+                globfree(&g);
+            }
+        } else if (*line == '/') {
+            g_ptr_array_add(dirs, g_strdup(line));
+        }
+    }
+    g_strfreev(lines);
+    g_free(content);
+}
+
+/* Directorios de bibliotecas del sistema (se arma una sola vez) */
+static GPtrArray *prefetch_lib_dirs(void)
+{
+    static GPtrArray *dirs;
+
+    if (g_once_init_enter(&dirs)) {
+        GPtrArray *d = g_ptr_array_new_with_free_func(g_free);
+        prefetch_conf_dirs("/etc/ld.so.conf", d, 0);
+        static const char *const defaults[] = {
+            "/lib", "/usr/lib", "/lib64", "/usr/lib64", NULL
+        };
+        for (int i = 0; defaults[i]; i++)
+            g_ptr_array_add(d, g_strdup(defaults[i]));
+        g_once_init_leave(&dirs, d);
+    }
+    return dirs;
+}
+
+static gchar *prefetch_find_in(const char *dirs, const char *origin, const char *name)
+{
+    gchar *found = NULL;
+    gchar **parts = g_strsplit(dirs, ":", -1);
+
+    for (int i = 0; parts[i] && !found; i++) {
+        if (!*parts[i]) continue;
+        gchar *dir = parts[i];
+        gchar *expanded = NULL;
+        if (g_str_has_prefix(dir, "$ORIGIN") || g_str_has_prefix(dir, "${ORIGIN}"))
+            dir = expanded = g_strconcat(origin, strchr(dir, '/') ? strchr(dir, '/') : "", NULL);
+
+        gchar *path = g_build_filename(dir, name, NULL);
+        if (access(path, R_OK) == 0) found = path;
+        else g_free(path);
+        g_free(expanded);
+    }
+    g_strfreev(parts);
+    return found;
+}
+
+static gchar *prefetch_resolve_lib(const char *name, const char *rpath, const char *origin)
+{
+    if (strchr(name, '/'))
+        return access(name, R_OK) == 0 ? g_strdup(name) : NULL;
+
+    gchar *found = rpath ? prefetch_find_in(rpath, origin, name) : NULL;
+    GPtrArray *dirs = prefetch_lib_dirs();
+    for (guint i = 0; i < dirs->len && !found; i++) {
+        gchar *path = g_build_filename(g_ptr_array_index(dirs, i), name, NULL);
+        if (access(path, R_OK) == 0) found = path;
+        else g_free(path);
+    }
+    return found;
+}
+
+/* Cadena del ELF en el desplazamiento dado, o NULL si se sale del archivo */
+static const char *prefetch_elf_string(const guint8 *map, gsize size, gsize offset)
+{
+    if (offset >= size || !memchr(map + offset, '\0', size - offset))
+        return NULL;
+    return (const char *)map + offset;
+}
+
+static gboolean prefetch_elf_offset(const ElfW(Phdr) *ph, guint n, ElfW(Addr) vaddr, gsize *offset)
+{
+    for (guint i = 0; i < n; i++) {
+        if (ph[i].p_type == PT_LOAD && vaddr >= ph[i].p_vaddr &&
+            vaddr < ph[i].p_vaddr + ph[i].p_filesz) {
+            *offset = ph[i].p_offset + (vaddr - ph[i].p_vaddr);
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+/* Agrega a deps el intérprete y las bibliotecas que pide path */
+static void prefetch_scan(const char *path, GPtrArray *deps)
+{
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size < 4) {
+        close(fd);
+        return;
+    }
+    gsize size = st.st_size;
+    const guint8 *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return;
+
+    if (map[0] == '#' && map[1] == '!') {
+        // Script: el intérprete es el primer argumento (o el segundo con env)
+        gchar *line = g_strndup((const char *)map + 2, MIN(size - 2, 256));
+        line[strcspn(line, "\n")] = '\0';
+        gchar **argv = g_strsplit_set(g_strstrip(line), " \t", 3);
+        if (argv[0] && g_str_has_suffix(argv[0], "/env") && argv[1])
+            g_ptr_array_add(deps, g_find_program_in_path(argv[1]));
+        else if (argv[0] && *argv[0] == '/')
+            g_ptr_array_add(deps, g_strdup(argv[0]));
+        g_strfreev(argv);
+        g_free(line);
+        goto done;
+    }
+
+    const ElfW(Ehdr) *eh = (const ElfW(Ehdr) *)map;
+    if (size < sizeof(ElfW(Ehdr)) || memcmp(eh->e_ident, ELFMAG, SELFMAG) != 0 ||
+        eh->e_ident[EI_CLASS] != (sizeof(gpointer) == 8 ? ELFCLASS64 : ELFCLASS32) ||
+        eh->e_phentsize != sizeof(ElfW(Phdr)) ||
+        eh->e_phoff > size || eh->e_phnum > (size - eh->e_phoff) / sizeof(ElfW(Phdr)))
+        goto done;
+
+    const ElfW(Phdr) *ph = (const ElfW(Phdr) *)(map + eh->e_phoff);
+    const ElfW(Dyn) *dyn = NULL;
+    gsize n_dyn = 0;
+    for (guint i = 0; i < eh->e_phnum; i++) {
+        if (ph[i].p_type == PT_INTERP) {
+            const char *interp = prefetch_elf_string(map, size, ph[i].p_offset);
+            if (interp) g_ptr_array_add(deps, g_strdup(interp));
+        } else if (ph[i].p_type == PT_DYNAMIC && ph[i].p_offset <= size &&
+                   ph[i].p_filesz <= size - ph[i].p_offset) {
+            dyn = (const ElfW(Dyn) *)(map + ph[i].p_offset);
+            n_dyn = ph[i].p_filesz / sizeof(ElfW(Dyn));
+        }
+    }
+    if (!dyn) goto done;
+
+    ElfW(Addr) strtab_addr = 0;
+    gsize rpath = 0, runpath = 0;
+    for (gsize i = 0; i < n_dyn && dyn[i].d_tag != DT_NULL; i++) {
+        if (dyn[i].d_tag == DT_STRTAB) strtab_addr = dyn[i].d_un.d_ptr;
+        else if (dyn[i].d_tag == DT_RPATH) rpath = dyn[i].d_un.d_val;
+        else if (dyn[i].d_tag == DT_RUNPATH) runpath = dyn[i].d_un.d_val;
+    }
+    gsize strtab;
+    if (!strtab_addr || !prefetch_elf_offset(ph, eh->e_phnum, strtab_addr, &strtab))
+        goto done;
+
+    const char *search = runpath ? prefetch_elf_string(map, size, strtab + runpath)
+                       : rpath ? prefetch_elf_string(map, size, strtab + rpath) : NULL;
+    gchar *origin = g_path_get_dirname(path);
+
+    for (gsize i = 0; i < n_dyn && dyn[i].d_tag != DT_NULL; i++) {
+        if (dyn[i].d_tag != DT_NEEDED) continue;
+        const char *name = prefetch_elf_string(map, size, strtab + dyn[i].d_un.d_val);
+        gchar *lib = name ? prefetch_resolve_lib(name, search, origin) : NULL;
+        if (lib) g_ptr_array_add(deps, lib);
+    }
+    g_free(origin);
+
+done:
+    munmap((gpointer)map, size);
+}
+
+/* Agrega a files (con g_free) el ejecutable y todo lo que carga, sin repetir
+ * y hasta PREFETCH_MAX_FILES rutas */
+void prefetch_collect(const char *exec_path, GPtrArray *files)
+{
+    GHashTable *seen = g_hash_table_new(g_str_hash, g_str_equal);
+    guint first = files->len;
+
+    g_ptr_array_add(files, g_strdup(exec_path));
+    g_hash_table_add(seen, g_ptr_array_index(files, first));
+
+    // Recorrido en anchura: files hace de cola
+    GPtrArray *deps = g_ptr_array_new_with_free_func(g_free);
+    for (guint i = first; i < files->len && files->len < first + PREFETCH_MAX_FILES; i++) {
+        prefetch_scan(g_ptr_array_index(files, i), deps);
+        for (guint k = 0; k < deps->len; k++) {
+            gchar *dep = g_ptr_array_index(deps, k);
+            if (!dep || g_hash_table_contains(seen, dep) ||
+                files->len >= first + PREFETCH_MAX_FILES)
+                continue;
+            g_ptr_array_add(files, g_strdup(dep));
+            g_hash_table_add(seen, g_ptr_array_index(files, files->len - 1));
+        }
+        g_ptr_array_set_size(deps, 0);
+    }
+    g_ptr_array_free(deps, TRUE);
+    g_hash_table_destroy(seen);
+}
+
+/* Pide al kernel las páginas de path (sin esperarlas). Devuelve los bytes pedidos. */
+gsize prefetch_readahead(const char *path)
+{
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return 0;
+
+    struct stat st;
+    gsize len = 0;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+        len = MIN((gsize)st.st_size, PREFETCH_MAX_BYTES);
+#ifdef __linux__
+        if (readahead(fd, 0, len) != 0)
+#endif
+            posix_fadvise(fd, 0, len, POSIX_FADV_WILLNEED);
+    }
+    close(fd);
+    return len;
+}
+
+/* Bytes de path (hasta PREFETCH_MAX_BYTES) que no están en la caché de páginas */
+gsize prefetch_missing_bytes(const char *path)
+{
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return 0;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0) {
+        close(fd);
+        return 0;
+    }
+    gsize len = MIN((gsize)st.st_size, PREFETCH_MAX_BYTES);
+    gpointer map = mmap(NULL, len, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return len;
+
+    gsize page = sysconf(_SC_PAGESIZE);
+    gsize pages = (len + page - 1) / page;
+    guchar *vec = g_malloc(pages);
+    gsize missing = len;
+
+    if (mincore(map, len, vec) == 0) {
+        missing = 0;
+        for (gsize i = 0; i < pages; i++)
+            if (!(vec[i] & 1))
+                missing += page;
+        missing = MIN(missing, len);
+    }
+    g_free(vec);
+    munmap(map, len);
+    return missing;
+}
+
+/* Memoria sin usar (MemFree: no cuenta la caché, que habría que desalojar) */
+guint64 prefetch_memory_free(void)
+{
+    gchar *content = NULL;
+    guint64 kib = 0;
+
+    if (g_file_get_contents("/proc/meminfo", &content, NULL, NULL)) {
+        const gchar *line = strstr(content, "MemFree:");
+        if (line)
+            kib = g_ascii_strtoull(line + 8, NULL, 10);
+        g_free(content);
+    }
+    return kib * 1024;
+}
+
+/* Porcentaje de tiempo con tareas esperando el recurso ("some avg10" de
+ * /proc/pressure/<resource>); 0 si el kernel no tiene PSI */
+gdouble prefetch_pressure(const char *resource)
+{
+    gchar *path = g_build_filename("/proc/pressure", resource, NULL);
+    gchar *content = NULL;
+    gdouble avg10 = 0;
+
+    if (g_file_get_contents(path, &content, NULL, NULL)) {
+        const gchar *some = strstr(content, "some avg10=");
+        if (some)
+            avg10 = g_ascii_strtod(some + 11, NULL);
+        g_free(content);
+    }
+    g_free(path);
+    return avg10;
+}
@@ -0,0 +1,159 @@
+/*
+ * Modern Menu Plugin for LXPanel
+ * Modelo sin GTK: catálogo, favoritos/ocultas y búsqueda
+ *
+ * Sólo depende de GLib, así se puede compilar como biblioteca estática y
+ * medir fuera del panel (ver bench/). El plugin lo incluye y lo compila
+ * junto con modern_menu.c.
+ */
+#ifndef MODERN_MENU_MODEL_H
+#define MODERN_MENU_MODEL_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* ==== CONJUNTOS DE IDS (FAVORITOS Y OCULTAS) ==== */
+/* Tablas de cadenas (claves propias, sin valor) guardadas una por línea. Al
+ * leer se ignoran las líneas vacías y las que empiezan con '#'. */
+GHashTable *id_set_new(void);
+void id_set_load(GHashTable *set, const char *path);
+gchar *id_set_serialize(GHashTable *set, const char *header, gsize *length);
+gboolean id_set_write(const char *path, const char *data, gsize length, GError **error);
+gboolean id_set_save(GHashTable *set, const char *path, const char *header, GError **error);
+GList *id_set_sorted(GHashTable *set);
+
+/* ==== FRECUENCIA DE USO ==== */
+/* Lanzamientos por app con decaimiento exponencial, en una tabla de tamaño
+ * fijo mapeada en memoria. Las horas van en segundos (tiempo real). */
+typedef struct _FrecencyStore FrecencyStore;
+
+#define FRECENCY_SLOTS 4096                     // potencia de 2
+#define FRECENCY_HALF_LIFE (14 * 24 * 3600)     // el puntaje se divide por 2 cada 14 días
+
+FrecencyStore *frecency_open(const char *path, GError **error);
+void frecency_close(FrecencyStore *f);
+void frecency_record(FrecencyStore *f, const char *id, gint64 now);
+gdouble frecency_score(FrecencyStore *f, const char *id, gint64 now);
+gint frecency_boost(FrecencyStore *f, const char *id, gint64 now);
+
+/* ==== ENTRADAS DEL CATÁLOGO ==== */
+typedef struct _AppEntry AppEntry;
+typedef struct _CategoryEntry CategoryEntry;
+
+/* Una app del catálogo. Las cadenas (salvo file) pertenecen a backing: un
+ * item de menu-cache, el mapa de la instantánea o un bloque propio. */
+struct _AppEntry {
+    gint ref_count;
+    const gchar *id, *name, *icon, *exec;
+    gchar *file;                    // ruta completa del .desktop
+    gpointer backing;
+    GDestroyNotify backing_free;
+    gboolean live;                  // backing es el item vivo del menú
+    gpointer file_info;             // dato del plugin armado a pedido
+    GDestroyNotify file_info_free;
+};
+
+struct _CategoryEntry {
+    gchar *id, *name;
+    GPtrArray *apps;                // AppEntry* (con referencia), en orden
+};
+
+AppEntry *app_entry_new(const char *id, const char *name, const char *icon,
+                        const char *exec, const char *file);
+AppEntry *app_entry_new_backed(const char *id, const char *name, const char *icon,
+                               const char *exec, const char *file,
+                               gpointer backing, GDestroyNotify backing_free, gboolean live);
+void app_entry_set_backing(AppEntry *e, const char *id, const char *name, const char *icon,
+                           const char *exec, gpointer backing, GDestroyNotify backing_free,
+                           gboolean live);
+gboolean app_entry_matches(AppEntry *e, const char *name, const char *icon,
+                           const char *exec, const char *file);
+AppEntry *app_entry_ref(AppEntry *e);
+void app_entry_unref(AppEntry *e);
+
+CategoryEntry *category_entry_new(const char *id, const char *name);
+void category_entry_free(CategoryEntry *c);
+
+/* ==== CATÁLOGO ==== */
+typedef struct {
+    GPtrArray *apps;                // AppEntry*, en orden y sin ids repetidos
+    GHashTable *apps_by_id;         // id (copia) -> posición + 1
+    GPtrArray *categories;          // CategoryEntry*, en orden
+    GHashTable *categories_by_id;   // id -> CategoryEntry*
+} Catalog;
+
+Catalog *catalog_new(void);
+void catalog_free(Catalog *c);
+AppEntry *catalog_lookup(Catalog *c, const char *id);
+CategoryEntry *catalog_lookup_category(Catalog *c, const char *id);
+AppEntry *catalog_add_app(Catalog *c, AppEntry *e);
+CategoryEntry *catalog_add_category(Catalog *c, const char *id, const char *name);
+void catalog_diff_removed(Catalog *old_catalog, Catalog *c, GHashTable *touched);
+
+GPtrArray *catalog_filter_visible(GPtrArray *apps, GHashTable *hidden);
+GPtrArray *catalog_collect_ids(Catalog *c, GHashTable *ids, GHashTable *hidden);
+
+/* ==== ÍNDICE DE BÚSQUEDA ==== */
+typedef struct _SearchIndex SearchIndex;
+
+#define SEARCH_MAX_RESULTS 256
+
+SearchIndex *search_index_new(GBoxedCopyFunc item_copy, GDestroyNotify item_free);
+SearchIndex *search_index_ref(SearchIndex *idx);
+void search_index_unref(SearchIndex *idx);
+SearchIndex *search_index_copy(SearchIndex *idx);
+gpointer search_index_get_item(SearchIndex *idx, guint i);
+void search_index_remove(SearchIndex *idx, const char *key);
+guint search_index_add(SearchIndex *idx, const char *key, const char *name, gpointer item);
+GArray *search_index_query(SearchIndex *idx, const char *query);
+GArray *search_index_rank(SearchIndex *idx, const char *query, guint max);
+
+typedef gint (*SearchBoostFunc)(const char *key, gpointer user_data);
+GArray *search_index_rank_boosted(SearchIndex *idx, const char *query, guint max,
+                                  SearchBoostFunc boost, gpointer user_data);
+
+SearchIndex *catalog_search_index_update(SearchIndex *idx, Catalog *c, GHashTable *touched);
+
+/* ==== INSTANTÁNEA DEL CATÁLOGO ==== */
+Catalog *catalog_snapshot_read(const char *path, const char *locale);
+gboolean catalog_snapshot_write(Catalog *c, const char *path, const char *locale, GError **error);
+
+/* ==== ÍNDICE DE PAQUETES ==== */
+typedef enum {
+    PACKAGE_MANAGER_NONE,
+    PACKAGE_MANAGER_DPKG,
+    PACKAGE_MANAGER_PACMAN,
+} PackageManager;
+
+typedef struct _PackageIndex PackageIndex;
+
+typedef struct {
+    const char *name;               // como lo acepta el gestor para desinstalar
+    const char *version;            // NULL si no se sabe
+    gint64 size;                    // bytes instalados, -1 si no se sabe
+} PackageInfo;
+
+PackageManager package_manager_detect(void);
+guint64 package_index_current_stamp(PackageManager manager);
+PackageIndex *package_index_build(PackageManager manager, volatile gint *cancel, GError **error);
+PackageIndex *package_index_load(const char *path, PackageManager manager);
+gboolean package_index_save(PackageIndex *idx, const char *path, GError **error);
+void package_index_free(PackageIndex *idx);
+PackageManager package_index_manager(PackageIndex *idx);
+gboolean package_index_is_current(PackageIndex *idx);
+gboolean package_index_owner(PackageIndex *idx, const char *path, PackageInfo *info);
+
+/* ==== PRECARGA DE EJECUTABLES ==== */
+#define PREFETCH_MAX_FILES 64                   // ejecutable + intérprete + bibliotecas
+#define PREFETCH_MAX_BYTES (32 << 20)           // por archivo
+
+void prefetch_collect(const char *exec_path, GPtrArray *files);
+gsize prefetch_readahead(const char *path);
+gsize prefetch_missing_bytes(const char *path);
+guint64 prefetch_memory_free(void);
+gdouble prefetch_pressure(const char *resource);
+
+G_END_DECLS
+
+#endif /* MODERN_MENU_MODEL_H */